@@ -0,0 +1,145 @@
+/*
+  Gm7CanAdaptiveHeartbeat.h - Controller side of adaptive heartbeat timing.
+                              Measures the bus load and stretches the heartbeat interval of the whole bus while it is busy.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanAdaptiveHeartbeat_h
+#define Gm7CanAdaptiveHeartbeat_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+class Gm7CanAdaptiveHeartbeat {
+  //The controller counts every frame it sees and calculates the bus load once per load window.
+  //Above highLoadPercent the heartbeat interval is doubled, below lowLoadPercent it is halved, within minIntervalMillis and maxIntervalMillis.
+  //The interval changes at most once per holdMillis, so short bursts don't make it flap.
+  //The timeout is always interval + interval / 4 (the default 1000 / 1250 ratio), but never less than 250 millis above the interval.
+  //The controller advertises interval and timeout in every HEARTBEAT_CONTROLLER_ADAPTIVE it sends, and nodes follow them.
+  //
+  //Liveness while the timing changes:
+  //Nodes only pick up a new interval with the next controller heartbeat, so for a while some nodes still beat at the old interval.
+  //Therefore, after a change, the larger of the old and the new timeout stays in effect (and is advertised) until the old interval
+  //plus the new timeout have passed. A node still beating at the old, longer interval is never declared offline by this.
+  //The other way around, when the interval grows the nodes still expect the controller within the old, shorter timeout. So after a
+  //change the controller heartbeat is due right away instead of one new interval after the last one: send it whenever
+  //isHeartbeatDue() is true and the nodes have the new timeout before the old one runs out.
+    private:
+      Gm7CanProtocol & protocol;
+      uint32_t minIntervalMillis;
+      uint32_t maxIntervalMillis;
+      uint8_t lowLoadPercent = 20;
+      uint8_t highLoadPercent = 50;
+      uint32_t loadWindowMillis = 1000;
+      uint32_t holdMillis = 10000;
+
+      uint32_t intervalMillis;
+      uint32_t previousIntervalMillis;
+      uint32_t changedMillis = 0;
+      uint32_t lastHeartbeatMillis = 0;
+      bool heartbeatDue = true;  //Before the first heartbeat and right after a change
+      uint32_t windowStartMillis = 0;
+      uint32_t windowBits = 0;
+      uint8_t loadPercent = 0;
+
+    public:
+        Gm7CanAdaptiveHeartbeat(Gm7CanProtocol & canProtocol, uint32_t maxHeartbeatIntervalMillis = 8000) : protocol(canProtocol){
+          minIntervalMillis = protocol.getHeartbeatIntervalRateInMillis();
+          maxIntervalMillis = maxHeartbeatIntervalMillis < minIntervalMillis ? minIntervalMillis : maxHeartbeatIntervalMillis;
+          if(maxIntervalMillis > 0xFFFF / 2){
+            maxIntervalMillis = 0xFFFF / 2; //Interval and timeout are sent as 16 bits
+          }
+          intervalMillis = minIntervalMillis;
+          previousIntervalMillis = minIntervalMillis;
+        };
+
+        void setLoadThresholds(uint8_t lowPercent, uint8_t highPercent){
+          lowLoadPercent = lowPercent;
+          highLoadPercent = highPercent;
+        };
+
+        void setHoldMillis(uint32_t millis){
+          holdMillis = millis;
+        };
+
+        static uint32_t getTimeoutForInterval(uint32_t interval){
+          uint32_t margin = interval / 4;
+          return interval + (margin < 250 ? 250 : margin);
+        };
+
+        //Call for every frame seen on the bus (sent or received).
+        //Uses the length of an extended frame with the given payload, plus roughly 10% for stuff bits.
+        void recordFrame(uint8_t length){
+          uint32_t bits = 67 + (8 * (uint32_t)length);
+          windowBits += bits + (bits / 10);
+        };
+
+        //Call regularly (every loop is fine). Returns true when the heartbeat interval changed.
+        bool update(uint32_t nowMillis){
+          if(nowMillis - windowStartMillis < loadWindowMillis){
+            return false;
+          }
+          uint32_t capacity = (protocol.getBaudrate() / 1000) * (nowMillis - windowStartMillis);
+          loadPercent = capacity == 0 ? 0 : (uint8_t)(((uint64_t)windowBits * 100) / capacity);
+          windowBits = 0;
+          windowStartMillis = nowMillis;
+          if(nowMillis - changedMillis < holdMillis){
+            return false;
+          }
+          uint32_t newInterval = intervalMillis;
+          if(loadPercent > highLoadPercent && intervalMillis < maxIntervalMillis){
+            newInterval = intervalMillis * 2 > maxIntervalMillis ? maxIntervalMillis : intervalMillis * 2;
+          } else if(loadPercent < lowLoadPercent && intervalMillis > minIntervalMillis){
+            newInterval = intervalMillis / 2 < minIntervalMillis ? minIntervalMillis : intervalMillis / 2;
+          }
+          if(newInterval == intervalMillis){
+            return false;
+          }
+          previousIntervalMillis = intervalMillis;
+          intervalMillis = newInterval;
+          changedMillis = nowMillis;
+          heartbeatDue = true;
+          protocol.setHeartbeatTiming(intervalMillis, getEffectiveTimeoutMillis(nowMillis));
+          return true;
+        };
+
+        uint8_t getLoadPercent(){
+          return loadPercent;
+        };
+
+        uint32_t getIntervalMillis(){
+          return intervalMillis;
+        };
+
+        //The timeout to use for (and advertise to) all nodes right now, including the grace period after a change
+        uint32_t getEffectiveTimeoutMillis(uint32_t nowMillis){
+          uint32_t timeout = getTimeoutForInterval(intervalMillis);
+          uint32_t previousTimeout = getTimeoutForInterval(previousIntervalMillis);
+          if(previousTimeout > timeout && nowMillis - changedMillis < previousIntervalMillis + timeout){
+            return previousTimeout;
+          }
+          return timeout;
+        };
+
+        //True every getIntervalMillis() after the last encoded heartbeat, and right away after the interval changed
+        bool isHeartbeatDue(uint32_t nowMillis){
+          return heartbeatDue || nowMillis - lastHeartbeatMillis >= intervalMillis;
+        };
+
+        //Encodes the controller heartbeat; send it with PMID HEARTBEAT_CONTROLLER_ADAPTIVE whenever isHeartbeatDue()
+        bool encodeHeartbeat(char * buffer, uint8_t bufferCount, uint32_t nowMillis){
+          uint32_t timeout = getEffectiveTimeoutMillis(nowMillis);
+          protocol.setHeartbeatTiming(intervalMillis, timeout);
+          if(!protocol.encodeAdaptiveHeartbeat(buffer, bufferCount, nowMillis, intervalMillis, timeout)){
+            return false;
+          }
+          lastHeartbeatMillis = nowMillis;
+          heartbeatDue = false;
+          return true;
+        };
+
+};
+
+#endif
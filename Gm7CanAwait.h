@@ -0,0 +1,328 @@
+/*
+  Gm7CanAwait.h - Waiting for specific frames without blocking, callbacks per frame or threads.
+                  Gm7CanWaitTable works on any board; on compilers with C++20 coroutines the waits can also be co_await-ed.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanAwait_h
+#define Gm7CanAwait_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+  #include <coroutine>
+  #include <exception>
+  #define GM7_CAN_COROUTINES 1
+#endif
+
+#ifndef CAN_WAIT_TABLE_ENTRIES
+  #define CAN_WAIT_TABLE_ENTRIES 32 //Max 65535
+#endif
+
+#ifndef CAN_WAIT_TABLE_BUCKETS
+  #define CAN_WAIT_TABLE_BUCKETS 16 //Max 65536, any count works; about a quarter of the entries keeps the lists short
+#endif
+
+class Gm7CanWaitTable {
+  //A wait is "the next frame with this PMID from this UID, within this time", optionally only if the first 32 bits of the payload
+  //(the status word of status frames) match a value under a mask. Each wait takes one entry of a fixed table
+  //(about 40 bytes on AVR, 56 bytes on a 64-bit host).
+  //Pending waits are kept in lists per hash of PMID and UID, so onFrame() only looks at the waits that can match the frame.
+  //poll() only walks the table when the earliest deadline has passed.
+  //Feed every received frame to onFrame() and call poll() every loop to expire waits. Both run from a single loop; no locking is done.
+  //A handle stays valid until release() is called, even after the entry completed; stale handles are detected by a generation counter.
+  //Frames only complete waits that were created before the frame was handed to onFrame(), so a wait started from a resume
+  //callback never completes on the frame that triggered that callback.
+    public:
+        enum WaitState : uint8_t {
+          WAIT_INVALID = 0,   //Unknown or released handle
+          WAIT_PENDING = 1,
+          WAIT_DONE = 2,
+          WAIT_TIMED_OUT = 3
+        };
+
+        typedef uint32_t Handle;  //Generation (high 16 bits) and entry index (low 16 bits), 0 is never a valid handle
+        typedef void (*ResumeCallback)(void * context);
+
+    private:
+      static const uint16_t NO_ENTRY = 0xFFFF;
+
+      static_assert(CAN_WAIT_TABLE_ENTRIES >= 1 && CAN_WAIT_TABLE_ENTRIES <= NO_ENTRY, "CAN_WAIT_TABLE_ENTRIES must be 1-65535, the entries are linked by 16-bit index");
+      static_assert(CAN_WAIT_TABLE_BUCKETS >= 1 && CAN_WAIT_TABLE_BUCKETS <= 0x10000, "CAN_WAIT_TABLE_BUCKETS must be 1-65536");
+
+      struct Entry{
+        uint16_t generation;
+        WaitState state;
+        bool resumeDue;         //Completed by the current onFrame(), the resume callback still has to be called
+        uint8_t length;
+        uint16_t pmid;
+        uint16_t uid;
+        uint16_t next;          //Next pending entry in the same bucket, or next free entry
+        uint16_t nextCompleted; //Next entry completed by the current onFrame()
+        uint32_t value;
+        uint32_t valueMask;
+        uint32_t deadlineMillis;
+        uint32_t createdAtFrame;
+        ResumeCallback resume;
+        void * context;
+        char payload[CAN_PAYLOAD_MESSAGE_BYTES];
+      };
+
+      Entry entries[CAN_WAIT_TABLE_ENTRIES];
+      uint16_t buckets[CAN_WAIT_TABLE_BUCKETS];
+      uint16_t freeEntry = 0;
+      uint16_t pendingCount = 0;
+      uint32_t frameCounter = 0;
+      uint32_t earliestDeadlineMillis = 0;
+
+      static uint16_t getBucket(uint16_t pmid, uint16_t uid){
+        uint16_t hash = (uint16_t)((uid ^ (pmid << 3)) * 40503u); //Fibonacci hashing, the high bits pick the bucket
+        return ((uint32_t)hash * CAN_WAIT_TABLE_BUCKETS) >> 16;
+      };
+
+      Entry * getEntry(Handle handle){
+        uint16_t index = handle & 0xFFFF;
+        if(index >= CAN_WAIT_TABLE_ENTRIES || entries[index].state == WAIT_INVALID || entries[index].generation != (handle >> 16)){
+          return 0;
+        }
+        return &entries[index];
+      };
+
+      void unlink(uint16_t index){
+        uint16_t * link = &buckets[getBucket(entries[index].pmid, entries[index].uid)];
+        while(*link != NO_ENTRY){
+          if(*link == index){
+            *link = entries[index].next;
+            return;
+          }
+          link = &entries[*link].next;
+        }
+      };
+
+      //Takes a pending entry out of its bucket and sets its final state, without resuming
+      void settle(uint16_t index, WaitState state){
+        unlink(index);
+        entries[index].state = state;
+        pendingCount--;
+      };
+
+      void resume(Entry & entry){
+        entry.resumeDue = false;
+        if(entry.resume != 0){
+          ResumeCallback callback = entry.resume;
+          entry.resume = 0;
+          callback(entry.context);
+        }
+      };
+
+    public:
+        Gm7CanWaitTable(){
+          memset(entries, 0, sizeof(entries));
+          for(uint16_t i = 0; i < CAN_WAIT_TABLE_BUCKETS; i++){
+            buckets[i] = NO_ENTRY;
+          }
+          for(uint16_t i = 0; i < CAN_WAIT_TABLE_ENTRIES; i++){
+            entries[i].generation = 1;
+            entries[i].next = i + 1 < CAN_WAIT_TABLE_ENTRIES ? i + 1 : NO_ENTRY;
+          }
+        };
+
+        //Returns 0 when the table is full
+        Handle expect(uint16_t pmid, uint16_t uid, uint32_t timeoutMillis, uint32_t nowMillis, uint32_t value = 0, uint32_t valueMask = 0){
+          uint16_t index = freeEntry;
+          if(index == NO_ENTRY){
+            return 0;
+          }
+          Entry & entry = entries[index];
+          freeEntry = entry.next;
+          entry.state = WAIT_PENDING;
+          entry.resumeDue = false;
+          entry.pmid = pmid;
+          entry.uid = uid;
+          entry.value = value & valueMask;
+          entry.valueMask = valueMask;
+          entry.deadlineMillis = nowMillis + timeoutMillis;
+          entry.createdAtFrame = frameCounter;
+          entry.resume = 0;
+          entry.context = 0;
+          entry.length = 0;
+          uint16_t bucket = getBucket(pmid, uid);
+          entry.next = buckets[bucket];
+          buckets[bucket] = index;
+          if(pendingCount == 0 || (int32_t)(entry.deadlineMillis - earliestDeadlineMillis) < 0){
+            earliestDeadlineMillis = entry.deadlineMillis;
+          }
+          pendingCount++;
+          return ((Handle)entry.generation << 16) | index;
+        };
+
+        //The callback is called once, when the wait completes or times out. If it already did, it is called right away.
+        void setResume(Handle handle, ResumeCallback callback, void * context){
+          Entry * entry = getEntry(handle);
+          if(entry == 0){
+            return;
+          }
+          entry->resume = callback;
+          entry->context = context;
+          if(entry->state != WAIT_PENDING){
+            resume(*entry);
+          }
+        };
+
+        void onFrame(uint32_t canMessageId, const char * buffer, uint8_t bufferCount){
+          uint32_t frame = ++frameCounter;
+          uint16_t pmid = (canMessageId >> 16) & 0x1FFF;
+          uint16_t uid = canMessageId & 0xFFFF;
+          uint32_t value = 0;
+          for(uint8_t i = 0; i < 4; i++){
+            value = (value << 8) | (i < bufferCount ? (uint8_t)buffer[i] : 0);
+          }
+          //First complete every matching wait, then resume them: resume callbacks may create and release waits,
+          //which must not change the bucket while it is walked
+          uint16_t completed = NO_ENTRY;
+          uint16_t index = buckets[getBucket(pmid, uid)];
+          while(index != NO_ENTRY){
+            Entry & entry = entries[index];
+            uint16_t next = entry.next;
+            if(entry.pmid == pmid && entry.uid == uid && entry.createdAtFrame < frame && (value & entry.valueMask) == entry.value){
+              entry.length = bufferCount > CAN_PAYLOAD_MESSAGE_BYTES ? CAN_PAYLOAD_MESSAGE_BYTES : bufferCount;
+              memcpy(entry.payload, buffer, entry.length);
+              settle(index, WAIT_DONE);
+              entry.resumeDue = true;
+              entry.nextCompleted = completed;
+              completed = index;
+            }
+            index = next;
+          }
+          while(completed != NO_ENTRY){
+            Entry & entry = entries[completed];
+            completed = entry.nextCompleted;
+            if(entry.resumeDue){ //Not released or reused by an earlier callback
+              resume(entry);
+            }
+          }
+        };
+
+        void poll(uint32_t nowMillis){
+          if(pendingCount == 0 || (int32_t)(nowMillis - earliestDeadlineMillis) < 0){
+            return;
+          }
+          for(uint16_t i = 0; i < CAN_WAIT_TABLE_ENTRIES; i++){
+            Entry & entry = entries[i];
+            if(entry.state == WAIT_PENDING && (int32_t)(nowMillis - entry.deadlineMillis) >= 0){
+              settle(i, WAIT_TIMED_OUT);
+              resume(entry);
+            }
+          }
+          //Only after the walk: resume callbacks may have created waits in entries that were already passed
+          bool first = true;
+          for(uint16_t i = 0; i < CAN_WAIT_TABLE_ENTRIES; i++){
+            Entry & entry = entries[i];
+            if(entry.state == WAIT_PENDING && (first || (int32_t)(entry.deadlineMillis - earliestDeadlineMillis) < 0)){
+              earliestDeadlineMillis = entry.deadlineMillis;
+              first = false;
+            }
+          }
+        };
+
+        WaitState getState(Handle handle){
+          Entry * entry = getEntry(handle);
+          return entry == 0 ? WAIT_INVALID : entry->state;
+        };
+
+        //Copies the payload of the frame that completed the wait. Returns its length, 0 if the wait did not complete (yet).
+        uint8_t getPayload(Handle handle, char * buffer, uint8_t bufferCount){
+          Entry * entry = getEntry(handle);
+          if(entry == 0 || entry->state != WAIT_DONE){
+            return 0;
+          }
+          uint8_t length = entry->length < bufferCount ? entry->length : bufferCount;
+          memcpy(buffer, entry->payload, length);
+          return length;
+        };
+
+        //True when none of the waits is pending anymore (done, timed out or released)
+        bool isSettled(const Handle * handles, uint16_t count){
+          for(uint16_t i = 0; i < count; i++){
+            if(getState(handles[i]) == WAIT_PENDING){
+              return false;
+            }
+          }
+          return true;
+        };
+
+        uint16_t getPendingCount(){
+          return pendingCount;
+        };
+
+        void release(Handle handle){
+          Entry * entry = getEntry(handle);
+          if(entry == 0){
+            return;
+          }
+          uint16_t index = handle & 0xFFFF;
+          if(entry->state == WAIT_PENDING){
+            settle(index, WAIT_INVALID);
+          }
+          entry->state = WAIT_INVALID;
+          entry->resumeDue = false;
+          entry->resume = 0;
+          if(++entry->generation == 0){
+            entry->generation = 1;
+          }
+          entry->next = freeEntry;
+          freeEntry = index;
+        };
+
+#ifdef GM7_CAN_COROUTINES
+        //co_await table.wait(handle) suspends until the wait completes or times out, then releases the handle and returns the final state.
+        //To wait for several frames at once, create all waits first and co_await them one by one; the total time is that of the slowest.
+        struct Awaiter{
+          Gm7CanWaitTable & table;
+          Handle handle;
+
+          bool await_ready(){
+            return table.getState(handle) != WAIT_PENDING;
+          };
+
+          void await_suspend(std::coroutine_handle<> coroutine){
+            table.setResume(handle, resumeCoroutine, coroutine.address());
+          };
+
+          WaitState await_resume(){
+            WaitState state = table.getState(handle);
+            table.release(handle);
+            return state;
+          };
+
+          static void resumeCoroutine(void * context){
+            std::coroutine_handle<>::from_address(context).resume();
+          };
+        };
+
+        Awaiter wait(Handle handle){
+          return Awaiter{*this, handle};
+        };
+#endif
+
+};
+
+#ifdef GM7_CAN_COROUTINES
+//Return type for fire-and-forget coroutines driven by a Gm7CanWaitTable, for example:
+//  Gm7CanTask startGame(){ ...send requests...; for(...) { if(co_await table.wait(handles[i]) != Gm7CanWaitTable::WAIT_DONE) {...} } }
+//The coroutine runs until its first co_await right away, and continues from onFrame() or poll() of the table.
+struct Gm7CanTask {
+  struct promise_type {
+    Gm7CanTask get_return_object(){ return Gm7CanTask(); };
+    std::suspend_never initial_suspend() noexcept { return std::suspend_never(); };
+    std::suspend_never final_suspend() noexcept { return std::suspend_never(); };
+    void return_void(){};
+    void unhandled_exception(){ std::terminate(); }; //Nobody awaits the task, an exception can not be passed on
+  };
+};
+#endif
+
+#endif
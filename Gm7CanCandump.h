@@ -0,0 +1,166 @@
+/*
+  Gm7CanCandump.h - Reading and writing GM7 CAN frames as candump log lines (candump -L).
+                    Lets devices log traffic in a format the SocketCAN tools understand, and lets log tooling
+                    parse those lines without sscanf() or any allocation.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanCandump_h
+#define Gm7CanCandump_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+class Gm7CanCandump {
+  //A candump -L line looks like this (extended id's are always printed with 8 hex digits):
+  //  (1676000000.123456) can0 13950007#00000000000003E8
+  //   seconds.micros     interface  id#payload
+  //The parser walks the line once, left to right, with no lookups or library calls; hex digits are decoded arithmetically.
+  //The interface name is not copied, only its position in the line is returned, so a memory mapped log can be scanned in place.
+  //Remote frames and CAN FD frames (##) are not used by the GM7 protocol and are rejected.
+
+    public:
+        struct LogFrame{
+          uint32_t seconds;
+          uint32_t micros;
+          uint32_t canMessageId;
+          bool extended;
+          uint8_t length;
+          char payload[CAN_PAYLOAD_MESSAGE_BYTES];
+          uint16_t interfaceStart;  //Position of the interface name in the parsed line
+          uint8_t interfaceLength;
+        };
+
+    private:
+      static int8_t getHexValue(char c){
+        if(c >= '0' && c <= '9'){
+          return c - '0';
+        }
+        c |= 0x20; //Lowercase
+        if(c >= 'a' && c <= 'f'){
+          return c - 'a' + 10;
+        }
+        return -1;
+      };
+
+      static char getHexChar(uint8_t value){
+        return value < 10 ? '0' + value : 'A' + value - 10;
+      };
+
+      static uint16_t addDecimal(char * out, uint16_t position, uint32_t value, uint8_t digits){
+        for(uint8_t i = digits; i > 0; i--){
+          out[position + i - 1] = '0' + (value % 10);
+          value /= 10;
+        }
+        return position + digits;
+      };
+
+    public:
+        //Parses one line (without the line ending). Returns false if the line is not a valid candump -L frame.
+        static bool parseLine(const char * line, uint16_t lineLength, LogFrame & frame){
+          uint16_t i = 0;
+          frame.seconds = 0;
+          frame.micros = 0;
+          frame.canMessageId = 0;
+          frame.length = 0;
+          if(lineLength < 1 || line[i++] != '('){
+            return false;
+          }
+          while(i < lineLength && line[i] >= '0' && line[i] <= '9'){
+            frame.seconds = (frame.seconds * 10) + (line[i++] - '0');
+          }
+          if(i >= lineLength || line[i++] != '.'){
+            return false;
+          }
+          uint8_t microDigits = 0;
+          while(i < lineLength && line[i] >= '0' && line[i] <= '9'){
+            if(microDigits++ < 6){
+              frame.micros = (frame.micros * 10) + (line[i] - '0');
+            }
+            i++;
+          }
+          for(; microDigits < 6; microDigits++){
+            frame.micros *= 10;
+          }
+          if(i + 1 >= lineLength || line[i++] != ')' || line[i++] != ' '){
+            return false;
+          }
+          frame.interfaceStart = i;
+          while(i < lineLength && line[i] != ' '){
+            i++;
+          }
+          frame.interfaceLength = i - frame.interfaceStart;
+          if(i >= lineLength || line[i++] != ' '){
+            return false;
+          }
+          uint8_t idDigits = 0;
+          while(i < lineLength && line[i] != '#'){
+            int8_t value = getHexValue(line[i++]);
+            if(value < 0 || ++idDigits > 8){
+              return false;
+            }
+            frame.canMessageId = (frame.canMessageId << 4) | value;
+          }
+          frame.extended = idDigits > 3;
+          if(idDigits == 0 || i >= lineLength || line[i++] != '#'){
+            return false;
+          }
+          while(i + 1 < lineLength && line[i] != ' '){
+            int8_t high = getHexValue(line[i]);
+            int8_t low = getHexValue(line[i + 1]);
+            if(high < 0 || low < 0 || frame.length >= CAN_PAYLOAD_MESSAGE_BYTES){
+              return false;
+            }
+            frame.payload[frame.length++] = (high << 4) | low;
+            i += 2;
+          }
+          return i == lineLength || line[i] == ' ';
+        };
+
+        //Writes a candump -L line (without line ending, null terminated) into out. Returns the line length, or 0 if out is too small.
+        static uint16_t formatLine(char * out, uint16_t outSize, uint32_t seconds, uint32_t micros, const char * interfaceName, uint32_t canMessageId, const char * payload, uint8_t length){
+          uint16_t interfaceLength = strlen(interfaceName);
+          if(length > CAN_PAYLOAD_MESSAGE_BYTES || outSize < 32 + interfaceLength + (length * 2)){
+            return 0;
+          }
+          uint16_t i = 0;
+          out[i++] = '(';
+          i = addDecimal(out, i, seconds, 10);
+          out[i++] = '.';
+          i = addDecimal(out, i, micros, 6);
+          out[i++] = ')';
+          out[i++] = ' ';
+          for(uint16_t c = 0; c < interfaceLength; c++){
+            out[i++] = interfaceName[c];
+          }
+          out[i++] = ' ';
+          for(int8_t shift = 28; shift >= 0; shift -= 4){
+            out[i++] = getHexChar((canMessageId >> shift) & 0x0F);
+          }
+          out[i++] = '#';
+          for(uint8_t b = 0; b < length; b++){
+            out[i++] = getHexChar((uint8_t)payload[b] >> 4);
+            out[i++] = getHexChar(payload[b] & 0x0F);
+          }
+          out[i] = '\0';
+          return i;
+        };
+
+        static uint16_t formatLine(char * out, uint16_t outSize, const LogFrame & frame, const char * interfaceName){
+          return formatLine(out, outSize, frame.seconds, frame.micros, interfaceName, frame.canMessageId, frame.payload, frame.length);
+        };
+
+        //The delay to wait before sending next when replaying frames with their original timing. 0 if next is older than previous.
+        //64 bits, since 32 bits of microseconds wrap after about 71 minutes of silence in the log.
+        static uint64_t getReplayDelayMicros(const LogFrame & previous, const LogFrame & next){
+          if(next.seconds < previous.seconds || (next.seconds == previous.seconds && next.micros < previous.micros)){
+            return 0;
+          }
+          return ((uint64_t)(next.seconds - previous.seconds) * 1000000ULL) + next.micros - previous.micros;
+        };
+
+};
+
+#endif
@@ -0,0 +1,391 @@
+/*
+  Gm7CanCapture.h - Compact, indexed binary capture blocks for GM7 CAN traffic.
+                    Gm7CanCaptureBlock collects frames in bounded memory and serializes them as one block,
+                    Gm7CanCaptureReader decides from the block header alone whether a block needs to be read at all,
+                    Gm7CanCaptureIndex finds those blocks in a file without walking it.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanCapture_h
+#define Gm7CanCapture_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_CAPTURE_BLOCK_FRAMES
+  #define CAN_CAPTURE_BLOCK_FRAMES 32 //Max 255
+#endif
+
+#define CAN_CAPTURE_HEADER_BYTES 40
+#define CAN_CAPTURE_FRAME_COLUMN_BYTES 9 //Time offset, message id and DLC of one frame, without its payload
+#define CAN_CAPTURE_VERSION 2
+#define CAN_CAPTURE_INDEX_HEADER_BYTES 8
+#define CAN_CAPTURE_INDEX_ENTRY_BYTES 44
+
+//A capture file is just a sequence of blocks. Every block is self contained and stored big endian, like the protocol itself.
+//Header (CAN_CAPTURE_HEADER_BYTES):
+//  magic "G7CB" (4) | version (1) | frame count (1) | block size in bytes (2)
+//  first timestamp millis (8) | last timestamp minus the first in millis (4)
+//  PMID min (2) | PMID max (2) | UID min (2) | UID max (2)
+//  PMID page bits (4): bit n is set if a PMID between n*256 and n*256+255 is in the block
+//  UID bits (8): bit (uid % 64) is set for every UID in the block
+//Columns, frame count entries each:
+//  timestamp minus the first in millis (4) | 29-bit message id (4) | DLC (1) | payload (DLC bytes, no padding)
+//Timestamps are 64-bit millis on any time base the writer chooses: millis() of the board, or the Unix epoch (candump logs),
+//so captures of weeks or years never wrap. Frames of one block are at most 2^32 millis (49 days) apart and in time order.
+//The header answers "can this block contain PMID x from UID y between t1 and t2" without touching the columns.
+//Blocks differ in size, so finding the headers still means walking the file. A capture index avoids that:
+//Index file:
+//  magic "G7CI" (4) | version (1) | reserved (3)
+//  then one entry (CAN_CAPTURE_INDEX_ENTRY_BYTES) per block: file offset of the block (8) | the block header without its magic (36)
+//The writer appends an entry for every block it writes (see Gm7CanCaptureIndex::writeEntry()), the reader loads the index
+//and only reads the blocks it returns.
+
+class Gm7CanCaptureBlock {
+    public:
+        struct Header{
+          uint8_t version;
+          uint8_t frameCount;
+          uint16_t blockSize;
+          uint64_t firstMillis;
+          uint64_t lastMillis;
+          uint16_t pmidMin;
+          uint16_t pmidMax;
+          uint16_t uidMin;
+          uint16_t uidMax;
+          uint32_t pmidPages;
+          uint64_t uidBits;
+        };
+
+        struct Frame{
+          uint64_t timestampMillis;
+          uint32_t canMessageId;
+          uint8_t length;
+          char payload[CAN_PAYLOAD_MESSAGE_BYTES];
+        };
+
+        static uint32_t getPmidPageBit(uint16_t pmid){
+          return (uint32_t)1 << ((pmid >> 8) & 31);
+        };
+
+        static uint64_t getUidBit(uint16_t uid){
+          return (uint64_t)1 << (uid & 63);
+        };
+
+        static uint16_t writeUint(uint8_t * out, uint16_t position, uint64_t value, uint8_t bytes){
+          for(uint8_t i = 0; i < bytes; i++){
+            out[position + i] = value >> (8 * (bytes - 1 - i));
+          }
+          return position + bytes;
+        };
+
+        static uint64_t readUint(const uint8_t * data, uint16_t position, uint8_t bytes){
+          uint64_t value = 0;
+          for(uint8_t i = 0; i < bytes; i++){
+            value = (value << 8) | data[position + i];
+          }
+          return value;
+        };
+
+        //Writes the header fields from the version on (bytes 4 to CAN_CAPTURE_HEADER_BYTES), shared by blocks and index entries
+        static uint16_t writeHeaderFields(uint8_t * out, const Header & header){
+          uint16_t i = 4;
+          out[i++] = header.version;
+          out[i++] = header.frameCount;
+          i = writeUint(out, i, header.blockSize, 2);
+          i = writeUint(out, i, header.firstMillis, 8);
+          i = writeUint(out, i, header.lastMillis - header.firstMillis, 4);
+          i = writeUint(out, i, header.pmidMin, 2);
+          i = writeUint(out, i, header.pmidMax, 2);
+          i = writeUint(out, i, header.uidMin, 2);
+          i = writeUint(out, i, header.uidMax, 2);
+          i = writeUint(out, i, header.pmidPages, 4);
+          return writeUint(out, i, header.uidBits, 8);
+        };
+
+        static void readHeaderFields(const uint8_t * data, Header & header){
+          header.version = data[4];
+          header.frameCount = data[5];
+          header.blockSize = readUint(data, 6, 2);
+          header.firstMillis = readUint(data, 8, 8);
+          header.lastMillis = header.firstMillis + readUint(data, 16, 4);
+          header.pmidMin = readUint(data, 20, 2);
+          header.pmidMax = readUint(data, 22, 2);
+          header.uidMin = readUint(data, 24, 2);
+          header.uidMax = readUint(data, 26, 2);
+          header.pmidPages = readUint(data, 28, 4);
+          header.uidBits = readUint(data, 32, 8);
+        };
+
+    private:
+      Header header;
+      uint32_t offsets[CAN_CAPTURE_BLOCK_FRAMES];
+      uint32_t messageIds[CAN_CAPTURE_BLOCK_FRAMES];
+      uint8_t lengths[CAN_CAPTURE_BLOCK_FRAMES];
+      uint8_t payloads[CAN_CAPTURE_BLOCK_FRAMES * CAN_PAYLOAD_MESSAGE_BYTES];
+      uint16_t payloadBytes = 0;
+
+    public:
+        Gm7CanCaptureBlock(){
+          reset();
+        };
+
+        void reset(){
+          memset(&header, 0, sizeof(header));
+          header.version = CAN_CAPTURE_VERSION;
+          header.pmidMin = 0xFFFF;
+          header.uidMin = 0xFFFF;
+          payloadBytes = 0;
+        };
+
+        //Returns false when the frame does not fit in this block (full, older than the previous frame, or 2^32 millis or more after
+        //the first frame). Serialize and reset the block, then append the frame again. A frame longer than 8 bytes never fits.
+        bool append(uint32_t canMessageId, const char * payload, uint8_t length, uint64_t timestampMillis){
+          uint8_t index = header.frameCount;
+          if(index >= CAN_CAPTURE_BLOCK_FRAMES || length > CAN_PAYLOAD_MESSAGE_BYTES){
+            return false;
+          }
+          if(index == 0){
+            header.firstMillis = timestampMillis;
+          } else if(timestampMillis < header.lastMillis || timestampMillis - header.firstMillis > 0xFFFFFFFF){
+            return false;
+          }
+          header.lastMillis = timestampMillis;
+          offsets[index] = timestampMillis - header.firstMillis;
+          messageIds[index] = canMessageId & 0x1FFFFFFF;
+          lengths[index] = length;
+          memcpy(&payloads[payloadBytes], payload, length);
+          payloadBytes += length;
+          uint16_t pmid = (canMessageId & 0x1FFFFFFF) >> 16;
+          uint16_t uid = canMessageId & 0xFFFF;
+          if(pmid < header.pmidMin) { header.pmidMin = pmid; }
+          if(pmid > header.pmidMax) { header.pmidMax = pmid; }
+          if(uid < header.uidMin) { header.uidMin = uid; }
+          if(uid > header.uidMax) { header.uidMax = uid; }
+          header.pmidPages |= getPmidPageBit(pmid);
+          header.uidBits |= getUidBit(uid);
+          header.frameCount++;
+          return true;
+        };
+
+        bool append(const Gm7CanProtocol::CanFrame & frame, uint64_t timestampMillis){
+          return append(frame.id, frame.data, frame.length, timestampMillis);
+        };
+
+        bool isEmpty(){
+          return header.frameCount == 0;
+        };
+
+        bool isFull(){
+          return header.frameCount >= CAN_CAPTURE_BLOCK_FRAMES;
+        };
+
+        //The header of the block as it was last serialized; pass it to Gm7CanCaptureIndex::writeEntry() before reset()
+        const Header & getHeader(){
+          return header;
+        };
+
+        uint16_t getSerializedSize(){
+          return CAN_CAPTURE_HEADER_BYTES + (header.frameCount * CAN_CAPTURE_FRAME_COLUMN_BYTES) + payloadBytes;
+        };
+
+        //Writes the block to out. Returns the amount of bytes written, or 0 if out is too small.
+        uint16_t serialize(uint8_t * out, uint16_t outSize){
+          uint16_t size = getSerializedSize();
+          if(outSize < size){
+            return 0;
+          }
+          out[0] = 'G';
+          out[1] = '7';
+          out[2] = 'C';
+          out[3] = 'B';
+          header.blockSize = size;
+          uint16_t i = writeHeaderFields(out, header);
+          for(uint8_t f = 0; f < header.frameCount; f++){
+            i = writeUint(out, i, offsets[f], 4);
+          }
+          for(uint8_t f = 0; f < header.frameCount; f++){
+            i = writeUint(out, i, messageIds[f], 4);
+          }
+          memcpy(&out[i], lengths, header.frameCount);
+          i += header.frameCount;
+          memcpy(&out[i], payloads, payloadBytes);
+          return i + payloadBytes;
+        };
+
+        static bool readHeader(const uint8_t * data, uint16_t size, Header & header){
+          if(size < CAN_CAPTURE_HEADER_BYTES || data[0] != 'G' || data[1] != '7' || data[2] != 'C' || data[3] != 'B' || data[4] != CAN_CAPTURE_VERSION){
+            return false;
+          }
+          readHeaderFields(data, header);
+          return header.blockSize <= size && header.blockSize >= CAN_CAPTURE_HEADER_BYTES + (header.frameCount * CAN_CAPTURE_FRAME_COLUMN_BYTES);
+        };
+
+        //True if a block with this header may contain frames matching the filter between fromMillis and toMillis (inclusive).
+        //False means the block can be skipped without reading its columns.
+        static bool mayContain(const Header & header, const Gm7CanProtocol::FrameFilter & filter, uint64_t fromMillis, uint64_t toMillis){
+          if(header.frameCount == 0 || header.lastMillis < fromMillis || header.firstMillis > toMillis){
+            return false;
+          }
+          if(filter.pmidLast < header.pmidMin || filter.pmidFirst > header.pmidMax){
+            return false;
+          }
+          uint32_t pages = 0;
+          for(uint16_t page = filter.pmidFirst >> 8; page <= (filter.pmidLast >> 8) && page < 32; page++){
+            pages |= (uint32_t)1 << page;
+          }
+          if((pages & header.pmidPages) == 0){
+            return false;
+          }
+          //The matching UID's lie between the UID with all free (unmasked) bits cleared and the one with all of them set
+          uint16_t uidLow = filter.uid & filter.uidMask;
+          uint16_t uidHigh = uidLow | (uint16_t)~filter.uidMask;
+          if(uidHigh < header.uidMin || uidLow > header.uidMax){
+            return false;
+          }
+          uint64_t uidBits = 0;
+          for(uint8_t low = 0; low < 64; low++){
+            if((low & filter.uidMask) == (uidLow & 63)){
+              uidBits |= getUidBit(low);
+            }
+          }
+          return (uidBits & header.uidBits) != 0;
+        };
+};
+
+class Gm7CanCaptureReader {
+  //Iterates the frames of one serialized block, without copying the block.
+    private:
+      const uint8_t * data;
+      Gm7CanCaptureBlock::Header header;
+      bool valid;
+      uint8_t index = 0;
+      uint16_t payloadPosition = 0;
+
+    public:
+        Gm7CanCaptureReader(const uint8_t * blockData, uint16_t blockSize){
+          data = blockData;
+          memset(&header, 0, sizeof(header));
+          valid = Gm7CanCaptureBlock::readHeader(blockData, blockSize, header);
+          payloadPosition = CAN_CAPTURE_HEADER_BYTES + (header.frameCount * CAN_CAPTURE_FRAME_COLUMN_BYTES);
+        };
+
+        bool isValid(){
+          return valid;
+        };
+
+        const Gm7CanCaptureBlock::Header & getHeader(){
+          return header;
+        };
+
+        bool mayContain(const Gm7CanProtocol::FrameFilter & filter, uint64_t fromMillis, uint64_t toMillis){
+          return valid && Gm7CanCaptureBlock::mayContain(header, filter, fromMillis, toMillis);
+        };
+
+        bool next(Gm7CanCaptureBlock::Frame & frame){
+          if(!valid || index >= header.frameCount){
+            return false;
+          }
+          uint8_t count = header.frameCount;
+          frame.timestampMillis = header.firstMillis + Gm7CanCaptureBlock::readUint(data, CAN_CAPTURE_HEADER_BYTES + (index * 4), 4);
+          frame.canMessageId = Gm7CanCaptureBlock::readUint(data, CAN_CAPTURE_HEADER_BYTES + (count * 4) + (index * 4), 4);
+          frame.length = data[CAN_CAPTURE_HEADER_BYTES + (count * 8) + index];
+          if(frame.length > CAN_PAYLOAD_MESSAGE_BYTES || payloadPosition + frame.length > header.blockSize){
+            valid = false;
+            return false;
+          }
+          memcpy(frame.payload, &data[payloadPosition], frame.length);
+          payloadPosition += frame.length;
+          index++;
+          return true;
+        };
+
+        //Skips frames until one matches the filter and time window
+        bool nextMatching(const Gm7CanProtocol::FrameFilter & filter, uint64_t fromMillis, uint64_t toMillis, Gm7CanCaptureBlock::Frame & frame){
+          while(next(frame)){
+            if(frame.timestampMillis >= fromMillis && frame.timestampMillis <= toMillis && Gm7CanProtocol::matchesFrameFilter(filter, frame.canMessageId)){
+              return true;
+            }
+          }
+          return false;
+        };
+};
+
+class Gm7CanCaptureIndex {
+  //The block index of a capture file (see the layout at the top). Writing is stateless: write the file header once, then an entry for
+  //every block, at the offset the block got in the capture file. Reading works on the loaded index, without copying it;
+  //nextMatching() returns the offsets of the blocks that may contain matching frames, using the same header test as the blocks.
+    private:
+      const uint8_t * data;
+      uint32_t entryCount = 0;
+      uint32_t position = 0;
+      bool valid;
+
+    public:
+        static uint16_t writeFileHeader(uint8_t * out, uint16_t outSize){
+          if(outSize < CAN_CAPTURE_INDEX_HEADER_BYTES){
+            return 0;
+          }
+          memset(out, 0, CAN_CAPTURE_INDEX_HEADER_BYTES);
+          out[0] = 'G';
+          out[1] = '7';
+          out[2] = 'C';
+          out[3] = 'I';
+          out[4] = CAN_CAPTURE_VERSION;
+          return CAN_CAPTURE_INDEX_HEADER_BYTES;
+        };
+
+        static uint16_t writeEntry(uint8_t * out, uint16_t outSize, uint64_t blockOffset, const Gm7CanCaptureBlock::Header & header){
+          if(outSize < CAN_CAPTURE_INDEX_ENTRY_BYTES){
+            return 0;
+          }
+          Gm7CanCaptureBlock::writeUint(out, 0, blockOffset, 8);
+          return Gm7CanCaptureBlock::writeHeaderFields(&out[4], header) + 4; //The header fields start at 4, after the 8 offset bytes
+        };
+
+        Gm7CanCaptureIndex(const uint8_t * indexData, uint32_t indexSize){
+          data = indexData;
+          valid = indexSize >= CAN_CAPTURE_INDEX_HEADER_BYTES && data[0] == 'G' && data[1] == '7' && data[2] == 'C' && data[3] == 'I'
+            && data[4] == CAN_CAPTURE_VERSION;
+          if(valid){
+            entryCount = (indexSize - CAN_CAPTURE_INDEX_HEADER_BYTES) / CAN_CAPTURE_INDEX_ENTRY_BYTES; //A partly written last entry is ignored
+          }
+        };
+
+        bool isValid(){
+          return valid;
+        };
+
+        uint32_t getEntryCount(){
+          return entryCount;
+        };
+
+        bool getEntry(uint32_t entry, uint64_t & blockOffset, Gm7CanCaptureBlock::Header & header){
+          if(!valid || entry >= entryCount){
+            return false;
+          }
+          const uint8_t * entryData = &data[CAN_CAPTURE_INDEX_HEADER_BYTES + (entry * CAN_CAPTURE_INDEX_ENTRY_BYTES)];
+          blockOffset = Gm7CanCaptureBlock::readUint(entryData, 0, 8);
+          Gm7CanCaptureBlock::readHeaderFields(&entryData[4], header);
+          return true;
+        };
+
+        //Returns the next block (in file order) that may contain frames matching the filter and time window
+        bool nextMatching(const Gm7CanProtocol::FrameFilter & filter, uint64_t fromMillis, uint64_t toMillis, uint64_t & blockOffset, Gm7CanCaptureBlock::Header & header){
+          while(getEntry(position, blockOffset, header)){
+            position++;
+            if(Gm7CanCaptureBlock::mayContain(header, filter, fromMillis, toMillis)){
+              return true;
+            }
+          }
+          return false;
+        };
+
+        void rewind(){
+          position = 0;
+        };
+};
+
+#endif
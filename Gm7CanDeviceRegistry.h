@@ -0,0 +1,288 @@
+/*
+  Gm7CanDeviceRegistry.h - The registered devices of a controller, with a compact snapshot to persist it (EEPROM, flash or a file)
+                           so the device list is complete again right after a controller restart.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanDeviceRegistry_h
+#define Gm7CanDeviceRegistry_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_DEVICE_REGISTRY_DEVICES
+  #define CAN_DEVICE_REGISTRY_DEVICES 16 //About 60 bytes each, and 50 bytes each in the snapshot
+#endif
+
+#define CAN_DEVICE_REGISTRY_SNAPSHOT_VERSION 1
+#define CAN_DEVICE_REGISTRY_HEADER_BYTES 10
+#define CAN_DEVICE_REGISTRY_ENTRY_BYTES (20 + (3 * CAN_PACKED_STRING_MAX_CHARS))
+
+class Gm7CanDeviceRegistry {
+  //Devices are added when they register (DEVICE_REGISTRATION_REQUEST or a device type PMID) or send device information
+  //(DEVICE_SERIAL, DEVICE_TYPE_ID, DEVICE_MODEL, DEVICE_VENDOR, DEVICE_SHORT_NAME). Any frame they send confirms them, and their
+  //STATUS_AND_PROGRESS frames are kept as last-known status.
+  //Snapshot layout, big endian:
+  //  Header: "G7RG", 8 bits version, 8 bits device count, 32 bits CRC-32 of all entry bytes
+  //  Entry:  16 bits UID, 16 bits device type id, 64 bits serial, 32 bits status, 16 bits progress, 16 bits progress max,
+  //          model, vendor and short name of CAN_PACKED_STRING_MAX_CHARS bytes each (zero padded)
+  //Save with saveSnapshot() whenever isDirty() is true (and not too often when writing to EEPROM).
+  //After loadSnapshot() on startup, the devices are known right away but unconfirmed. Their next frame (heartbeat or other traffic)
+  //confirms them; update() drops the ones that stayed silent for the confirm window, so a room is usable after about one heartbeat timeout.
+    public:
+        struct Device{
+          uint16_t uid;
+          bool used;
+          bool confirmed;   //A frame was received from it since it was added or loaded
+          uint16_t typeId;
+          uint64_t serialNumber;
+          Gm7CanProtocol::StatusAndProgress lastStatus;
+          uint32_t lastSeenMillis;
+          char model[CAN_PACKED_STRING_MAX_CHARS + 1];
+          char vendor[CAN_PACKED_STRING_MAX_CHARS + 1];
+          char shortName[CAN_PACKED_STRING_MAX_CHARS + 1];
+        };
+
+    private:
+      Device devices[CAN_DEVICE_REGISTRY_DEVICES];
+      bool dirty = false;
+      bool confirming = false;
+      uint32_t confirmDeadlineMillis = 0;
+
+      Device * findDevice(uint16_t uid, bool create){
+        Device * freeDevice = 0;
+        for(uint8_t i = 0; i < CAN_DEVICE_REGISTRY_DEVICES; i++){
+          if(devices[i].used && devices[i].uid == uid){
+            return &devices[i];
+          }
+          if(!devices[i].used && freeDevice == 0){
+            freeDevice = &devices[i];
+          }
+        }
+        if(!create || freeDevice == 0){
+          return 0;
+        }
+        memset(freeDevice, 0, sizeof(Device));
+        freeDevice->used = true;
+        freeDevice->uid = uid;
+        dirty = true;
+        return freeDevice;
+      };
+
+      static uint32_t crc32(const char * data, uint16_t length){
+        uint32_t crc = 0xFFFFFFFF;
+        for(uint16_t i = 0; i < length; i++){
+          crc ^= (uint8_t)data[i];
+          for(uint8_t bit = 0; bit < 8; bit++){
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+          }
+        }
+        return ~crc;
+      };
+
+      static void writeString(char * buffer, const char * value){
+        memset(buffer, 0, CAN_PACKED_STRING_MAX_CHARS);
+        strncpy(buffer, value, CAN_PACKED_STRING_MAX_CHARS);
+      };
+
+      //Decodes a packed string frame into value, returns true when that changed it
+      static bool setString(char * value, const char * buffer, uint8_t bufferCount){
+        char decoded[CAN_PACKED_STRING_MAX_CHARS + 1];
+        if(!Gm7CanProtocol::decodeStringFromBuffer(buffer, bufferCount, decoded, sizeof(decoded)) || strcmp(value, decoded) == 0){
+          return false;
+        }
+        strcpy(value, decoded);
+        return true;
+      };
+
+      static void readString(char * value, const char * buffer){
+        memcpy(value, buffer, CAN_PACKED_STRING_MAX_CHARS);
+        value[CAN_PACKED_STRING_MAX_CHARS] = '\0';
+      };
+
+    public:
+        Gm7CanDeviceRegistry(){
+          memset(devices, 0, sizeof(devices));
+        };
+
+        //Feed every received frame. Returns true when it changed what is persisted.
+        bool onFrame(uint32_t canMessageId, const char * buffer, uint8_t bufferCount, uint32_t nowMillis){
+          Gm7CanProtocol::Event event = Gm7CanProtocol::decodeEvent(canMessageId, buffer, bufferCount);
+          uint16_t pmid = event.messageId.pmid;
+          Device * device = findDevice(event.messageId.uid, false);
+          if(device != 0){
+            //Any frame confirms a known device, not only heartbeats: with implicit heartbeats (setImplicitHeartbeats()) a device that
+            //sends other traffic skips them
+            device->confirmed = true;
+            device->lastSeenMillis = nowMillis;
+          }
+          if(event.type == Gm7CanProtocol::EVENT_STATUS_AND_PROGRESS){
+            if(device == 0 || (device->lastStatus.status == event.statusAndProgress.status && device->lastStatus.progress == event.statusAndProgress.progress
+              && device->lastStatus.progressMax == event.statusAndProgress.progressMax)){
+              return false;
+            }
+            device->lastStatus = event.statusAndProgress;
+            dirty = true;
+            return true;
+          }
+          bool deviceInfo = pmid == Gm7CanProtocol::DEVICE_SERIAL || pmid == Gm7CanProtocol::DEVICE_TYPE_ID || pmid == Gm7CanProtocol::DEVICE_MODEL
+            || pmid == Gm7CanProtocol::DEVICE_VENDOR || pmid == Gm7CanProtocol::DEVICE_SHORT_NAME;
+          if(event.type != Gm7CanProtocol::EVENT_REGISTRATION && !deviceInfo){
+            return false;
+          }
+          bool changed = device == 0;
+          if(device == 0){
+            device = findDevice(event.messageId.uid, true);
+            if(device == 0){
+              return false;
+            }
+            device->confirmed = true; //Only a live device sends these
+            device->lastSeenMillis = nowMillis;
+          }
+          if(event.type == Gm7CanProtocol::EVENT_REGISTRATION || pmid == Gm7CanProtocol::DEVICE_TYPE_ID){
+            uint16_t typeId = event.type == Gm7CanProtocol::EVENT_REGISTRATION ? event.deviceTypeId : Gm7CanProtocol::extractDeviceTypeIdFromBuffer(buffer, bufferCount);
+            changed |= device->typeId != typeId;
+            device->typeId = typeId;
+          } else if(pmid == Gm7CanProtocol::DEVICE_SERIAL){
+            uint64_t serialNumber = Gm7CanProtocol::extractSerialNumberFromBuffer(buffer, bufferCount);
+            changed |= device->serialNumber != serialNumber;
+            device->serialNumber = serialNumber;
+          } else if(pmid == Gm7CanProtocol::DEVICE_MODEL){
+            changed |= setString(device->model, buffer, bufferCount);
+          } else if(pmid == Gm7CanProtocol::DEVICE_VENDOR){
+            changed |= setString(device->vendor, buffer, bufferCount);
+          } else {
+            changed |= setString(device->shortName, buffer, bufferCount);
+          }
+          if(changed){
+            dirty = true;
+          }
+          return changed;
+        };
+
+        //Call regularly. Drops loaded devices that were not confirmed within the confirm window.
+        void update(uint32_t nowMillis){
+          if(!confirming || (int32_t)(nowMillis - confirmDeadlineMillis) < 0){
+            return;
+          }
+          confirming = false;
+          for(uint8_t i = 0; i < CAN_DEVICE_REGISTRY_DEVICES; i++){
+            if(devices[i].used && !devices[i].confirmed){
+              devices[i].used = false;
+              dirty = true;
+            }
+          }
+        };
+
+        //True while loaded devices are still waiting for their first frame
+        bool isConfirming(){
+          return confirming;
+        };
+
+        //Changed since the last saveSnapshot() or loadSnapshot()
+        bool isDirty(){
+          return dirty;
+        };
+
+        void forget(uint16_t uid){
+          Device * device = findDevice(uid, false);
+          if(device != 0){
+            device->used = false;
+            dirty = true;
+          }
+        };
+
+        const Device * getDevice(uint16_t uid){
+          return findDevice(uid, false);
+        };
+
+        const Device * getDeviceAt(uint8_t index){
+          if(index >= CAN_DEVICE_REGISTRY_DEVICES || !devices[index].used){
+            return 0;
+          }
+          return &devices[index];
+        };
+
+        uint8_t getDeviceCount(bool confirmedOnly = false){
+          uint8_t count = 0;
+          for(uint8_t i = 0; i < CAN_DEVICE_REGISTRY_DEVICES; i++){
+            if(devices[i].used && (devices[i].confirmed || !confirmedOnly)){
+              count++;
+            }
+          }
+          return count;
+        };
+
+        uint16_t getSnapshotSize(){
+          return CAN_DEVICE_REGISTRY_HEADER_BYTES + (getDeviceCount() * CAN_DEVICE_REGISTRY_ENTRY_BYTES);
+        };
+
+        //Returns the amount of bytes written, 0 when the buffer is too small
+        uint16_t saveSnapshot(char * buffer, uint16_t bufferSize){
+          uint16_t size = getSnapshotSize();
+          if(bufferSize < size){
+            return 0;
+          }
+          uint16_t position = CAN_DEVICE_REGISTRY_HEADER_BYTES;
+          uint8_t count = 0;
+          for(uint8_t i = 0; i < CAN_DEVICE_REGISTRY_DEVICES; i++){
+            const Device & device = devices[i];
+            if(!device.used){
+              continue;
+            }
+            char * entry = &buffer[position];
+            Gm7CanProtocol::addUint16ToBuffer(entry, CAN_DEVICE_REGISTRY_ENTRY_BYTES, device.uid, 0);
+            Gm7CanProtocol::addUint16ToBuffer(entry, CAN_DEVICE_REGISTRY_ENTRY_BYTES, device.typeId, 2);
+            Gm7CanProtocol::addUint64ToBuffer(entry, CAN_DEVICE_REGISTRY_ENTRY_BYTES, device.serialNumber, 4);
+            Gm7CanProtocol::encodeModuleStatusAndProgress(&entry[12], 8, device.lastStatus);
+            writeString(&entry[20], device.model);
+            writeString(&entry[20 + CAN_PACKED_STRING_MAX_CHARS], device.vendor);
+            writeString(&entry[20 + (2 * CAN_PACKED_STRING_MAX_CHARS)], device.shortName);
+            position += CAN_DEVICE_REGISTRY_ENTRY_BYTES;
+            count++;
+          }
+          memcpy(buffer, "G7RG", 4);
+          buffer[4] = CAN_DEVICE_REGISTRY_SNAPSHOT_VERSION;
+          buffer[5] = count;
+          Gm7CanProtocol::addUint32ToBuffer(buffer, CAN_DEVICE_REGISTRY_HEADER_BYTES,
+            crc32(&buffer[CAN_DEVICE_REGISTRY_HEADER_BYTES], position - CAN_DEVICE_REGISTRY_HEADER_BYTES), 6);
+          dirty = false;
+          return position;
+        };
+
+        //Replaces the registry with the snapshot; every device starts unconfirmed and is dropped by update() when it did not
+        //send a frame within confirmWindowMillis. Returns false (and keeps the registry) for a damaged, foreign or newer snapshot.
+        bool loadSnapshot(const char * buffer, uint16_t size, uint32_t nowMillis, uint32_t confirmWindowMillis){
+          if(size < CAN_DEVICE_REGISTRY_HEADER_BYTES || memcmp(buffer, "G7RG", 4) != 0 || buffer[4] != CAN_DEVICE_REGISTRY_SNAPSHOT_VERSION){
+            return false;
+          }
+          uint8_t count = buffer[5];
+          uint16_t entriesSize = count * CAN_DEVICE_REGISTRY_ENTRY_BYTES;
+          if(count > CAN_DEVICE_REGISTRY_DEVICES || size < CAN_DEVICE_REGISTRY_HEADER_BYTES + entriesSize
+            || Gm7CanProtocol::extractUint32FromBuffer(buffer, CAN_DEVICE_REGISTRY_HEADER_BYTES, 6) != crc32(&buffer[CAN_DEVICE_REGISTRY_HEADER_BYTES], entriesSize)){
+            return false;
+          }
+          memset(devices, 0, sizeof(devices));
+          for(uint8_t i = 0; i < count; i++){
+            const char * entry = &buffer[CAN_DEVICE_REGISTRY_HEADER_BYTES + (i * CAN_DEVICE_REGISTRY_ENTRY_BYTES)];
+            Device & device = devices[i];
+            device.used = true;
+            device.uid = Gm7CanProtocol::extractUint16FromBuffer(entry, CAN_DEVICE_REGISTRY_ENTRY_BYTES, 0);
+            device.typeId = Gm7CanProtocol::extractUint16FromBuffer(entry, CAN_DEVICE_REGISTRY_ENTRY_BYTES, 2);
+            device.serialNumber = Gm7CanProtocol::extractUint64FromBuffer(entry, CAN_DEVICE_REGISTRY_ENTRY_BYTES, 4);
+            device.lastStatus = Gm7CanProtocol::decodeModuleStatusAndProgress(&entry[12], 8);
+            readString(device.model, &entry[20]);
+            readString(device.vendor, &entry[20 + CAN_PACKED_STRING_MAX_CHARS]);
+            readString(device.shortName, &entry[20 + (2 * CAN_PACKED_STRING_MAX_CHARS)]);
+          }
+          dirty = false;
+          confirming = count > 0;
+          confirmDeadlineMillis = nowMillis + confirmWindowMillis;
+          return true;
+        };
+
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*
+  Gm7CanFrameRing.h - Single writer, multiple reader broadcast ring of received GM7 CAN frames.
+                      One receiver (usually the CAN interrupt or the receiving thread) publishes every frame once,
+                      every consumer reads them with its own cursor; no frame is copied per consumer.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanFrameRing_h
+#define Gm7CanFrameRing_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_FRAME_RING_SIZE
+  #define CAN_FRAME_RING_SIZE 32 //Must be a power of 2
+#endif
+
+class Gm7CanFrameRing {
+  //The ring keeps the last CAN_FRAME_RING_SIZE frames, each stamped with a running sequence number.
+  //Readers keep their own Cursor and never block the writer. A reader that falls more than CAN_FRAME_RING_SIZE frames behind
+  //is moved forward to the oldest frame still available, and the frames it missed are added to Cursor.skipped.
+  //Every slot carries its own sequence number, which the writer changes to one no reader expects in that slot while it fills it.
+  //A reader compares it before and after copying, so a frame that was overwritten halfway through reading is never returned.
+  //The size is a power of 2, so the slot of a sequence number stays the same when the 32-bit sequence numbers wrap.
+  //The ring holds no pointers, so it can also be placed in memory that is shared between processes on a host.
+
+    public:
+        struct Frame{
+          Gm7CanProtocol::MessageId messageId;
+          uint32_t timestampMillis;
+          uint8_t length;
+          char payload[CAN_PAYLOAD_MESSAGE_BYTES];
+        };
+
+        struct Cursor{
+          uint32_t next;      //Sequence number of the next frame to read
+          uint32_t skipped;   //Frames that were overwritten before this reader got to them
+        };
+
+    private:
+      static_assert(CAN_FRAME_RING_SIZE >= 2 && (CAN_FRAME_RING_SIZE & (CAN_FRAME_RING_SIZE - 1)) == 0, "CAN_FRAME_RING_SIZE must be a power of 2");
+
+      struct Slot{
+        //Sequence number + 1 of the frame in this slot, the sequence number itself while it is being written.
+        //Readers expect sequence number + 1 and slot i only holds sequence numbers i + (n * CAN_FRAME_RING_SIZE), so that never
+        //matches, not even for the frame where the sequence numbers wrap and sequence number + 1 is 0.
+        volatile uint32_t sequence;
+        Frame frame;
+      };
+
+      Slot slots[CAN_FRAME_RING_SIZE];
+      volatile uint32_t head = 0; //Amount of frames published so far
+
+      uint32_t load(volatile uint32_t & value){
+#if defined(__AVR__)
+        uint8_t oldSREG = SREG; //32-bit reads are not atomic on AVR
+        noInterrupts();
+        uint32_t result = value;
+        SREG = oldSREG;
+        return result;
+#else
+        uint32_t result = value;
+        GM7_CAN_MEMORY_BARRIER();
+        return result;
+#endif
+      };
+
+    public:
+        Gm7CanFrameRing(){
+          for(uint16_t i = 0; i < CAN_FRAME_RING_SIZE; i++){
+            slots[i].sequence = i; //Empty, as if being written
+          }
+        };
+
+        //Only one writer may publish. Call this from the receive interrupt or the receiving thread.
+        void publish(Gm7CanProtocol::MessageId messageId, const char * payload, uint8_t length, uint32_t timestampMillis){
+          uint32_t sequence = head;
+          Slot & slot = slots[sequence & (CAN_FRAME_RING_SIZE - 1)];
+          slot.sequence = sequence;
+          GM7_CAN_MEMORY_BARRIER();
+          if(length > CAN_PAYLOAD_MESSAGE_BYTES){
+            length = CAN_PAYLOAD_MESSAGE_BYTES;
+          }
+          slot.frame.messageId = messageId;
+          slot.frame.timestampMillis = timestampMillis;
+          slot.frame.length = length;
+          for(uint8_t i = 0; i < length; i++){
+            slot.frame.payload[i] = payload[i];
+          }
+          GM7_CAN_MEMORY_BARRIER();
+          slot.sequence = sequence + 1;
+          GM7_CAN_MEMORY_BARRIER();
+          head = sequence + 1;
+        };
+
+        void publish(const Gm7CanProtocol::CanFrame & frame, uint32_t timestampMillis){
+          Gm7CanProtocol::MessageId messageId = {frame.getPmid(), frame.getUid()};
+          publish(messageId, frame.data, frame.length, timestampMillis);
+        };
+
+        //New readers start at the next frame to be published
+        Cursor createCursor(){
+          Cursor cursor = {load(head), 0};
+          return cursor;
+        };
+
+        uint32_t available(Cursor & cursor){
+          uint32_t published = load(head) - cursor.next;
+          return published > CAN_FRAME_RING_SIZE ? CAN_FRAME_RING_SIZE : published;
+        };
+
+        //Copies the next frame for this reader into frame. Returns false when the reader is up to date.
+        bool read(Cursor & cursor, Frame & frame){
+          while(true){
+            uint32_t published = load(head);
+            if(cursor.next == published){
+              return false;
+            }
+            if(published - cursor.next > CAN_FRAME_RING_SIZE){
+              cursor.skipped += published - cursor.next - CAN_FRAME_RING_SIZE;
+              cursor.next = published - CAN_FRAME_RING_SIZE;
+            }
+            Slot & slot = slots[cursor.next & (CAN_FRAME_RING_SIZE - 1)];
+            uint32_t sequenceBefore = load(slot.sequence);
+            frame = slot.frame;
+            GM7_CAN_MEMORY_BARRIER();
+            if(sequenceBefore == cursor.next + 1 && load(slot.sequence) == sequenceBefore){
+              cursor.next++;
+              return true;
+            }
+            //The writer lapped this reader while copying; retry from the oldest frame still available
+            cursor.skipped++;
+            cursor.next++;
+          }
+        };
+
+};
+
+#endif
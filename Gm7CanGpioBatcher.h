@@ -0,0 +1,231 @@
+/*
+  Gm7CanGpioBatcher.h - Collects GPIO requests during a loop and sends them with as few frames as possible.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanGpioBatcher_h
+#define Gm7CanGpioBatcher_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_GPIO_BATCHER_TARGETS
+  #define CAN_GPIO_BATCHER_TARGETS 16
+#endif
+
+class Gm7CanGpioBatcher {
+  //Requests are merged into pending ON and OFF masks: one pair per target UID, one for REQUEST_ALL_NODES_GPIO and one for REQUEST_ALL_GPIO.
+  //A later request for a pin always wins (last write order):
+  //- Turning a pin ON clears it from the pending OFF mask of the same target and vice versa.
+  //- A broadcast clears its pins from every narrower pending mask, since it would overwrite them anyway.
+  //Frames are sent broadest first (ALL, then ALL_NODES, then per target), which keeps that order on the receiving side.
+  //When the pending targets are exactly the registered nodes (see setNodes()), all with the same non-empty masks, they are sent
+  //as a single REQUEST_ALL_NODES_GPIO frame instead of one or two frames per target. Keep the node list equal to the nodes that
+  //listen to REQUEST_ALL_NODES_GPIO (no controllers, no devices that left), or the broadcast reaches devices that were not targeted.
+  //Call the set*() methods during the loop, then call nextFrame() until it returns false.
+    private:
+      struct Masks{
+        uint32_t on;
+        uint32_t off;
+      };
+
+      struct Target{
+        uint16_t uid;
+        bool used;
+        Masks masks;
+      };
+
+      Target targets[CAN_GPIO_BATCHER_TARGETS];
+      Masks allNodes = {0, 0};
+      Masks all = {0, 0};
+      uint16_t nodes[CAN_GPIO_BATCHER_TARGETS];
+      uint8_t nodeCount = 0;
+
+      bool isNode(uint16_t uid){
+        for(uint8_t i = 0; i < nodeCount; i++){
+          if(nodes[i] == uid){
+            return true;
+          }
+        }
+        return false;
+      };
+
+      static void apply(Masks & masks, uint32_t on, uint32_t off){
+        masks.on = (masks.on & ~off) | on;
+        masks.off = (masks.off & ~on) | off;
+      };
+
+      static void clearPins(Masks & masks, uint32_t pins){
+        masks.on &= ~pins;
+        masks.off &= ~pins;
+      };
+
+      Target * getTarget(uint16_t uid){
+        Target * freeTarget = 0;
+        for(uint8_t i = 0; i < CAN_GPIO_BATCHER_TARGETS; i++){
+          if(targets[i].used && targets[i].uid == uid){
+            return &targets[i];
+          }
+          if(!targets[i].used && freeTarget == 0){
+            freeTarget = &targets[i];
+          }
+        }
+        if(freeTarget != 0){
+          freeTarget->used = true;
+          freeTarget->uid = uid;
+          freeTarget->masks.on = 0;
+          freeTarget->masks.off = 0;
+        }
+        return freeTarget;
+      };
+
+      //Folds per-target masks into allNodes when the targets are exactly the registered nodes, with the same masks
+      void foldTargetsIntoAllNodes(){
+        if(nodeCount == 0){
+          return;
+        }
+        uint8_t count = 0;
+        Masks first = {0, 0};
+        for(uint8_t i = 0; i < CAN_GPIO_BATCHER_TARGETS; i++){
+          if(!targets[i].used || (targets[i].masks.on == 0 && targets[i].masks.off == 0)){
+            continue; //Nothing to send for this target
+          }
+          if(!isNode(targets[i].uid)){
+            return;
+          }
+          if(count == 0){
+            first = targets[i].masks;
+          } else if(targets[i].masks.on != first.on || targets[i].masks.off != first.off){
+            return;
+          }
+          count++;
+        }
+        if(count != nodeCount){
+          return;
+        }
+        apply(allNodes, first.on, first.off);
+        for(uint8_t i = 0; i < CAN_GPIO_BATCHER_TARGETS; i++){
+          targets[i].used = false;
+        }
+      };
+
+    public:
+        Gm7CanGpioBatcher(){
+          memset(targets, 0, sizeof(targets));
+        };
+
+        //The UID's of the nodes REQUEST_ALL_NODES_GPIO reaches (the registered modules and peripherals). Call it again when a node
+        //registers or leaves. An empty list, or more nodes than CAN_GPIO_BATCHER_TARGETS, disables folding targets into a broadcast.
+        void setNodes(const uint16_t * nodeUids, uint8_t count){
+          nodeCount = 0;
+          if(count > CAN_GPIO_BATCHER_TARGETS){
+            return; //They can never all be pending targets at once
+          }
+          for(uint8_t i = 0; i < count; i++){
+            if(!isNode(nodeUids[i])){
+              nodes[nodeCount++] = nodeUids[i];
+            }
+          }
+        };
+
+        //Returns false if no target slot is left; send the pending frames first in that case
+        bool setOn(uint16_t targetUid, uint32_t pins){
+          Target * target = getTarget(targetUid);
+          if(target == 0){
+            return false;
+          }
+          apply(target->masks, pins, 0);
+          return true;
+        };
+
+        bool setOff(uint16_t targetUid, uint32_t pins){
+          Target * target = getTarget(targetUid);
+          if(target == 0){
+            return false;
+          }
+          apply(target->masks, 0, pins);
+          return true;
+        };
+
+        void setAllNodes(uint32_t onPins, uint32_t offPins){
+          for(uint8_t i = 0; i < CAN_GPIO_BATCHER_TARGETS; i++){
+            clearPins(targets[i].masks, onPins | offPins);
+          }
+          apply(allNodes, onPins, offPins);
+        };
+
+        void setAll(uint32_t onPins, uint32_t offPins){
+          for(uint8_t i = 0; i < CAN_GPIO_BATCHER_TARGETS; i++){
+            clearPins(targets[i].masks, onPins | offPins);
+          }
+          clearPins(allNodes, onPins | offPins);
+          apply(all, onPins, offPins);
+        };
+
+        bool hasPending(){
+          if(all.on || all.off || allNodes.on || allNodes.off){
+            return true;
+          }
+          for(uint8_t i = 0; i < CAN_GPIO_BATCHER_TARGETS; i++){
+            if(targets[i].used && (targets[i].masks.on || targets[i].masks.off)){
+              return true;
+            }
+          }
+          return false;
+        };
+
+        //Returns true and fills pmid and buffer with the next frame to send. Call until it returns false.
+        bool nextFrame(uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          if(all.on || all.off){
+            if(!Gm7CanProtocol::encodeGpioMasks(buffer, bufferCount, all.on, all.off)){
+              return false;
+            }
+            pmid = Gm7CanProtocol::REQUEST_ALL_GPIO;
+            all.on = 0;
+            all.off = 0;
+            return true;
+          }
+          foldTargetsIntoAllNodes();
+          if(allNodes.on || allNodes.off){
+            if(!Gm7CanProtocol::encodeGpioMasks(buffer, bufferCount, allNodes.on, allNodes.off)){
+              return false;
+            }
+            pmid = Gm7CanProtocol::REQUEST_ALL_NODES_GPIO;
+            allNodes.on = 0;
+            allNodes.off = 0;
+            return true;
+          }
+          for(uint8_t i = 0; i < CAN_GPIO_BATCHER_TARGETS; i++){
+            Target & target = targets[i];
+            if(!target.used){
+              continue;
+            }
+            if(target.masks.on){
+              if(!Gm7CanProtocol::encodeGpioRequest(buffer, bufferCount, target.uid, target.masks.on)){
+                return false;
+              }
+              pmid = Gm7CanProtocol::REQUEST_GPIO_ON;
+              target.masks.on = 0;
+            } else if(target.masks.off){
+              if(!Gm7CanProtocol::encodeGpioRequest(buffer, bufferCount, target.uid, target.masks.off)){
+                return false;
+              }
+              pmid = Gm7CanProtocol::REQUEST_GPIO_OFF;
+              target.masks.off = 0;
+            } else {
+              target.used = false;
+              continue;
+            }
+            if(target.masks.on == 0 && target.masks.off == 0){
+              target.used = false;
+            }
+            return true;
+          }
+          return false;
+        };
+
+};
+
+#endif
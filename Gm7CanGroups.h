@@ -0,0 +1,133 @@
+/*
+  Gm7CanGroups.h - Group slots, so a controller can reach any subset of up to 48 devices with a single group request frame.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanGroups_h
+#define Gm7CanGroups_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+class Gm7CanGroupAllocator {
+  //Controller side. Hands out the 48 group slots to device UID's, usually when a device registers.
+  //Send the result of assign() and release() to the device with REQUEST_GROUP_SLOT_ASSIGN (see Gm7CanProtocol::encodeGroupSlotAssign()).
+  //getBitmap() turns a list of UID's (the modules taking part in a game, for example) into the bitmap of a group request.
+    private:
+      uint16_t uids[Gm7CanProtocol::GROUP_SLOTS];
+      uint64_t usedSlots = 0;
+
+    public:
+        Gm7CanGroupAllocator(){
+          memset(uids, 0, sizeof(uids));
+        };
+
+        //Returns the slot of the UID, the same one when it already had a slot. GROUP_SLOT_NONE when all slots are taken.
+        uint8_t assign(uint16_t uid){
+          uint8_t slot = getSlot(uid);
+          if(slot != Gm7CanProtocol::GROUP_SLOT_NONE){
+            return slot;
+          }
+          for(slot = 0; slot < Gm7CanProtocol::GROUP_SLOTS; slot++){
+            if(!((usedSlots >> slot) & 1)){
+              uids[slot] = uid;
+              usedSlots |= (uint64_t)1 << slot;
+              return slot;
+            }
+          }
+          return Gm7CanProtocol::GROUP_SLOT_NONE;
+        };
+
+        //Returns false if the UID had no slot. Tell the device with a REQUEST_GROUP_SLOT_ASSIGN for GROUP_SLOT_NONE.
+        bool release(uint16_t uid){
+          uint8_t slot = getSlot(uid);
+          if(slot == Gm7CanProtocol::GROUP_SLOT_NONE){
+            return false;
+          }
+          usedSlots &= ~((uint64_t)1 << slot);
+          return true;
+        };
+
+        uint8_t getSlot(uint16_t uid){
+          for(uint8_t slot = 0; slot < Gm7CanProtocol::GROUP_SLOTS; slot++){
+            if(((usedSlots >> slot) & 1) && uids[slot] == uid){
+              return slot;
+            }
+          }
+          return Gm7CanProtocol::GROUP_SLOT_NONE;
+        };
+
+        //Returns false for a free slot
+        bool getUidAt(uint8_t slot, uint16_t & uid){
+          if(slot >= Gm7CanProtocol::GROUP_SLOTS || !((usedSlots >> slot) & 1)){
+            return false;
+          }
+          uid = uids[slot];
+          return true;
+        };
+
+        //Bitmap of the slots of the given UID's. UID's without a slot are counted in missing; send those a separate addressed request.
+        uint64_t getBitmap(const uint16_t * targetUids, uint8_t count, uint8_t * missing = 0){
+          uint64_t bitmap = 0;
+          uint8_t notFound = 0;
+          for(uint8_t i = 0; i < count; i++){
+            uint8_t slot = getSlot(targetUids[i]);
+            if(slot == Gm7CanProtocol::GROUP_SLOT_NONE){
+              notFound++;
+            } else {
+              bitmap |= (uint64_t)1 << slot;
+            }
+          }
+          if(missing != 0){
+            *missing = notFound;
+          }
+          return bitmap;
+        };
+
+        uint64_t getUsedSlots(){
+          return usedSlots;
+        };
+
+};
+
+class Gm7CanGroupMember {
+  //Device side. Feed every received frame to onFrame(); it keeps the slot assigned to this device.
+  //isTarget() tells whether a group request includes this device, with a single bit test on the payload.
+    private:
+      uint16_t ownUid;
+      volatile uint8_t slot = Gm7CanProtocol::GROUP_SLOT_NONE;
+
+    public:
+        Gm7CanGroupMember(uint16_t ownDeviceUid){
+          ownUid = ownDeviceUid;
+        };
+
+        //Returns true when the frame was a slot assignment for this device
+        bool onFrame(uint32_t canMessageId, const char * buffer, uint8_t bufferCount){
+          if(Gm7CanProtocol::parseMessageId(canMessageId).pmid != Gm7CanProtocol::REQUEST_GROUP_SLOT_ASSIGN){
+            return false;
+          }
+          Gm7CanProtocol::GroupSlotAssign assign = Gm7CanProtocol::decodeGroupSlotAssign(buffer, bufferCount);
+          if(bufferCount < 3 || assign.targetUid != ownUid){
+            return false;
+          }
+          slot = assign.slot;
+          return true;
+        };
+
+        //True for group requests (REQUEST_GROUP_SECTION) with the bit of this device set
+        bool isTarget(uint32_t canMessageId, const char * buffer, uint8_t bufferCount){
+          uint16_t pmid = Gm7CanProtocol::parseMessageId(canMessageId).pmid;
+          return pmid > Gm7CanProtocol::REQUEST_GROUP_SECTION_START && pmid < Gm7CanProtocol::REQUEST_GROUP_SECTION_END
+            && Gm7CanProtocol::isGroupTarget(buffer, bufferCount, slot);
+        };
+
+        uint8_t getSlot(){
+          return slot;
+        };
+
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+  Gm7CanHeartbeatAnalyzer.h - Receive-side heartbeat statistics per node, used to tune the heartbeat interval and timeout from data.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanHeartbeatAnalyzer_h
+#define Gm7CanHeartbeatAnalyzer_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+#include "Gm7CanMetrics.h"
+
+#ifndef CAN_HEARTBEAT_ANALYZER_NODES
+  #define CAN_HEARTBEAT_ANALYZER_NODES 16
+#endif
+
+class Gm7CanHeartbeatAnalyzer {
+  //Every heartbeat carries the senders millis() (millisCurrent) and the millis() of its previous heartbeat (millisLast).
+  //Combined with the local arrival time this gives, per node:
+  //- jitter: how much the gap between two arrivals differs from the period the sender actually used (millisCurrent - millisLast).
+  //  This is the delay added by the bus, queues and the receiving loop. Kept in log2 buckets (see Gm7CanMetrics).
+  //- missed beats: when millisLast is not the millisCurrent we saw last, the sender sent heartbeats that never arrived here.
+  //- the largest gap between two arrivals. Gaps caused by the sender restarting (its millis() going backwards) are not counted,
+  //  since the node really was offline then.
+  //The largest gap over all nodes is the tightest timeout that would not have caused a single false offline event during the window.
+    public:
+        struct NodeStats{
+          uint16_t uid;
+          bool used;
+          uint32_t lastRemoteMillis;
+          uint32_t lastArrivalMillis;
+          uint32_t beats;
+          uint32_t missedBeats;
+          uint32_t restarts;
+          uint32_t maxArrivalGapMillis;   //Since startWindow()
+          uint16_t jitter[CAN_METRICS_HISTOGRAM_BUCKETS];
+        };
+
+    private:
+      NodeStats nodes[CAN_HEARTBEAT_ANALYZER_NODES];
+      uint32_t windowStartMillis = 0;
+      uint32_t maxArrivalGapMillis = 0;
+
+      NodeStats * findNode(uint16_t uid, bool create){
+        for(uint8_t i = 0; i < CAN_HEARTBEAT_ANALYZER_NODES; i++){
+          if(nodes[i].used && nodes[i].uid == uid){
+            return &nodes[i];
+          }
+        }
+        if(!create){
+          return 0;
+        }
+        for(uint8_t i = 0; i < CAN_HEARTBEAT_ANALYZER_NODES; i++){
+          if(!nodes[i].used){
+            memset(&nodes[i], 0, sizeof(NodeStats));
+            nodes[i].used = true;
+            nodes[i].uid = uid;
+            return &nodes[i];
+          }
+        }
+        return 0;
+      };
+
+    public:
+        Gm7CanHeartbeatAnalyzer(){
+          memset(nodes, 0, sizeof(nodes));
+        };
+
+        //Feed every received heartbeat. Returns false if there is no room left to track this node.
+        bool onHeartbeat(uint16_t uid, Gm7CanProtocol::Heartbeat heartbeat, uint32_t arrivalMillis){
+          NodeStats * node = findNode(uid, true);
+          if(node == 0){
+            return false;
+          }
+          if(node->beats != 0){
+            uint32_t arrivalGap = arrivalMillis - node->lastArrivalMillis;
+            if(heartbeat.millisCurrent < node->lastRemoteMillis){
+              node->restarts++;
+            } else {
+              if(heartbeat.millisLast != 0 && heartbeat.millisLast != node->lastRemoteMillis){
+                uint32_t period = heartbeat.millisCurrent - heartbeat.millisLast;
+                uint32_t missed = period == 0 ? 1 : (heartbeat.millisCurrent - node->lastRemoteMillis + (period / 2)) / period;
+                node->missedBeats += missed > 1 ? missed - 1 : 1;
+              } else if(heartbeat.millisLast != 0){
+                uint32_t period = heartbeat.millisCurrent - heartbeat.millisLast;
+                uint32_t jitter = arrivalGap > period ? arrivalGap - period : period - arrivalGap;
+                uint16_t & count = node->jitter[Gm7CanMetrics::getHistogramBucket(jitter)];
+                if(count != 0xFFFF){
+                  count++;
+                }
+              }
+              if(arrivalGap > node->maxArrivalGapMillis){
+                node->maxArrivalGapMillis = arrivalGap;
+              }
+              if(arrivalGap > maxArrivalGapMillis){
+                maxArrivalGapMillis = arrivalGap;
+              }
+            }
+          }
+          node->beats++;
+          node->lastRemoteMillis = heartbeat.millisCurrent;
+          node->lastArrivalMillis = arrivalMillis;
+          return true;
+        };
+
+        //Starts a new measuring window for the largest arrival gaps. Beat, missed beat and jitter counts are kept.
+        void startWindow(uint32_t nowMillis){
+          windowStartMillis = nowMillis;
+          maxArrivalGapMillis = 0;
+          for(uint8_t i = 0; i < CAN_HEARTBEAT_ANALYZER_NODES; i++){
+            nodes[i].maxArrivalGapMillis = 0;
+          }
+        };
+
+        uint32_t getWindowStartMillis(){
+          return windowStartMillis;
+        };
+
+        uint32_t getMaxArrivalGapMillis(){
+          return maxArrivalGapMillis;
+        };
+
+        //The tightest timeout that would have kept every node online during the window, plus a safety margin in percent.
+        //Returns 0 when no gaps were measured yet.
+        uint32_t getSuggestedTimeoutMillis(uint8_t marginPercent = 10){
+          return maxArrivalGapMillis + ((maxArrivalGapMillis * marginPercent) / 100);
+        };
+
+        NodeStats * getNodeStats(uint16_t uid){
+          return findNode(uid, false);
+        };
+
+        NodeStats * getNodeStatsAt(uint8_t index){
+          if(index >= CAN_HEARTBEAT_ANALYZER_NODES || !nodes[index].used){
+            return 0;
+          }
+          return &nodes[index];
+        };
+
+};
+
+#endif
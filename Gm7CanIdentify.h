@@ -0,0 +1,142 @@
+/*
+  Gm7CanIdentify.h - Discovering every device on the bus in one round, in a time that is known up front.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanIdentify_h
+#define Gm7CanIdentify_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+class Gm7CanIdentifyRound {
+  //Controller side. begin() returns the REQUEST_ALL_IDENTIFY frame to send and starts the round; isComplete() turns true when every
+  //device has answered, also when many UID's share the last slot (see getIdentifyDurationMillis() for the conditions). Feed the device info frames that come in to a Gm7CanDeviceRegistry to end up with the whole room.
+  //Devices that missed the request are simply not in this round; start a new one (with a new round number) to ask again.
+    private:
+      uint8_t round = 0;
+      bool running = false;
+      uint32_t startMillis = 0;
+      uint32_t durationMillis = 0;
+
+    public:
+        //nodeCountHint is the amount of devices expected (the size of the registry, or a guess); more slots than needed only make the round longer.
+        //baudrate is that of the bus, it sets the time a crowded slot can take.
+        bool begin(uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount, uint8_t nodeCountHint,
+          uint16_t slotMillis = Gm7CanProtocol::IDENTIFY_SLOT_MILLIS_DEFAULT, uint32_t baudrate = 125000){
+          if(!Gm7CanProtocol::encodeIdentifyRequest(buffer, bufferCount, nodeCountHint, slotMillis, round + 1)){
+            return false;
+          }
+          pmid = Gm7CanProtocol::REQUEST_ALL_IDENTIFY;
+          round++;
+          running = true;
+          startMillis = nowMillis;
+          durationMillis = Gm7CanProtocol::getIdentifyDurationMillis(nodeCountHint, slotMillis, baudrate);
+          return true;
+        };
+
+        bool isRunning(uint32_t nowMillis){
+          return running && !isComplete(nowMillis);
+        };
+
+        bool isComplete(uint32_t nowMillis){
+          return running && nowMillis - startMillis >= durationMillis;
+        };
+
+        uint32_t getDurationMillis(){
+          return durationMillis;
+        };
+
+        uint8_t getRound(){
+          return round;
+        };
+
+};
+
+class Gm7CanIdentifyResponder {
+  //Device side. Feed every received frame to onFrame() and call poll() from the loop; it returns the device info frames of this device,
+  //one per call, once the slot of this device has come. The strings are not copied, they have to stay valid; pass 0 to leave one out.
+  //A repeated request with the same round number is ignored, so a controller can resend a request without doubling the traffic.
+    private:
+      uint16_t ownUid;
+      uint64_t serialNumber;
+      uint16_t typeId;
+      const char * model;
+      const char * vendor;
+      const char * shortName;
+      bool pending = false;
+      bool answered = false;
+      uint8_t lastRound = 0;
+      uint8_t nextFrame = 0;
+      uint32_t sendAtMillis = 0;
+
+    public:
+        Gm7CanIdentifyResponder(uint16_t ownDeviceUid, uint64_t deviceSerialNumber, uint16_t deviceTypeId,
+          const char * deviceModel = 0, const char * deviceVendor = 0, const char * deviceShortName = 0){
+          ownUid = ownDeviceUid;
+          serialNumber = deviceSerialNumber;
+          typeId = deviceTypeId;
+          model = deviceModel;
+          vendor = deviceVendor;
+          shortName = deviceShortName;
+        };
+
+        //Returns true when the frame started a new identify round for this device
+        bool onFrame(uint32_t canMessageId, const char * buffer, uint8_t bufferCount, uint32_t nowMillis){
+          if(Gm7CanProtocol::parseMessageId(canMessageId).pmid != Gm7CanProtocol::REQUEST_ALL_IDENTIFY || bufferCount < 4){
+            return false;
+          }
+          Gm7CanProtocol::IdentifyRequest request = Gm7CanProtocol::decodeIdentifyRequest(buffer, bufferCount);
+          if(answered && request.round == lastRound){
+            return false;
+          }
+          uint16_t slot = Gm7CanProtocol::getIdentifySlot(ownUid, Gm7CanProtocol::getIdentifySlotCount(request.nodeCountHint));
+          lastRound = request.round;
+          answered = true;
+          pending = true;
+          nextFrame = 0;
+          sendAtMillis = nowMillis + ((uint32_t)slot * request.slotMillis);
+          return true;
+        };
+
+        //Returns true and fills pmid and buffer when a frame should be sent now
+        bool poll(uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          if(!pending || (int32_t)(nowMillis - sendAtMillis) < 0){
+            return false;
+          }
+          while(nextFrame < Gm7CanProtocol::IDENTIFY_FRAMES_PER_DEVICE){
+            uint8_t frame = nextFrame++;
+            if(frame == 0 && Gm7CanProtocol::encodeTypeIdToBuffer(buffer, bufferCount, typeId)){
+              pmid = Gm7CanProtocol::DEVICE_TYPE_ID;
+              return true;
+            }
+            if(frame == 1 && Gm7CanProtocol::encodeSerialNumberToBuffer(buffer, bufferCount, serialNumber)){
+              pmid = Gm7CanProtocol::DEVICE_SERIAL;
+              return true;
+            }
+            if(frame == 2 && model != 0 && Gm7CanProtocol::encodeModelToBuffer(buffer, bufferCount, model)){
+              pmid = Gm7CanProtocol::DEVICE_MODEL;
+              return true;
+            }
+            if(frame == 3 && vendor != 0 && Gm7CanProtocol::encodeVendorToBuffer(buffer, bufferCount, vendor)){
+              pmid = Gm7CanProtocol::DEVICE_VENDOR;
+              return true;
+            }
+            if(frame == 4 && shortName != 0 && Gm7CanProtocol::encodeShortNameToBuffer(buffer, bufferCount, shortName)){
+              pmid = Gm7CanProtocol::DEVICE_SHORT_NAME;
+              return true;
+            }
+          }
+          pending = false;
+          return false;
+        };
+
+        bool isPending(){
+          return pending;
+        };
+
+};
+
+#endif
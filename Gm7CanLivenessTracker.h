@@ -0,0 +1,153 @@
+/*
+  Gm7CanLivenessTracker.h - Keeps track of which devices on the bus are online, based on heartbeats or on any traffic.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanLivenessTracker_h
+#define Gm7CanLivenessTracker_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_LIVENESS_TRACKER_NODES
+  #define CAN_LIVENESS_TRACKER_NODES 32
+#endif
+
+class Gm7CanLivenessTracker {
+  //A device is online when it was heard from within the heartbeat timeout treshold of the protocol.
+  //In the default (explicit) mode only heartbeat PMID's count. In implicit mode every frame from a UID counts,
+  //which is required for devices that use Gm7CanProtocol::setImplicitHeartbeats() and skip heartbeats while they are sending other frames.
+  //In implicit mode, also feed the frames that Gm7CanProtocol::isAddressedToOtherDevice() drops, before they are dropped.
+  //The timeout is read from the protocol on every check, so it follows adaptive heartbeat timing.
+    public:
+        typedef void (*LivenessCallback)(uint16_t uid, bool online);
+
+        struct Node{
+          uint16_t uid;
+          bool used;
+          bool online;
+          uint8_t canDeviceType;  //Taken from the heartbeat PMID, 0 until a heartbeat was seen
+          uint32_t lastSeenMillis;
+        };
+
+    private:
+      Gm7CanProtocol & protocol;
+      bool implicit;
+      Node nodes[CAN_LIVENESS_TRACKER_NODES];
+      LivenessCallback callback = 0;
+
+    public:
+        Gm7CanLivenessTracker(Gm7CanProtocol & canProtocol, bool implicitLiveness = false) : protocol(canProtocol){
+          implicit = implicitLiveness;
+          memset(nodes, 0, sizeof(nodes));
+        };
+
+        void setImplicitLiveness(bool enabled){
+          implicit = enabled;
+        };
+
+        //Called from update() whenever a device goes online or offline
+        void setCallback(LivenessCallback livenessCallback){
+          callback = livenessCallback;
+        };
+
+        //Feed every received frame. Returns false if the frame did not refresh anything (not a heartbeat in explicit mode, or no room left).
+        bool onFrame(uint32_t canMessageId, uint32_t nowMillis){
+          Gm7CanProtocol::MessageId messageId = Gm7CanProtocol::parseMessageId(canMessageId);
+          bool heartbeat = messageId.pmid > Gm7CanProtocol::HEARTBEATS_START && messageId.pmid < Gm7CanProtocol::HEARTBEATS_END;
+          if(!heartbeat && !implicit){
+            return false;
+          }
+          Node * node = 0;
+          Node * freeNode = 0;
+          for(uint8_t i = 0; i < CAN_LIVENESS_TRACKER_NODES; i++){
+            if(nodes[i].used && nodes[i].uid == messageId.uid){
+              node = &nodes[i];
+              break;
+            }
+            if(!nodes[i].used && freeNode == 0){
+              freeNode = &nodes[i];
+            }
+          }
+          if(node == 0){
+            if(freeNode == 0){
+              return false;
+            }
+            node = freeNode;
+            node->used = true;
+            node->uid = messageId.uid;
+            node->online = false;
+            node->canDeviceType = 0;
+          }
+          if(heartbeat){
+            node->canDeviceType = Gm7CanProtocol::getCanDeviceTypeForPmid(messageId.pmid);
+          }
+          node->lastSeenMillis = nowMillis;
+          if(!node->online){
+            node->online = true;
+            if(callback != 0){
+              callback(node->uid, true);
+            }
+          }
+          return true;
+        };
+
+        //Call regularly to detect devices that went offline
+        void update(uint32_t nowMillis){
+          uint32_t timeout = protocol.getHeartbeatTimeoutTresholdInMillis();
+          for(uint8_t i = 0; i < CAN_LIVENESS_TRACKER_NODES; i++){
+            if(nodes[i].used && nodes[i].online && nowMillis - nodes[i].lastSeenMillis > timeout){
+              nodes[i].online = false;
+              if(callback != 0){
+                callback(nodes[i].uid, false);
+              }
+            }
+          }
+        };
+
+        bool isOnline(uint16_t uid, uint32_t nowMillis){
+          const Node * node = getNode(uid);
+          return node != 0 && nowMillis - node->lastSeenMillis <= protocol.getHeartbeatTimeoutTresholdInMillis();
+        };
+
+        uint8_t getOnlineCount(uint32_t nowMillis){
+          uint8_t count = 0;
+          uint32_t timeout = protocol.getHeartbeatTimeoutTresholdInMillis();
+          for(uint8_t i = 0; i < CAN_LIVENESS_TRACKER_NODES; i++){
+            if(nodes[i].used && nowMillis - nodes[i].lastSeenMillis <= timeout){
+              count++;
+            }
+          }
+          return count;
+        };
+
+        const Node * getNode(uint16_t uid){
+          for(uint8_t i = 0; i < CAN_LIVENESS_TRACKER_NODES; i++){
+            if(nodes[i].used && nodes[i].uid == uid){
+              return &nodes[i];
+            }
+          }
+          return 0;
+        };
+
+        const Node * getNodeAt(uint8_t index){
+          if(index >= CAN_LIVENESS_TRACKER_NODES || !nodes[index].used){
+            return 0;
+          }
+          return &nodes[index];
+        };
+
+        //Frees the entry of a device that is not expected to come back
+        void forget(uint16_t uid){
+          for(uint8_t i = 0; i < CAN_LIVENESS_TRACKER_NODES; i++){
+            if(nodes[i].used && nodes[i].uid == uid){
+              nodes[i].used = false;
+            }
+          }
+        };
+
+};
+
+#endif
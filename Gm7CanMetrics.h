@@ -0,0 +1,274 @@
+/*
+  Gm7CanMetrics.h - Traffic counters per PMID section and per UID for GM7 CAN devices.
+                    Answers "who is flooding the bus" and "how regular is the traffic" in production.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanMetrics_h
+#define Gm7CanMetrics_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+//Metrics are disabled by default. Add #define GM7_CAN_METRICS before including this file to enable them.
+//When disabled, Gm7CanMetrics holds no data and every method is empty and inline, so the calls leave no code or RAM use in the binary.
+//Only the static helpers (getSection(), getHistogramBucket()) remain, and only when they are called.
+//All storage is fixed: one set of counters per PMID section and CAN_METRICS_UID_SLOTS sets of counters for UID's.
+//The UID counters are an open addressed hash table with "space saving" eviction: when a new UID finds the table full, it takes over the
+//counters of the UID with the fewest frames and starts from that count (kept in overcountFrames). A UID that sends more than
+//1 / CAN_METRICS_UID_SLOTS of all frames is therefore always in the table, so the node flooding the bus is found even with more UID's than
+//slots, and its real frame count is between receivedFrames - overcountFrames and receivedFrames. Evictions are counted in uidEvictions.
+//Known UID's cost a couple of compares per frame; a new UID on a full table walks the whole table once.
+//Inter-arrival times are kept in log2 buckets: bucket 0 counts 0 millis, bucket n counts 2^(n-1) up to 2^n - 1 millis, the last bucket counts anything longer.
+#ifndef CAN_METRICS_UID_SLOTS
+  #define CAN_METRICS_UID_SLOTS 16 //Must be a power of 2
+#endif
+#define CAN_METRICS_HISTOGRAM_BUCKETS 12
+
+class Gm7CanMetrics {
+    public:
+        enum Section : uint8_t {
+          SECTION_EMERGENCY = 0,
+          SECTION_HEARTBEAT = 1,
+          SECTION_STATUS = 2,
+          SECTION_REQUEST = 3,
+          SECTION_DEVICE = 4,
+          SECTION_DEVICE_TYPE = 5,
+          SECTION_CONTROLLER = 6,
+          SECTION_MODULE = 7,
+          SECTION_PERIPHERAL = 8,
+          SECTION_EXTERNAL_DEVICE = 9,
+          SECTION_OTHER = 10,
+          SECTION_COUNT = 11
+        };
+
+        struct SectionCounters{
+          uint32_t receivedFrames;
+          uint32_t receivedBytes;
+          uint32_t sentFrames;
+          uint32_t sentBytes;
+          uint32_t errors;            //Frames that could not be decoded or encoded
+          uint32_t droppedFrames;     //Frames dropped before dispatch, like addressed requests for other devices
+          uint32_t lastReceivedMillis;
+          uint16_t interArrival[CAN_METRICS_HISTOGRAM_BUCKETS];
+        };
+
+        struct UidCounters{
+          uint16_t uid;
+          bool used;
+          uint32_t receivedFrames;
+          uint32_t overcountFrames;   //Frames inherited from the evicted UID, at most this many of receivedFrames (and bytes) were someone else's
+          uint32_t receivedBytes;
+          uint32_t errors;
+          uint32_t lastReceivedMillis;
+          uint16_t interArrival[CAN_METRICS_HISTOGRAM_BUCKETS];
+        };
+
+        struct Snapshot{
+          SectionCounters sections[SECTION_COUNT];
+          UidCounters uids[CAN_METRICS_UID_SLOTS];
+          uint32_t uidEvictions;
+        };
+
+        //Follows the section boundaries of the PMID SECTION in Gm7CanProtocol.h, ordered by how often frames are expected
+        static Section getSection(uint16_t pmid){
+          if(pmid <= Gm7CanProtocol::EMERGENCY_SECTION_END) { return SECTION_EMERGENCY; }
+          if(pmid < Gm7CanProtocol::STATUS_SECTION_START) {
+            return pmid >= Gm7CanProtocol::HEARTBEATS_START && pmid <= Gm7CanProtocol::HEARTBEATS_END ? SECTION_HEARTBEAT : SECTION_OTHER;
+          }
+          if(pmid >= Gm7CanProtocol::CONTROLLER_SECTION_START && pmid <= Gm7CanProtocol::EXTERNAL_DEVICE_SECTION_END) {
+            //The four device sections have the same size
+            return (Section)(SECTION_CONTROLLER + ((pmid - Gm7CanProtocol::CONTROLLER_SECTION_START) / (Gm7CanProtocol::MODULE_SECTION_START - Gm7CanProtocol::CONTROLLER_SECTION_START)));
+          }
+          if(pmid <= Gm7CanProtocol::STATUS_SECTION_END) { return SECTION_STATUS; }
+          if(pmid >= Gm7CanProtocol::REQUEST_SECTION_START && pmid <= Gm7CanProtocol::RESPONSE_SECTION_END) { return SECTION_REQUEST; } //Requests and their responses
+          if(pmid >= Gm7CanProtocol::DEVICE_SECTION_START && pmid <= Gm7CanProtocol::DEVICE_SECTION_END) { return SECTION_DEVICE; }
+          if(pmid >= Gm7CanProtocol::DEVICE_TYPE_SECTION_START && pmid <= Gm7CanProtocol::DEVICE_TYPE_SECTION_END) { return SECTION_DEVICE_TYPE; }
+          return SECTION_OTHER;
+        };
+
+        static uint8_t getHistogramBucket(uint32_t millis){
+          if(millis == 0){
+            return 0;
+          }
+          uint8_t bucket = (sizeof(unsigned long) * 8) - __builtin_clzl(millis); //Bit length, a single instruction on most cores
+          return bucket < CAN_METRICS_HISTOGRAM_BUCKETS ? bucket : CAN_METRICS_HISTOGRAM_BUCKETS - 1;
+        };
+
+        static bool isEnabled(){
+#ifdef GM7_CAN_METRICS
+          return true;
+#else
+          return false;
+#endif
+        };
+
+#ifdef GM7_CAN_METRICS
+    private:
+      static_assert(CAN_METRICS_UID_SLOTS >= 1 && (CAN_METRICS_UID_SLOTS & (CAN_METRICS_UID_SLOTS - 1)) == 0, "CAN_METRICS_UID_SLOTS must be a power of 2");
+
+      Snapshot data;
+
+      static void addToHistogram(uint16_t * histogram, uint32_t interArrivalMillis){
+        uint16_t & count = histogram[getHistogramBucket(interArrivalMillis)];
+        if(count != 0xFFFF){
+          count++;
+        }
+      };
+
+      static uint16_t getUidSlot(uint16_t uid){
+        return (uint16_t)(uid * 40503u) & (CAN_METRICS_UID_SLOTS - 1); //Fibonacci hashing, UID's are often sequential
+      };
+
+      //Finds the counters of a UID. When create is set, a new UID takes a free slot, or evicts the UID with the fewest frames.
+      UidCounters * getUidCounters(uint16_t uid, bool create){
+        uint16_t slot = getUidSlot(uid);
+        UidCounters * fewest = 0;
+        for(uint16_t i = 0; i < CAN_METRICS_UID_SLOTS; i++){
+          UidCounters & counters = data.uids[(slot + i) & (CAN_METRICS_UID_SLOTS - 1)];
+          if(counters.used && counters.uid == uid){
+            return &counters;
+          }
+          if(!counters.used){
+            if(!create){
+              return 0;
+            }
+            counters.used = true;
+            counters.uid = uid;
+            return &counters;
+          }
+          if(fewest == 0 || counters.receivedFrames < fewest->receivedFrames){
+            fewest = &counters;
+          }
+        }
+        if(!create){
+          return 0;
+        }
+        //Evicting in place keeps every probe sequence intact, slots never become free again until reset()
+        uint32_t frames = fewest->receivedFrames;
+        uint32_t bytes = fewest->receivedBytes;
+        memset(fewest, 0, sizeof(UidCounters));
+        fewest->used = true;
+        fewest->uid = uid;
+        fewest->receivedFrames = frames;
+        fewest->receivedBytes = bytes;
+        fewest->overcountFrames = frames;
+        data.uidEvictions++;
+        return fewest;
+      };
+
+      //On AVR interrupts are held off during the copy, so counters updated from the receive interrupt stay consistent
+      static void copyAtomic(void * destination, const void * source, size_t size){
+  #if defined(__AVR__)
+        uint8_t oldSREG = SREG;
+        noInterrupts();
+        memcpy(destination, source, size);
+        SREG = oldSREG;
+  #else
+        memcpy(destination, source, size);
+  #endif
+      };
+
+    public:
+        Gm7CanMetrics(){
+          reset();
+        };
+
+        void reset(){
+          memset(&data, 0, sizeof(data));
+        };
+
+        void recordReceived(uint32_t canMessageId, uint8_t length, uint32_t nowMillis){
+          SectionCounters & section = data.sections[getSection((canMessageId >> 16) & 0x1FFF)];
+          if(section.receivedFrames != 0){
+            addToHistogram(section.interArrival, nowMillis - section.lastReceivedMillis);
+          }
+          section.receivedFrames++;
+          section.receivedBytes += length;
+          section.lastReceivedMillis = nowMillis;
+          UidCounters * uid = getUidCounters(canMessageId & 0xFFFF, true);
+          if(uid->receivedFrames != uid->overcountFrames){
+            addToHistogram(uid->interArrival, nowMillis - uid->lastReceivedMillis);
+          }
+          uid->receivedFrames++;
+          uid->receivedBytes += length;
+          uid->lastReceivedMillis = nowMillis;
+        };
+
+        void recordSent(uint32_t canMessageId, uint8_t length){
+          SectionCounters & section = data.sections[getSection((canMessageId >> 16) & 0x1FFF)];
+          section.sentFrames++;
+          section.sentBytes += length;
+        };
+
+        //For frames that could not be decoded (a too short payload for example) or could not be encoded
+        void recordError(uint32_t canMessageId){
+          data.sections[getSection((canMessageId >> 16) & 0x1FFF)].errors++;
+          UidCounters * uid = getUidCounters(canMessageId & 0xFFFF, false);
+          if(uid != 0){
+            uid->errors++;
+          }
+        };
+
+        //For frames dropped before they reached the application, see Gm7CanProtocol::isAddressedToOtherDevice()
+        void recordDropped(uint32_t canMessageId){
+          data.sections[getSection((canMessageId >> 16) & 0x1FFF)].droppedFrames++;
+        };
+
+        //Copies all counters at once into snapshot (over 1 KB, so not on a small stack). Returns false when metrics are disabled.
+        bool copySnapshot(Snapshot & snapshot){
+          copyAtomic(&snapshot, &data, sizeof(Snapshot));
+          return true;
+        };
+
+        //Copies the counters of one section; cheap enough for the stack of any board
+        bool copySection(uint8_t section, SectionCounters & counters){
+          if(section >= SECTION_COUNT){
+            return false;
+          }
+          copyAtomic(&counters, &data.sections[section], sizeof(SectionCounters));
+          return true;
+        };
+
+        //Copies the counters of one UID slot, returns false for an unused slot. Walk all slots to find the busiest UID's.
+        bool copyUidSlot(uint8_t slot, UidCounters & counters){
+          if(slot >= CAN_METRICS_UID_SLOTS){
+            return false;
+          }
+          copyAtomic(&counters, &data.uids[slot], sizeof(UidCounters));
+          return counters.used;
+        };
+
+        //Copies the counters of a UID, returns false when it is not in the table (it sent few or no frames)
+        bool copyUid(uint16_t uid, UidCounters & counters){
+          UidCounters * found = getUidCounters(uid, false);
+          if(found == 0){
+            return false;
+          }
+          copyAtomic(&counters, found, sizeof(UidCounters));
+          return true;
+        };
+
+        uint32_t getUidEvictions(){
+          return data.uidEvictions;
+        };
+#else
+    public:
+        //Disabled: no data and empty methods, the calls compile to nothing
+        void reset(){};
+        void recordReceived(uint32_t, uint8_t, uint32_t){};
+        void recordSent(uint32_t, uint8_t){};
+        void recordError(uint32_t){};
+        void recordDropped(uint32_t){};
+        bool copySnapshot(Snapshot &){ return false; };
+        bool copySection(uint8_t, SectionCounters &){ return false; };
+        bool copyUidSlot(uint8_t, UidCounters &){ return false; };
+        bool copyUid(uint16_t, UidCounters &){ return false; };
+        uint32_t getUidEvictions(){ return 0; };
+#endif
+
+};
+
+#endif
@@ -0,0 +1,179 @@
+/*
+  Gm7CanOnlineMap.h - Liveness of the whole room, computed once by the controller and broadcast as a bitmap.
+                      Modules read the online state of their peers from that bitmap instead of listening to every heartbeat.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanOnlineMap_h
+#define Gm7CanOnlineMap_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+#include "Gm7CanLivenessTracker.h"
+#include "Gm7CanGroups.h"
+
+class Gm7CanOnlineBroadcaster {
+  //Controller side. Every intervalMillis, and right away when a device goes online or offline, poll() returns a CONTROLLER_ONLINE_BITMAP frame
+  //with the online state (from the liveness tracker) of every device that has a group slot.
+  //Modules only need the heartbeats of the controller then: without a controller nobody updates the bitmap anyway.
+  //Modules can only map bits to UID's when they know the slot assignments, and a module that boots after the room registered
+  //(or a controller restart that handed out new slots) would never see them. So between bitmaps poll() also repeats the assignment
+  //of one slot every assignmentIntervalMillis, cycling through all used slots (48 slots take 12 seconds at the default 250 millis).
+  //This is required for Gm7CanOnlineMap: send every frame poll() returns. 0 as assignmentIntervalMillis turns the repeats off.
+    private:
+      Gm7CanLivenessTracker & tracker;
+      Gm7CanGroupAllocator & groups;
+      uint32_t intervalMillis;
+      uint32_t assignmentIntervalMillis;
+      uint32_t lastSentMillis = 0;
+      uint32_t lastAssignmentMillis = 0;
+      uint64_t lastBitmap = 0;
+      uint8_t nextAssignmentSlot = 0;
+      bool sentOnce = false;
+
+      //The assignment of the next used slot after the previous one, false when no slot is used
+      bool nextAssignment(char * buffer, uint8_t bufferCount){
+        uint16_t uid;
+        for(uint8_t i = 0; i < Gm7CanProtocol::GROUP_SLOTS; i++){
+          uint8_t slot = (nextAssignmentSlot + i) % Gm7CanProtocol::GROUP_SLOTS;
+          if(groups.getUidAt(slot, uid)){
+            nextAssignmentSlot = (slot + 1) % Gm7CanProtocol::GROUP_SLOTS;
+            return Gm7CanProtocol::encodeGroupSlotAssign(buffer, bufferCount, uid, slot);
+          }
+        }
+        return false;
+      };
+
+    public:
+        Gm7CanOnlineBroadcaster(Gm7CanLivenessTracker & livenessTracker, Gm7CanGroupAllocator & groupAllocator, uint32_t broadcastIntervalMillis = 1000,
+          uint32_t slotAssignmentIntervalMillis = 250)
+          : tracker(livenessTracker), groups(groupAllocator){
+          intervalMillis = broadcastIntervalMillis;
+          assignmentIntervalMillis = slotAssignmentIntervalMillis;
+        };
+
+        uint64_t getBitmap(uint32_t nowMillis){
+          uint64_t bitmap = 0;
+          uint16_t uid;
+          for(uint8_t slot = 0; slot < Gm7CanProtocol::GROUP_SLOTS; slot++){
+            if(groups.getUidAt(slot, uid) && tracker.isOnline(uid, nowMillis)){
+              bitmap |= (uint64_t)1 << slot;
+            }
+          }
+          return bitmap;
+        };
+
+        //Returns true and fills pmid and buffer when the bitmap or a repeated slot assignment should be sent now
+        bool poll(uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          uint64_t bitmap = getBitmap(nowMillis);
+          if(sentOnce && bitmap == lastBitmap && nowMillis - lastSentMillis < intervalMillis){
+            if(assignmentIntervalMillis == 0 || nowMillis - lastAssignmentMillis < assignmentIntervalMillis || !nextAssignment(buffer, bufferCount)){
+              return false;
+            }
+            pmid = Gm7CanProtocol::REQUEST_GROUP_SLOT_ASSIGN;
+            lastAssignmentMillis = nowMillis;
+            return true;
+          }
+          if(!Gm7CanProtocol::encodeOnlineBitmap(buffer, bufferCount, 0, bitmap)){
+            return false;
+          }
+          pmid = Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP;
+          lastBitmap = bitmap;
+          lastSentMillis = nowMillis;
+          sentOnce = true;
+          return true;
+        };
+
+};
+
+class Gm7CanOnlineMap {
+  //Module side. Feed every received frame to onFrame(). The map learns which UID has which slot from the REQUEST_GROUP_SLOT_ASSIGN frames
+  //of the controller (every device receives them, not only the target; they are outside the addressed range, so a module that drops frames
+  //with isAddressedToOtherDevice() still sees them), and the online state from CONTROLLER_ONLINE_BITMAP.
+  //The controller must repeat the assignments (Gm7CanOnlineBroadcaster does), or a module that starts late never learns them.
+  //When no bitmap arrived for staleMillis, the controller is gone and every device counts as offline.
+  //A module that uses this can leave the heartbeats of other modules out of its acceptance filters, and only accept those of controllers.
+    private:
+      uint16_t uids[Gm7CanProtocol::GROUP_SLOTS];
+      uint64_t knownSlots = 0;
+      uint64_t onlineSlots = 0;
+      uint32_t lastBitmapMillis = 0;
+      uint32_t staleMillis;
+      bool received = false;
+
+    public:
+        Gm7CanOnlineMap(uint32_t bitmapStaleMillis = 2500){
+          staleMillis = bitmapStaleMillis;
+          memset(uids, 0, sizeof(uids));
+        };
+
+        //Returns true when the frame changed the map
+        bool onFrame(uint32_t canMessageId, const char * buffer, uint8_t bufferCount, uint32_t nowMillis){
+          uint16_t pmid = Gm7CanProtocol::parseMessageId(canMessageId).pmid;
+          if(pmid == Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP){
+            Gm7CanProtocol::OnlineBitmap online = Gm7CanProtocol::decodeOnlineBitmap(buffer, bufferCount);
+            if(bufferCount < 8 || online.page != 0){
+              return false;
+            }
+            onlineSlots = online.bitmap;
+            lastBitmapMillis = nowMillis;
+            received = true;
+            return true;
+          }
+          if(pmid == Gm7CanProtocol::REQUEST_GROUP_SLOT_ASSIGN && bufferCount >= 3){
+            Gm7CanProtocol::GroupSlotAssign assign = Gm7CanProtocol::decodeGroupSlotAssign(buffer, bufferCount);
+            for(uint8_t slot = 0; slot < Gm7CanProtocol::GROUP_SLOTS; slot++){
+              if(((knownSlots >> slot) & 1) && uids[slot] == assign.targetUid){
+                knownSlots &= ~((uint64_t)1 << slot); //A UID has one slot at most
+              }
+            }
+            if(assign.slot != Gm7CanProtocol::GROUP_SLOT_NONE){
+              uids[assign.slot] = assign.targetUid;
+              knownSlots |= (uint64_t)1 << assign.slot;
+            }
+            return true;
+          }
+          return false;
+        };
+
+        bool isFresh(uint32_t nowMillis){
+          return received && nowMillis - lastBitmapMillis <= staleMillis;
+        };
+
+        //False for devices without a known slot, and for every device when the bitmap is stale
+        bool isOnline(uint16_t uid, uint32_t nowMillis){
+          if(!isFresh(nowMillis)){
+            return false;
+          }
+          for(uint8_t slot = 0; slot < Gm7CanProtocol::GROUP_SLOTS; slot++){
+            if(((knownSlots >> slot) & 1) && uids[slot] == uid){
+              return (onlineSlots >> slot) & 1;
+            }
+          }
+          return false;
+        };
+
+        bool isSlotOnline(uint8_t slot, uint32_t nowMillis){
+          return slot < Gm7CanProtocol::GROUP_SLOTS && isFresh(nowMillis) && ((onlineSlots >> slot) & 1);
+        };
+
+        //Bitmap of online slots, 0 when stale
+        uint64_t getOnlineSlots(uint32_t nowMillis){
+          return isFresh(nowMillis) ? onlineSlots : 0;
+        };
+
+        uint8_t getOnlineCount(uint32_t nowMillis){
+          uint64_t slots = getOnlineSlots(nowMillis);
+          uint8_t count = 0;
+          while(slots){
+            slots &= slots - 1;
+            count++;
+          }
+          return count;
+        };
+
+};
+
+#endif
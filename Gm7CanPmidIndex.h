@@ -0,0 +1,150 @@
+/*
+  Gm7CanPmidIndex.h - Maps every PMID of the protocol to a dense index (0 to PMID_COUNT - 1) and back, at compile time.
+                      Per-PMID counters or caches can then be a flat array of PMID_COUNT entries instead of a map or a 13-bit wide array.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanPmidIndex_h
+#define Gm7CanPmidIndex_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+//Every PMID in the PMID SECTION of Gm7CanProtocol.h, except the -SECTION_START/-END and filter bounds.
+//Keep this list in sync when PMID's are added (test/Gm7CanPmidIndexTest.cpp checks it); the index follows the order of this list.
+#define GM7_CAN_PMID_LIST(X) \
+  X(EMERGENCY_SHUTDOWN) \
+  X(EMERGENCY_FAILSAFE) \
+  X(EMERGENCY_FIRE_ALARM) \
+  X(HEARTBEAT_CONTROLLER) \
+  X(HEARTBEAT_MODULE) \
+  X(HEARTBEAT_PERIPHERAL) \
+  X(HEARTBEAT_EXTERNAL_DEVICE) \
+  X(HEARTBEAT_CONTROLLER_ADAPTIVE) \
+  X(STATUS_CONTROLLER) \
+  X(STATUS_MODULE) \
+  X(STATUS_PERIPHERAL) \
+  X(STATUS_EXTERNAL_DEVICE) \
+  X(REQUEST_CONTROLLER_STATUS_CHANGE) \
+  X(REQUEST_CONTROLLER_GPIO) \
+  X(REQUEST_STATUS_CHANGE) \
+  X(REQUEST_GPIO_ON) \
+  X(REQUEST_GPIO_OFF) \
+  X(REQUEST_PROGRESS_SET) \
+  X(REQUEST_ALL_NODES_STATUS_CHANGE) \
+  X(REQUEST_ALL_NODES_GPIO) \
+  X(REQUEST_ALL_STATUS_CHANGE) \
+  X(REQUEST_ALL_GPIO) \
+  X(REQUEST_ALL_IDENTIFY) \
+  X(REQUEST_GROUP_STATUS_CHANGE) \
+  X(REQUEST_GROUP_SLOT_ASSIGN) \
+  X(RESPONSE_ACK) \
+  X(DEVICE_SERIAL) \
+  X(DEVICE_MODEL) \
+  X(DEVICE_TYPE_ID) \
+  X(DEVICE_VENDOR) \
+  X(DEVICE_SHORT_NAME) \
+  X(DEVICE_VITALS_DEBUGGING) \
+  X(DEVICE_STATUS) \
+  X(DEVICE_UID_CLAIM) \
+  X(DEVICE_VITALS_BATTERY) \
+  X(DEVICE_VITALS_CONNECTION) \
+  X(DEVICE_REGISTRATION_REQUEST) \
+  X(DEVICE_TYPE_CONTROLLER_SBC) \
+  X(DEVICE_TYPE_CONTROLLER_MCU) \
+  X(DEVICE_TYPE_CONTROLLER_SERVER) \
+  X(DEVICE_TYPE_CONTROLLER_USB) \
+  X(DEVICE_TYPE_CONTROLLER_SERIAL) \
+  X(DEVICE_TYPE_CONTROLLER_WEBAPP) \
+  X(DEVICE_TYPE_CONTROLLER_WINPC) \
+  X(DEVICE_TYPE_CONTROLLER_UNIX) \
+  X(DEVICE_TYPE_CONTROLLER_MACOS) \
+  X(DEVICE_TYPE_CONTROLLER_MOBILE) \
+  X(DEVICE_TYPE_CONTROLLER_IOS) \
+  X(DEVICE_TYPE_CONTROLLER_ANDROID) \
+  X(DEVICE_TYPE_CONTROLLER_GENERIC) \
+  X(DEVICE_TYPE_CONTROLLER_GM7UTB) \
+  X(DEVICE_TYPE_CONTROLLER_GM7UCS) \
+  X(DEVICE_TYPE_CONTROLLER_GM7ACS) \
+  X(DEVICE_TYPE_CONTROLLER_GM7AEM) \
+  X(DEVICE_TYPE_CONTROLLER_GM7GRC) \
+  X(DEVICE_TYPE_CONTROLLER_OEM) \
+  X(DEVICE_TYPE_CONTROLLER_DEV) \
+  X(DEVICE_TYPE_CONTROLLER_TEST) \
+  X(DEVICE_TYPE_CONTROLLER_DEBUG) \
+  X(DEVICE_TYPE_MODULE_TIMER) \
+  X(DEVICE_TYPE_MODULE_CLOCK) \
+  X(DEVICE_TYPE_MODULE_TIMERCLOCK) \
+  X(DEVICE_TYPE_MODULE_DIAGNOSTICS) \
+  X(DEVICE_TYPE_MODULE_SENSOR) \
+  X(DEVICE_TYPE_MODULE_ACTUATOR) \
+  X(DEVICE_TYPE_MODULE_GENERIC_IO) \
+  X(DEVICE_TYPE_MODULE_GENERIC_RO) \
+  X(DEVICE_TYPE_MODULE_GAME_MODULE) \
+  X(DEVICE_TYPE_MODULE_TEST) \
+  X(DEVICE_TYPE_PERIPHERAL_KEYBOARD) \
+  X(DEVICE_TYPE_EXTERNAL_GENERIC) \
+  X(CONTROLLER_STATUS_AND_PROGRESS) \
+  X(CONTROLLER_MAIN_TIMER_STATUS) \
+  X(CONTROLLER_VALIDATION_TIMER_STATUS) \
+  X(CONTROLLER_INTERNAL_TIMER_STATUS) \
+  X(CONTROLLER_TRIES) \
+  X(CONTROLLER_ONLINE_BITMAP) \
+  X(MODULE_STATUS_AND_PROGRESS) \
+  X(MODULE_MAIN_TIMER_STATUS) \
+  X(MODULE_VALIDATION_TIMER_STATUS) \
+  X(MODULE_INTERNAL_TIMER_STATUS) \
+  X(MODULE_TRIES) \
+  X(PERIPHERAL_STATUS_AND_PROGRESS) \
+  X(PERIPHERAL_MAIN_TIMER_STATUS) \
+  X(PERIPHERAL_VALIDATION_TIMER_STATUS) \
+  X(PERIPHERAL_INTERNAL_TIMER_STATUS) \
+  X(EXTERNAL_DEVICE_STATUS_AND_PROGRESS) \
+  X(EXTERNAL_DEVICE_MAIN_TIMER_STATUS) \
+  X(EXTERNAL_DEVICE_VALIDATION_TIMER_STATUS) \
+  X(EXTERNAL_DEVICE_INTERNAL_TIMER_STATUS)
+
+class Gm7CanPmidIndex {
+  //Usage: uint32_t framesPerPmid[Gm7CanPmidIndex::PMID_COUNT]; framesPerPmid[Gm7CanPmidIndex::getIndex(pmid)]++ (after checking for NOT_CATALOGUED).
+  //Both directions are constexpr, so Gm7CanPmidIndex::getIndex(Gm7CanProtocol::MODULE_TRIES) can be used as an array size or a case label.
+  //Two PMID's with the same value fail to compile (see the static_assert below the class).
+    public:
+#define GM7_CAN_PMID_ENUM(name) INDEX_##name,
+        enum PmidIndex : uint16_t {
+          GM7_CAN_PMID_LIST(GM7_CAN_PMID_ENUM)
+          PMID_COUNT
+        };
+#undef GM7_CAN_PMID_ENUM
+
+        static const uint16_t NOT_CATALOGUED = 0xFFFF;
+
+#define GM7_CAN_PMID_TO_INDEX(name) pmid == Gm7CanProtocol::name ? (uint16_t)INDEX_##name :
+        //NOT_CATALOGUED for PMID's that are not in the list
+        static constexpr uint16_t getIndex(uint16_t pmid){
+          return GM7_CAN_PMID_LIST(GM7_CAN_PMID_TO_INDEX) NOT_CATALOGUED;
+        };
+#undef GM7_CAN_PMID_TO_INDEX
+
+#define GM7_CAN_INDEX_TO_PMID(name) index == INDEX_##name ? Gm7CanProtocol::name :
+        //0 for indexes of PMID_COUNT and up
+        static constexpr uint16_t getPmid(uint16_t index){
+          return GM7_CAN_PMID_LIST(GM7_CAN_INDEX_TO_PMID) (uint16_t)0;
+        };
+#undef GM7_CAN_INDEX_TO_PMID
+
+        static constexpr bool isCatalogued(uint16_t pmid){
+          return getIndex(pmid) != NOT_CATALOGUED;
+        };
+
+        //True when every PMID from index on maps back to its own index, which fails for the second one of two equal PMID's
+        static constexpr bool isUniqueFrom(uint16_t index){
+          return index >= PMID_COUNT || (getIndex(getPmid(index)) == index && isUniqueFrom(index + 1));
+        };
+
+};
+
+static_assert(Gm7CanPmidIndex::isUniqueFrom(0), "Two PMID's in GM7_CAN_PMID_LIST have the same value");
+
+#endif
@@ -13,6 +13,29 @@
 
 #include <Arduino.h>
 
+//Used by the helpers that share data between an interrupt (or another thread/process) and the main loop.
+//AVR is single core, so only the compiler needs to be kept from reordering; everywhere else a full barrier is used.
+#if defined(__AVR__)
+  #define GM7_CAN_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+  #define GM7_CAN_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+//Alignment of the payload in Gm7CanProtocol::CanFrame. 8-bit AVR loads a byte at a time anyway, so it is left out there.
+#if defined(__AVR__)
+  #define GM7_CAN_PAYLOAD_ALIGNMENT
+#else
+  #define GM7_CAN_PAYLOAD_ALIGNMENT alignas(8)
+#endif
+
+//Keeps data written by different cores (the producer and consumer side of a queue) in different cache lines, so they do not
+//invalidate each other's cache on every write. Most cores use 64 byte lines. AVR has no cache and too little RAM to spare.
+#if defined(__AVR__)
+  #define GM7_CAN_CACHE_LINE_ALIGNMENT
+#else
+  #define GM7_CAN_CACHE_LINE_ALIGNMENT alignas(64)
+#endif
+
 class Gm7CanProtocol {
   //The message ID used in CAN 2B (extended) is a 29 bit long identifier.
   //Since the ID's need to be unique per node (no 2 nodes should use the same message ID) and priority is given to lower ID's, we need to combine uniqueness with a simple priority system
@@ -42,15 +65,22 @@ class Gm7CanProtocol {
 
   #define CAN_PAYLOAD_MESSAGE_BYTES 8 //CAN 2B allows for a payload of max 8 bytes (64 bits). Don't mess with this unless you know what you are doing.
 
+  //All codecs (add*/extract*, encode*/decode*, parseMessageId, decodeEvent and so on) and all PMID's are static and keep no state.
+  //Use them without an instance, like Gm7CanProtocol::decodeEvent(...), from any number of threads at the same time.
+  //An instance is only needed for the per-device state: heartbeat timing, implicit heartbeats and the device update interval.
+
     private:
-      uint16_t uniqueIdSize = 16;
-      uint16_t uniqueIdMask = 65535;
+      static const uint8_t uniqueIdSize = 16;
+      static const uint16_t uniqueIdMask = 65535;
       uint32_t baudrate = 500000;
       uint8_t defaultMessageLength = CAN_PAYLOAD_MESSAGE_BYTES;
       bool useExtendedIds = true;
       uint32_t heartbeatIntervalMillis = 1000;
       uint32_t heartbeatTimeoutTresholdMillis = 1250;
       uint32_t deviceUpdateIntervalMillisBase = 30000;
+      bool implicitHeartbeats = false;
+      uint32_t lastHeartbeatSentMillis = 0;
+      uint32_t lastFrameSentMillis = 0;
       
       //About deviceUpdateIntervalRandomSpread = random(-250, 250):
       //There will be the possibility of multiple nodes on the same bus and each of them will send a multi-frame device update dataset.
@@ -99,6 +129,43 @@ class Gm7CanProtocol {
           return heartbeatTimeoutTresholdMillis;
         };
 
+        //Used to follow the timing a controller advertises with HEARTBEAT_CONTROLLER_ADAPTIVE.
+        //Returns false (and keeps the current timing) if the timeout would not be longer than the interval.
+        bool setHeartbeatTiming(uint32_t intervalMillis, uint32_t timeoutTresholdMillis){
+          if(intervalMillis == 0 || timeoutTresholdMillis <= intervalMillis){
+            return false;
+          }
+          heartbeatIntervalMillis = intervalMillis;
+          heartbeatTimeoutTresholdMillis = timeoutTresholdMillis;
+          return true;
+        };
+
+        //IMPLICIT HEARTBEATS
+        //By default a heartbeat is sent every heartbeat interval, no matter what else the device sends.
+        //With implicit heartbeats enabled, any frame sent by a device counts as a sign of life, and an explicit heartbeat is only due
+        //when the device has been silent for the heartbeat interval. Chatty devices then hardly send heartbeats at all.
+        //Only enable this when every device that tracks liveness does so from any frame (see Gm7CanLivenessTracker), or they will see this device go offline.
+        void setImplicitHeartbeats(bool enabled){
+          implicitHeartbeats = enabled;
+        };
+
+        bool getImplicitHeartbeats(){
+          return implicitHeartbeats;
+        };
+
+        //Call this for every frame that is actually sent, heartbeats included
+        void notifyFrameSent(uint16_t pmid, uint32_t nowMillis){
+          lastFrameSentMillis = nowMillis;
+          if(pmid > HEARTBEATS_START && pmid < HEARTBEATS_END){
+            lastHeartbeatSentMillis = nowMillis;
+          }
+        };
+
+        bool isHeartbeatDue(uint32_t nowMillis){
+          uint32_t lastSentMillis = implicitHeartbeats ? lastFrameSentMillis : lastHeartbeatSentMillis;
+          return nowMillis - lastSentMillis >= heartbeatIntervalMillis;
+        };
+
         uint32_t getDeviceUpdateIntervalRateInMillis(){
           return deviceUpdateIntervalMillisBase + deviceUpdateIntervalRandomSpread; 
         };
@@ -107,7 +174,7 @@ class Gm7CanProtocol {
           deviceUpdateIntervalRandomSpread = random(-250, 250);
         };
 
-        void clearBuffer(char * buffer, uint8_t bufferCount){
+        static void clearBuffer(char * buffer, uint8_t bufferCount){
           for(int i = 0; i < bufferCount; i++){
             buffer[i] = 0;
           }
@@ -115,7 +182,7 @@ class Gm7CanProtocol {
 
 
 
-        MessageId parseMessageId(uint32_t canMessageId){
+        static MessageId parseMessageId(uint32_t canMessageId){
           MessageId messageId;
           messageId.uid = (canMessageId & uniqueIdMask);
           messageId.pmid = (canMessageId >> uniqueIdSize);
@@ -123,7 +190,7 @@ class Gm7CanProtocol {
           return messageId;
         };
 
-        uint32_t encodeMessageId(MessageId messageId){
+        static uint32_t encodeMessageId(MessageId messageId){
             uint32_t msg = 0;
             msg += (messageId.pmid << uniqueIdSize);
             msg += messageId.uid;
@@ -131,14 +198,104 @@ class Gm7CanProtocol {
         };
 
         //Param 1: priorityId, param 2: uniqueId
-        uint32_t encodeMessageId(uint16_t priorityId, uint16_t uniqueId){
+        static uint32_t encodeMessageId(uint16_t priorityId, uint16_t uniqueId){
             uint32_t msg = 0;
             msg += (priorityId << uniqueIdSize);
             msg += uniqueId;
             return msg;
         };
 
-        bool addUint64ToBuffer(char * buffer, uint8_t bufferCount, uint64_t value, uint8_t bufferStartPos = 0){
+        //A filter on a PMID range (inclusive) and on the UID bits selected by uidMask (uidMask 0 matches every UID).
+        //Use the -SECTION_START/-END PMID's to select a whole section, for example EMERGENCY_SECTION_START to EMERGENCY_SECTION_END.
+        struct FrameFilter{
+          uint16_t pmidFirst;
+          uint16_t pmidLast;
+          uint16_t uid;
+          uint16_t uidMask;
+        };
+
+        static FrameFilter createFrameFilter(uint16_t pmidFirst, uint16_t pmidLast, uint16_t uid = 0, uint16_t uidMask = 0){
+          FrameFilter filter = {pmidFirst, pmidLast, (uint16_t)(uid & uidMask), uidMask};
+          return filter;
+        };
+
+        static bool matchesFrameFilter(const FrameFilter & filter, uint32_t canMessageId){
+          uint16_t pmid = canMessageId >> uniqueIdSize;
+          uint16_t uid = canMessageId & uniqueIdMask;
+          return (uint16_t)(pmid - filter.pmidFirst) <= (uint16_t)(filter.pmidLast - filter.pmidFirst) && (uid & filter.uidMask) == filter.uid;
+        };
+
+        //CAN FRAMES
+        //A complete frame as one value: 29-bit message ID, flags, length (DLC) and the payload, 16 bytes in total.
+        //It is trivially copyable, so it can be passed, returned, queued and stored with plain assignments or memcpy.
+        //The payload is 8-byte aligned (except on AVR), so it can also be read or written as a single 64-bit word (getWord()/setWord()).
+        //The codecs below have overloads that return a CanFrame or take one by value, next to the char buffer versions.
+        static const uint8_t CAN_FRAME_FLAG_EXTENDED = 0x01;
+        static const uint8_t CAN_FRAME_FLAG_REMOTE = 0x02;
+
+        struct CanFrame{
+          uint32_t id;          //MESSAGE ID (PMID and UID)
+          uint8_t flags;        //CAN_FRAME_FLAG_*
+          uint8_t length;       //0-8
+          uint8_t reserved[2];  //Always 0, keeps the payload at byte 8
+          GM7_CAN_PAYLOAD_ALIGNMENT char data[CAN_PAYLOAD_MESSAGE_BYTES];
+
+          uint16_t getPmid() const {
+            return (id >> 16) & 0x1FFF;
+          };
+
+          uint16_t getUid() const {
+            return id & 0xFFFF;
+          };
+
+          //The payload as stored (bytes in bus order), for copying and comparing whole payloads
+          uint64_t getWord() const {
+            uint64_t word;
+            memcpy(&word, data, sizeof(word));
+            return word;
+          };
+
+          void setWord(uint64_t word){
+            memcpy(data, &word, sizeof(word));
+          };
+
+          //The payload as one big endian (MSB first) number, like extractUint64FromBuffer(data, 8)
+          uint64_t getPayloadUint64() const {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return getWord();
+#else
+            return __builtin_bswap64(getWord());
+#endif
+          };
+        };
+
+        static_assert(sizeof(CanFrame) == 16, "CanFrame should be 16 bytes");
+
+        //An empty (zeroed) frame with a full length payload, ready to be filled by one of the encoders
+        static CanFrame createFrame(uint16_t pmid, uint16_t uid, uint8_t length = CAN_PAYLOAD_MESSAGE_BYTES){
+          CanFrame frame;
+          frame.id = encodeMessageId(pmid, uid);
+          frame.flags = CAN_FRAME_FLAG_EXTENDED; //The 13/16 bit PMID/UID split needs extended ID's
+          frame.length = length > CAN_PAYLOAD_MESSAGE_BYTES ? CAN_PAYLOAD_MESSAGE_BYTES : length;
+          frame.reserved[0] = 0;
+          frame.reserved[1] = 0;
+          frame.setWord(0);
+          return frame;
+        };
+
+        //For frames received with the char buffer API
+        static CanFrame createFrameFromBuffer(uint32_t canMessageId, const char * payload, uint8_t length){
+          CanFrame frame = createFrame((uint16_t)0, (uint16_t)0, length);
+          frame.id = canMessageId & 0x1FFFFFFF;
+          memcpy(frame.data, payload, frame.length);
+          return frame;
+        };
+
+        static bool matchesFrameFilter(const FrameFilter & filter, CanFrame frame){
+          return matchesFrameFilter(filter, frame.id);
+        };
+
+        static bool addUint64ToBuffer(char * buffer, uint8_t bufferCount, uint64_t value, uint8_t bufferStartPos = 0){
           if(bufferCount < bufferStartPos+8){
             return false;
           }
@@ -153,23 +310,23 @@ class Gm7CanProtocol {
           return true;
         };
 
-        uint64_t extractUint64FromBuffer(char * buffer, uint8_t bufferCount, uint8_t bufferStartPos = 0){
+        static uint64_t extractUint64FromBuffer(const char * buffer, uint8_t bufferCount, uint8_t bufferStartPos = 0){
           if(bufferCount < bufferStartPos+8){
             return 0;
           }
           uint64_t value = 0;
-          value |= buffer[bufferStartPos]   << 56;
-          value |= buffer[bufferStartPos+1] << 48;
-          value |= buffer[bufferStartPos+2] << 40;
-          value |= buffer[bufferStartPos+3] << 32;
-          value |= buffer[bufferStartPos+4] << 24;
-          value |= buffer[bufferStartPos+5] << 16;
-          value |= buffer[bufferStartPos+6] << 8;
-          value |= buffer[bufferStartPos+7];
+          value |= (uint64_t)(uint8_t)buffer[bufferStartPos]   << 56;
+          value |= (uint64_t)(uint8_t)buffer[bufferStartPos+1] << 48;
+          value |= (uint64_t)(uint8_t)buffer[bufferStartPos+2] << 40;
+          value |= (uint64_t)(uint8_t)buffer[bufferStartPos+3] << 32;
+          value |= (uint64_t)(uint8_t)buffer[bufferStartPos+4] << 24;
+          value |= (uint64_t)(uint8_t)buffer[bufferStartPos+5] << 16;
+          value |= (uint64_t)(uint8_t)buffer[bufferStartPos+6] << 8;
+          value |= (uint8_t)buffer[bufferStartPos+7];
           return value;
         };
 
-        bool addUint32ToBuffer(char * buffer, uint8_t bufferCount, uint32_t value, uint8_t bufferStartPos = 0){
+        static bool addUint32ToBuffer(char * buffer, uint8_t bufferCount, uint32_t value, uint8_t bufferStartPos = 0){
           if(bufferCount < bufferStartPos+4){
             return false;
           }
@@ -180,19 +337,19 @@ class Gm7CanProtocol {
           return true;
         };
 
-        uint32_t extractUint32FromBuffer(char * buffer, uint8_t bufferCount, uint8_t bufferStartPos = 0){
+        static uint32_t extractUint32FromBuffer(const char * buffer, uint8_t bufferCount, uint8_t bufferStartPos = 0){
           if(bufferCount < bufferStartPos+4){
             return 0;
           }
           uint32_t value = 0;
-          value |= buffer[bufferStartPos] << 24;
-          value |= buffer[bufferStartPos+1] << 16;
-          value |= buffer[bufferStartPos+2] << 8;
-          value |= buffer[bufferStartPos+3];
+          value |= (uint32_t)(uint8_t)buffer[bufferStartPos] << 24;
+          value |= (uint32_t)(uint8_t)buffer[bufferStartPos+1] << 16;
+          value |= (uint32_t)(uint8_t)buffer[bufferStartPos+2] << 8;
+          value |= (uint8_t)buffer[bufferStartPos+3];
           return value;
         };
 
-        bool addUint16ToBuffer(char * buffer, uint8_t bufferCount, uint16_t value, uint8_t bufferStartPos = 0){
+        static bool addUint16ToBuffer(char * buffer, uint8_t bufferCount, uint16_t value, uint8_t bufferStartPos = 0){
           if(bufferCount < bufferStartPos+2){
             return false;
           }
@@ -201,30 +358,134 @@ class Gm7CanProtocol {
           return true;
         };
 
-        uint16_t extractUint16FromBuffer(char * buffer, uint8_t bufferCount, uint8_t bufferStartPos = 0){
+        static uint16_t extractUint16FromBuffer(const char * buffer, uint8_t bufferCount, uint8_t bufferStartPos = 0){
           if(bufferCount < bufferStartPos+2){
             return 0;
           }
           uint16_t value = 0;
-          value |= buffer[bufferStartPos] << 8;
-          value |= buffer[bufferStartPos+1];
+          value |= (uint16_t)(uint8_t)buffer[bufferStartPos] << 8;
+          value |= (uint8_t)buffer[bufferStartPos+1];
           return value;
         };
 
-        bool addCharArrayToBuffer(char * buffer, uint8_t bufferCount, const char * value, uint8_t bufferStartPos = 0){
+        static bool addCharArrayToBuffer(char * buffer, uint8_t bufferCount, const char * value, uint8_t bufferStartPos = 0){
             if(bufferCount <= bufferStartPos){
               return false;
             }
             for(int i = bufferStartPos; i < bufferCount; i++){
-              buffer[i] = value[i];
-              if(value[i] == '\0'){
+              buffer[i] = value[i - bufferStartPos];
+              if(value[i - bufferStartPos] == '\0'){
                 break;
               }
             }
-            return;
+            return true;
         };
 
-        bool encodeHeartbeat(char * buffer, uint8_t bufferCount, uint32_t millisCurrent, uint32_t millisLast = 0){
+        //PACKED STRINGS
+        //Plain ASCII spends 8 bits per char and needs a terminator, so only 7 chars fit in a single frame.
+        //The packed alphabet below only needs 6 bits per char, which fits 10 chars in the 64 bits of a frame:
+        //  code 0 = end of string, 1-26 = 'A'-'Z', 27-36 = '0'-'9', 37-63 = the symbols in CAN_PACKED_STRING_SYMBOLS
+        //Packed payloads have the MSB of the first byte set. Plain ASCII never has that bit set, so both formats can be told apart by the receiver.
+        //In representation (f = packed flag, r = reserved (0), 0-9 = char index):
+        //  f r r r 0 0 0 0 | 0 0 1 1 1 1 1 1 | 2 2 2 2 2 2 3 3 | ... | 8 8 9 9 9 9 9 9
+        //Strings that contain anything outside of the alphabet (lowercase for example) fall back to plain ASCII (max 8 chars, terminated when shorter).
+        #define CAN_PACKED_STRING_MAX_CHARS 10
+        #define CAN_PACKED_STRING_SYMBOLS " -_./:+#&'()!?*,=@<>%$[]~^|"
+        static const uint8_t PACKED_STRING_FLAG = 0x80;
+
+        //Returns the 6-bit code for a char, or 0xFF when the char is not part of the packed alphabet
+        static uint8_t getPackedCharCode(char c){
+          if(c >= 'A' && c <= 'Z'){
+            return c - 'A' + 1;
+          }
+          if(c >= '0' && c <= '9'){
+            return c - '0' + 27;
+          }
+          const char * symbols = CAN_PACKED_STRING_SYMBOLS;
+          for(uint8_t i = 0; symbols[i] != '\0'; i++){
+            if(symbols[i] == c){
+              return i + 37;
+            }
+          }
+          return 0xFF;
+        };
+
+        static char getCharFromPackedCode(uint8_t code){
+          if(code >= 1 && code <= 26){
+            return 'A' + code - 1;
+          }
+          if(code >= 27 && code <= 36){
+            return '0' + code - 27;
+          }
+          if(code >= 37 && code <= 63){
+            return CAN_PACKED_STRING_SYMBOLS[code - 37];
+          }
+          return '\0';
+        };
+
+        //Returns false (and leaves the buffer untouched) if the value is too long or contains a char that is not part of the packed alphabet
+        static bool addPackedCharArrayToBuffer(char * buffer, uint8_t bufferCount, const char * value, uint8_t bufferStartPos = 0){
+          if(bufferCount < bufferStartPos+8){
+            return false;
+          }
+          uint64_t packed = 0;
+          uint8_t i = 0;
+          for(; value[i] != '\0'; i++){
+            uint8_t code = getPackedCharCode(value[i]);
+            if(i >= CAN_PACKED_STRING_MAX_CHARS || code == 0xFF){
+              return false;
+            }
+            packed |= (uint64_t)code << (54 - (6 * i));
+          }
+          packed |= (uint64_t)PACKED_STRING_FLAG << 56;
+          return addUint64ToBuffer(buffer, bufferCount, packed, bufferStartPos);
+        };
+
+        //Encodes a string as packed when possible and falls back to plain ASCII otherwise.
+        //Returns false if the value does not fit in either format.
+        static bool encodeStringToBuffer(char * buffer, uint8_t bufferCount, const char * value){
+          clearBuffer(buffer, bufferCount);
+          if(addPackedCharArrayToBuffer(buffer, bufferCount, value, 0)){
+            return true;
+          }
+          if((uint8_t)value[0] & PACKED_STRING_FLAG){
+            return false; //Would be mistaken for a packed string
+          }
+          if(strlen(value) > bufferCount){
+            return false;
+          }
+          return addCharArrayToBuffer(buffer, bufferCount, value, 0);
+        };
+
+        //Decodes both packed and plain ASCII strings into value, which is always null terminated.
+        //Use a value of at least CAN_PACKED_STRING_MAX_CHARS + 1 bytes to never truncate.
+        static bool decodeStringFromBuffer(const char * buffer, uint8_t bufferCount, char * value, uint8_t valueSize){
+          if(bufferCount < 1 || valueSize < 1){
+            return false;
+          }
+          uint8_t length = 0;
+          if(bufferCount >= 8 && ((uint8_t)buffer[0] & PACKED_STRING_FLAG)){
+            uint64_t packed = extractUint64FromBuffer(buffer, bufferCount, 0);
+            for(uint8_t i = 0; i < CAN_PACKED_STRING_MAX_CHARS && length < valueSize - 1; i++){
+              char c = getCharFromPackedCode((packed >> (54 - (6 * i))) & 0x3F);
+              if(c == '\0'){
+                break;
+              }
+              value[length++] = c;
+            }
+          } else {
+            for(uint8_t i = 0; i < bufferCount && length < valueSize - 1; i++){
+              if(buffer[i] == '\0'){
+                break;
+              }
+              value[length++] = buffer[i];
+            }
+          }
+          value[length] = '\0';
+          return true;
+        };
+
+        static bool encodeHeartbeat(char * buffer, uint8_t bufferCount, uint32_t millisCurrent, uint32_t millisLast = 0){
           clearBuffer(buffer, bufferCount);
           if(bufferCount < 4){
             return false;
@@ -236,35 +497,110 @@ class Gm7CanProtocol {
           return true;
         };
 
-        bool encodeSerialNumberToBuffer(char * buffer, uint8_t bufferCount, uint64_t serialNumber){
+        struct Heartbeat{
+          uint32_t millisCurrent;
+          uint32_t millisLast;      //0 when the sender did not include it
+          uint16_t intervalMillis;  //Only sent with HEARTBEAT_CONTROLLER_ADAPTIVE, 0 otherwise
+          uint16_t timeoutMillis;   //Only sent with HEARTBEAT_CONTROLLER_ADAPTIVE, 0 otherwise
+        };
+
+        static Heartbeat decodeHeartbeat(const char * buffer, uint8_t bufferCount){
+          Heartbeat heartbeat = {0, 0, 0, 0};
+          heartbeat.millisCurrent = extractUint32FromBuffer(buffer, bufferCount, 0);
+          heartbeat.millisLast = extractUint32FromBuffer(buffer, bufferCount, 4);
+          return heartbeat;
+        };
+
+        static CanFrame encodeHeartbeat(uint16_t pmid, uint16_t uid, uint32_t millisCurrent, uint32_t millisLast = 0){
+          CanFrame frame = createFrame(pmid, uid);
+          encodeHeartbeat(frame.data, frame.length, millisCurrent, millisLast);
+          return frame;
+        };
+
+        static Heartbeat decodeHeartbeat(CanFrame frame){
+          return decodeHeartbeat(frame.data, frame.length);
+        };
+
+        //The controller heartbeat for adaptive timing (HEARTBEAT_CONTROLLER_ADAPTIVE): 32 bits millisCurrent, 16 bits heartbeat interval, 16 bits timeout treshold.
+        //Every node that receives it should follow the advertised timing, see followHeartbeatTiming().
+        static bool encodeAdaptiveHeartbeat(char * buffer, uint8_t bufferCount, uint32_t millisCurrent, uint16_t intervalMillis, uint16_t timeoutMillis){
+          clearBuffer(buffer, bufferCount);
+          if(bufferCount < 8){
+            return false;
+          }
+          addUint32ToBuffer(buffer, bufferCount, millisCurrent, 0);
+          addUint16ToBuffer(buffer, bufferCount, intervalMillis, 4);
+          addUint16ToBuffer(buffer, bufferCount, timeoutMillis, 6);
+          return true;
+        };
+
+        static Heartbeat decodeAdaptiveHeartbeat(const char * buffer, uint8_t bufferCount){
+          Heartbeat heartbeat = {0, 0, 0, 0};
+          if(bufferCount < 8){
+            return heartbeat;
+          }
+          heartbeat.millisCurrent = extractUint32FromBuffer(buffer, bufferCount, 0);
+          heartbeat.intervalMillis = extractUint16FromBuffer(buffer, bufferCount, 4);
+          heartbeat.timeoutMillis = extractUint16FromBuffer(buffer, bufferCount, 6);
+          return heartbeat;
+        };
+
+        //Applies the timing advertised in a controller heartbeat. Returns false if the heartbeat did not advertise (valid) timing.
+        bool followHeartbeatTiming(Heartbeat heartbeat){
+          if(heartbeat.intervalMillis == 0){
+            return false;
+          }
+          return setHeartbeatTiming(heartbeat.intervalMillis, heartbeat.timeoutMillis);
+        };
+
+        static bool encodeSerialNumberToBuffer(char * buffer, uint8_t bufferCount, uint64_t serialNumber){
           clearBuffer(buffer, bufferCount);
           return addUint64ToBuffer(buffer, bufferCount, serialNumber, 0);
         };
 
-        bool encodeTypeIdToBuffer(char * buffer, uint8_t bufferCount, uint16_t typeId){
+        static uint64_t extractSerialNumberFromBuffer(const char * buffer, uint8_t bufferCount){
+          return extractUint64FromBuffer(buffer, bufferCount, 0);
+        };
+
+        //DYNAMIC UID'S
+        //Instead of the low 16 bits of the serial number, a device can derive its UID from a hash over the full 64-bit serial number,
+        //and claim it on the bus with DEVICE_UID_CLAIM (payload: the full serial number). When two devices claim the same UID,
+        //the lowest serial number keeps it and the other one tries the next attempt. See Gm7CanUidClaimer.
+        //UID 0 and 65535 are never returned, so they stay available as special values.
+        static uint16_t getUidForSerial(uint64_t serialNumber, uint8_t attempt = 0){
+          uint64_t hash = serialNumber + ((uint64_t)(attempt + 1) * 0x9E3779B97F4A7C15ULL); //splitmix64 finalizer
+          hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+          hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+          hash ^= hash >> 31;
+          uint16_t uid = hash ^ (hash >> 16) ^ (hash >> 32) ^ (hash >> 48);
+          if(uid == 0 || uid == 0xFFFF){
+            uid = 1 + (uint16_t)(serialNumber % 0xFFFE);
+          }
+          return uid;
+        };
+
+        static bool encodeTypeIdToBuffer(char * buffer, uint8_t bufferCount, uint16_t typeId){
           clearBuffer(buffer, bufferCount);
           return addUint16ToBuffer(buffer, bufferCount, typeId, 0);
         };
 
-        bool encodeModelToBuffer(char * buffer, uint8_t bufferCount, char * model){
-          clearBuffer(buffer, bufferCount);
-          return addCharArrayToBuffer(buffer, bufferCount, model, 0);
+        //Model, vendor and short name are sent packed when possible (see PACKED STRINGS). Use decodeStringFromBuffer() to read them.
+        static bool encodeModelToBuffer(char * buffer, uint8_t bufferCount, const char * model){
+          return encodeStringToBuffer(buffer, bufferCount, model);
         };
 
-        bool encodeVendorToBuffer(char * buffer, uint8_t bufferCount, char * vendor){
-          clearBuffer(buffer, bufferCount);
-          return addCharArrayToBuffer(buffer, bufferCount, vendor, 0);
+        static bool encodeVendorToBuffer(char * buffer, uint8_t bufferCount, const char * vendor){
+          return encodeStringToBuffer(buffer, bufferCount, vendor);
         };
 
-        bool encodeShortNameToBuffer(char * buffer, uint8_t bufferCount, char * name){
-          clearBuffer(buffer, bufferCount);
-          return addCharArrayToBuffer(buffer, bufferCount, name, 0);
+        static bool encodeShortNameToBuffer(char * buffer, uint8_t bufferCount, const char * name){
+          return encodeStringToBuffer(buffer, bufferCount, name);
         };
 
 
-        uint16_t extractDeviceTypeIdFromBuffer(char * buffer, uint8_t bufferCount){
+        static uint16_t extractDeviceTypeIdFromBuffer(const char * buffer, uint8_t bufferCount){
           if(bufferCount < 2){
-            return;
+            return 0;
           }
           return extractUint16FromBuffer(buffer, bufferCount, 0);
         };
@@ -278,7 +614,7 @@ class Gm7CanProtocol {
           uint16_t progressMax;
         };
 
-        bool encodeModuleStatusAndProgress(char * buffer, uint8_t bufferCount, uint32_t status, uint16_t progress, uint16_t progressMax){
+        static bool encodeModuleStatusAndProgress(char * buffer, uint8_t bufferCount, uint32_t status, uint16_t progress, uint16_t progressMax){
             if(bufferCount < 8){
               return false; //We need all 64 bits for this method
             }
@@ -288,21 +624,623 @@ class Gm7CanProtocol {
             return true;
         };
 
-        bool encodeModuleStatusAndProgress(char * buffer, uint8_t bufferCount, StatusAndProgress statusAndProgress){
+        static bool encodeModuleStatusAndProgress(char * buffer, uint8_t bufferCount, StatusAndProgress statusAndProgress){
             return encodeModuleStatusAndProgress(buffer, bufferCount, statusAndProgress.status, statusAndProgress.progress, statusAndProgress.progressMax);
         };
 
-        StatusAndProgress decodeModuleStatusAndProgress(char * buffer, uint8_t bufferCount){
+        static StatusAndProgress decodeModuleStatusAndProgress(const char * buffer, uint8_t bufferCount){
+            StatusAndProgress statusAndProgress = {0, 0, 0};
             if(bufferCount < 8){
-              return; //We need all 64 bits for this method
+              return statusAndProgress; //We need all 64 bits for this method
             }
-            StatusAndProgress statusAndProgress;
             statusAndProgress.status = extractUint32FromBuffer(buffer, bufferCount, 0); //Add the status in the first 4 bytes
             statusAndProgress.progress = extractUint16FromBuffer(buffer, bufferCount, 4); //Add the status in the first 4 bytes
             statusAndProgress.progressMax = extractUint16FromBuffer(buffer, bufferCount, 6); //Add the status in the first 4 bytes
             return statusAndProgress;
         };
 
+        static CanFrame encodeModuleStatusAndProgress(uint16_t pmid, uint16_t uid, StatusAndProgress statusAndProgress){
+            CanFrame frame = createFrame(pmid, uid);
+            encodeModuleStatusAndProgress(frame.data, frame.length, statusAndProgress);
+            return frame;
+        };
+
+        static StatusAndProgress decodeModuleStatusAndProgress(CanFrame frame){
+            return decodeModuleStatusAndProgress(frame.data, frame.length);
+        };
+
+//TIMERS
+        struct TimerStatus{
+          uint32_t timeLeft;
+          uint32_t timeSet;
+        };
+
+        static bool encodeTimerStatus(char * buffer, uint8_t bufferCount, uint32_t timeLeft, uint32_t timeSet){
+            if(bufferCount < 8){
+              return false; //We need all 64 bits for this method
+            }
+            addUint32ToBuffer(buffer, bufferCount, timeLeft, 0); //Current time left in the first 4 bytes
+            addUint32ToBuffer(buffer, bufferCount, timeSet, 4); //The time the timer was set to in the last 4
+            return true;
+        };
+
+        static bool encodeTimerStatus(char * buffer, uint8_t bufferCount, TimerStatus timerStatus){
+            return encodeTimerStatus(buffer, bufferCount, timerStatus.timeLeft, timerStatus.timeSet);
+        };
+
+        static TimerStatus decodeTimerStatus(const char * buffer, uint8_t bufferCount){
+            TimerStatus timerStatus = {0, 0};
+            if(bufferCount < 8){
+              return timerStatus; //We need all 64 bits for this method
+            }
+            timerStatus.timeLeft = extractUint32FromBuffer(buffer, bufferCount, 0);
+            timerStatus.timeSet = extractUint32FromBuffer(buffer, bufferCount, 4);
+            return timerStatus;
+        };
+
+        static CanFrame encodeTimerStatus(uint16_t pmid, uint16_t uid, TimerStatus timerStatus){
+            CanFrame frame = createFrame(pmid, uid);
+            encodeTimerStatus(frame.data, frame.length, timerStatus);
+            return frame;
+        };
+
+        static TimerStatus decodeTimerStatus(CanFrame frame){
+            return decodeTimerStatus(frame.data, frame.length);
+        };
+
+//TRIES
+        struct Tries{
+          uint16_t current;
+          uint16_t max;
+          uint16_t total;
+          uint16_t flags;
+        };
+
+        static bool encodeTries(char * buffer, uint8_t bufferCount, Tries tries){
+            if(bufferCount < 8){
+              return false; //We need all 64 bits for this method
+            }
+            addUint16ToBuffer(buffer, bufferCount, tries.current, 0);
+            addUint16ToBuffer(buffer, bufferCount, tries.max, 2);
+            addUint16ToBuffer(buffer, bufferCount, tries.total, 4);
+            addUint16ToBuffer(buffer, bufferCount, tries.flags, 6);
+            return true;
+        };
+
+        static Tries decodeTries(const char * buffer, uint8_t bufferCount){
+            Tries tries = {0, 0, 0, 0};
+            if(bufferCount < 8){
+              return tries; //We need all 64 bits for this method
+            }
+            tries.current = extractUint16FromBuffer(buffer, bufferCount, 0);
+            tries.max = extractUint16FromBuffer(buffer, bufferCount, 2);
+            tries.total = extractUint16FromBuffer(buffer, bufferCount, 4);
+            tries.flags = extractUint16FromBuffer(buffer, bufferCount, 6);
+            return tries;
+        };
+
+        static CanFrame encodeTries(uint16_t pmid, uint16_t uid, Tries tries){
+            CanFrame frame = createFrame(pmid, uid);
+            encodeTries(frame.data, frame.length, tries);
+            return frame;
+        };
+
+        static Tries decodeTries(CanFrame frame){
+            return decodeTries(frame.data, frame.length);
+        };
+
+//GPIO
+        //REQUEST_GPIO_ON and REQUEST_GPIO_OFF: 16 bits target device UID, 32 bits pins
+        //REQUEST_CONTROLLER_GPIO, REQUEST_ALL_NODES_GPIO and REQUEST_ALL_GPIO: 32 bits pins to turn ON, 32 bits pins to turn OFF
+        struct GpioRequest{
+          uint16_t targetUid;
+          uint32_t pins;
+        };
+
+        struct GpioMasks{
+          uint32_t onPins;
+          uint32_t offPins;
+        };
+
+        static bool encodeGpioRequest(char * buffer, uint8_t bufferCount, uint16_t targetUid, uint32_t pins){
+            clearBuffer(buffer, bufferCount);
+            if(bufferCount < 6){
+              return false;
+            }
+            addUint16ToBuffer(buffer, bufferCount, targetUid, 0);
+            addUint32ToBuffer(buffer, bufferCount, pins, 2);
+            return true;
+        };
+
+        static GpioRequest decodeGpioRequest(const char * buffer, uint8_t bufferCount){
+            GpioRequest request = {0, 0};
+            if(bufferCount < 6){
+              return request;
+            }
+            request.targetUid = extractUint16FromBuffer(buffer, bufferCount, 0);
+            request.pins = extractUint32FromBuffer(buffer, bufferCount, 2);
+            return request;
+        };
+
+        static bool encodeGpioMasks(char * buffer, uint8_t bufferCount, uint32_t onPins, uint32_t offPins){
+            if(bufferCount < 8){
+              return false; //We need all 64 bits for this method
+            }
+            addUint32ToBuffer(buffer, bufferCount, onPins, 0);
+            addUint32ToBuffer(buffer, bufferCount, offPins, 4);
+            return true;
+        };
+
+        static GpioMasks decodeGpioMasks(const char * buffer, uint8_t bufferCount){
+            GpioMasks masks = {0, 0};
+            if(bufferCount < 8){
+              return masks;
+            }
+            masks.onPins = extractUint32FromBuffer(buffer, bufferCount, 0);
+            masks.offPins = extractUint32FromBuffer(buffer, bufferCount, 4);
+            return masks;
+        };
+
+        static CanFrame encodeGpioMasks(uint16_t pmid, uint16_t uid, uint32_t onPins, uint32_t offPins){
+            CanFrame frame = createFrame(pmid, uid);
+            encodeGpioMasks(frame.data, frame.length, onPins, offPins);
+            return frame;
+        };
+
+        static GpioMasks decodeGpioMasks(CanFrame frame){
+            return decodeGpioMasks(frame.data, frame.length);
+        };
+
+//REQUESTS WITH RESPONSE
+        //Status and progress requests can carry an 8 bit sequence number. A sequence number of 0 means no response is expected.
+        //The receiver of a request with a sequence number answers with RESPONSE_ACK: 16 bits requester UID (the UID of the request's message ID),
+        //16 bits request PMID, 8 bits sequence number and 8 bits result (RESPONSE_RESULT_OK or an application defined error code).
+        //Layouts:
+        //  REQUEST_STATUS_CHANGE:              16 bits target UID, 32 bits status, 8 bits sequence
+        //  REQUEST_PROGRESS_SET:               16 bits target UID, 16 bits progress, 16 bits progress max, 8 bits sequence
+        //  REQUEST_CONTROLLER_STATUS_CHANGE:   32 bits status, 8 bits sequence
+        //See Gm7CanRequestTracker for matching responses, timeouts and retries on the requesting side.
+        static const uint8_t RESPONSE_RESULT_OK = 0;
+
+        struct StatusChangeRequest{
+          uint16_t targetUid;   //Unused for REQUEST_CONTROLLER_STATUS_CHANGE
+          uint32_t status;
+          uint8_t sequence;
+        };
+
+        struct ProgressSetRequest{
+          uint16_t targetUid;
+          uint16_t progress;
+          uint16_t progressMax;
+          uint8_t sequence;
+        };
+
+        struct Ack{
+          uint16_t requesterUid;
+          uint16_t requestPmid;
+          uint8_t sequence;
+          uint8_t result;
+        };
+
+        static bool encodeStatusChangeRequest(char * buffer, uint8_t bufferCount, uint16_t targetUid, uint32_t status, uint8_t sequence = 0){
+            clearBuffer(buffer, bufferCount);
+            if(bufferCount < 7){
+              return false;
+            }
+            addUint16ToBuffer(buffer, bufferCount, targetUid, 0);
+            addUint32ToBuffer(buffer, bufferCount, status, 2);
+            buffer[6] = sequence;
+            return true;
+        };
+
+        static StatusChangeRequest decodeStatusChangeRequest(const char * buffer, uint8_t bufferCount){
+            StatusChangeRequest request = {0, 0, 0};
+            request.targetUid = extractUint16FromBuffer(buffer, bufferCount, 0);
+            request.status = extractUint32FromBuffer(buffer, bufferCount, 2);
+            request.sequence = bufferCount > 6 ? buffer[6] : 0;
+            return request;
+        };
+
+        static bool encodeControllerStatusChangeRequest(char * buffer, uint8_t bufferCount, uint32_t status, uint8_t sequence = 0){
+            clearBuffer(buffer, bufferCount);
+            if(bufferCount < 5){
+              return false;
+            }
+            addUint32ToBuffer(buffer, bufferCount, status, 0);
+            buffer[4] = sequence;
+            return true;
+        };
+
+        static StatusChangeRequest decodeControllerStatusChangeRequest(const char * buffer, uint8_t bufferCount){
+            StatusChangeRequest request = {0, 0, 0};
+            request.status = extractUint32FromBuffer(buffer, bufferCount, 0);
+            request.sequence = bufferCount > 4 ? buffer[4] : 0;
+            return request;
+        };
+
+        static bool encodeProgressSetRequest(char * buffer, uint8_t bufferCount, uint16_t targetUid, uint16_t progress, uint16_t progressMax, uint8_t sequence = 0){
+            clearBuffer(buffer, bufferCount);
+            if(bufferCount < 7){
+              return false;
+            }
+            addUint16ToBuffer(buffer, bufferCount, targetUid, 0);
+            addUint16ToBuffer(buffer, bufferCount, progress, 2);
+            addUint16ToBuffer(buffer, bufferCount, progressMax, 4);
+            buffer[6] = sequence;
+            return true;
+        };
+
+        static ProgressSetRequest decodeProgressSetRequest(const char * buffer, uint8_t bufferCount){
+            ProgressSetRequest request = {0, 0, 0, 0};
+            request.targetUid = extractUint16FromBuffer(buffer, bufferCount, 0);
+            request.progress = extractUint16FromBuffer(buffer, bufferCount, 2);
+            request.progressMax = extractUint16FromBuffer(buffer, bufferCount, 4);
+            request.sequence = bufferCount > 6 ? buffer[6] : 0;
+            return request;
+        };
+
+        static bool encodeAck(char * buffer, uint8_t bufferCount, uint16_t requesterUid, uint16_t requestPmid, uint8_t sequence, uint8_t result = RESPONSE_RESULT_OK){
+            clearBuffer(buffer, bufferCount);
+            if(bufferCount < 6){
+              return false;
+            }
+            addUint16ToBuffer(buffer, bufferCount, requesterUid, 0);
+            addUint16ToBuffer(buffer, bufferCount, requestPmid, 2);
+            buffer[4] = sequence;
+            buffer[5] = result;
+            return true;
+        };
+
+        static Ack decodeAck(const char * buffer, uint8_t bufferCount){
+            Ack ack = {0, 0, 0, 0};
+            if(bufferCount < 6){
+              return ack;
+            }
+            ack.requesterUid = extractUint16FromBuffer(buffer, bufferCount, 0);
+            ack.requestPmid = extractUint16FromBuffer(buffer, bufferCount, 2);
+            ack.sequence = buffer[4];
+            ack.result = buffer[5];
+            return ack;
+        };
+
+        static CanFrame encodeAck(uint16_t uid, uint16_t requesterUid, uint16_t requestPmid, uint8_t sequence, uint8_t result = RESPONSE_RESULT_OK){
+            CanFrame frame = createFrame(RESPONSE_ACK, uid);
+            encodeAck(frame.data, frame.length, requesterUid, requestPmid, sequence, result);
+            return frame;
+        };
+
+        static Ack decodeAck(CanFrame frame){
+            return decodeAck(frame.data, frame.length);
+        };
+
+//ADDRESSED REQUESTS
+        //Requests between REQUEST_ADDRESSED_FILTER_START and -END carry the target device UID in their first 16 bits.
+        //CAN hardware filters can't look at the payload, so every node receives them all. This check is cheap enough to run in the
+        //receive interrupt (one subtraction and compare for the PMID, two loads for the target), so frames for other devices can be dropped
+        //before they reach the application queue. Addressed requests with a payload too short to hold a target are dropped too.
+        //A dropped frame is still a sign of life of its sender. A Gm7CanLivenessTracker in implicit mode must see every frame, so with
+        //setImplicitHeartbeats() on the bus, feed the tracker before this check (or pass the sender's UID on from the interrupt),
+        //otherwise a controller that skips heartbeats while sending requests to other devices is declared offline.
+        static bool isAddressedToOtherDevice(uint32_t canMessageId, const char * buffer, uint8_t bufferCount, uint16_t ownUid){
+            uint16_t pmid = canMessageId >> uniqueIdSize;
+            if((uint16_t)(pmid - (REQUEST_ADDRESSED_FILTER_START + 1)) >= (REQUEST_ADDRESSED_FILTER_END - REQUEST_ADDRESSED_FILTER_START - 1)){
+              return false; //Not an addressed request
+            }
+            if(bufferCount < 2){
+              return true;
+            }
+            return ((((uint16_t)(uint8_t)buffer[0]) << 8) | (uint8_t)buffer[1]) != ownUid;
+        };
+
+        static bool isAddressedToOtherDevice(const CanFrame & frame, uint16_t ownUid){
+            return isAddressedToOtherDevice(frame.id, frame.data, frame.length, ownUid);
+        };
+
+//GROUPS
+        //A controller can give registered devices a group slot (0-47) with REQUEST_GROUP_SLOT_ASSIGN. Group requests carry a 48 bit bitmap of slots,
+        //so one frame reaches any subset of those devices. Bit n of the bitmap is slot n; slot 0 is the lowest bit of the last bitmap byte.
+        //Layouts:
+        //  REQUEST_GROUP_SLOT_ASSIGN:    16 bits target UID, 8 bits slot (GROUP_SLOT_NONE to leave the group)
+        //  REQUEST_GROUP_STATUS_CHANGE:  48 bits slot bitmap, 16 bits status
+        //Group status changes carry only the low 16 bits of the 32 bit status of REQUEST_STATUS_CHANGE, to reach all 48 slots in one frame.
+        //encodeGroupStatusChange() rejects statuses above GROUP_STATUS_MAX; send those as addressed REQUEST_STATUS_CHANGE requests.
+        //Receivers test their own bit with isGroupTarget(). See Gm7CanGroups.h for the slot allocation on the controller side.
+        //REQUEST_GROUP_SLOT_ASSIGN carries a target UID but is deliberately not in the addressed range: every Gm7CanOnlineMap overhears the
+        //assignments of all devices, so isAddressedToOtherDevice() must not drop them.
+        static const uint8_t GROUP_SLOTS = 48;
+        static const uint8_t GROUP_SLOT_NONE = 0xFF;
+        static const uint32_t GROUP_STATUS_MAX = 0xFFFF;
+
+        struct GroupSlotAssign{
+          uint16_t targetUid;
+          uint8_t slot;
+        };
+
+        struct GroupStatusChange{
+          uint64_t slotBitmap;
+          uint16_t status;
+        };
+
+        static bool encodeGroupSlotAssign(char * buffer, uint8_t bufferCount, uint16_t targetUid, uint8_t slot){
+            clearBuffer(buffer, bufferCount);
+            if(bufferCount < 3 || (slot >= GROUP_SLOTS && slot != GROUP_SLOT_NONE)){
+              return false;
+            }
+            addUint16ToBuffer(buffer, bufferCount, targetUid, 0);
+            buffer[2] = slot;
+            return true;
+        };
+
+        static GroupSlotAssign decodeGroupSlotAssign(const char * buffer, uint8_t bufferCount){
+            GroupSlotAssign assign = {0, GROUP_SLOT_NONE};
+            if(bufferCount < 3){
+              return assign;
+            }
+            assign.targetUid = extractUint16FromBuffer(buffer, bufferCount, 0);
+            assign.slot = buffer[2];
+            if(assign.slot >= GROUP_SLOTS){
+              assign.slot = GROUP_SLOT_NONE;
+            }
+            return assign;
+        };
+
+        //Returns false for a status above GROUP_STATUS_MAX instead of cutting it off
+        static bool encodeGroupStatusChange(char * buffer, uint8_t bufferCount, uint64_t slotBitmap, uint32_t status){
+            if(bufferCount < 8){
+              return false; //We need all 64 bits for this method
+            }
+            if(status > GROUP_STATUS_MAX){
+              return false;
+            }
+            addUint64ToBuffer(buffer, bufferCount, ((slotBitmap & 0xFFFFFFFFFFFFULL) << 16) | status, 0);
+            return true;
+        };
+
+        static GroupStatusChange decodeGroupStatusChange(const char * buffer, uint8_t bufferCount){
+            GroupStatusChange change = {0, 0};
+            if(bufferCount < 8){
+              return change;
+            }
+            uint64_t value = extractUint64FromBuffer(buffer, bufferCount, 0);
+            change.slotBitmap = value >> 16;
+            change.status = value;
+            return change;
+        };
+
+        //A single bit test on the payload of any group request, cheap enough for the receive interrupt
+        static bool isGroupTarget(const char * buffer, uint8_t bufferCount, uint8_t slot){
+            if(slot >= GROUP_SLOTS || bufferCount < 6){
+              return false;
+            }
+            return (buffer[5 - (slot >> 3)] >> (slot & 7)) & 1;
+        };
+
+        //CONTROLLER_ONLINE_BITMAP: 8 bits page, 56 bits online bitmap. Bit n of page p is slot (p * 56) + n, bit 0 is the lowest bit of the last byte.
+        //The slots are the group slots above, so a page 0 frame covers all of them. See Gm7CanOnlineMap.h.
+        static const uint8_t ONLINE_BITMAP_SLOTS_PER_PAGE = 56;
+
+        struct OnlineBitmap{
+          uint8_t page;
+          uint64_t bitmap;
+        };
+
+        static bool encodeOnlineBitmap(char * buffer, uint8_t bufferCount, uint8_t page, uint64_t bitmap){
+            if(bufferCount < 8){
+              return false; //We need all 64 bits for this method
+            }
+            addUint64ToBuffer(buffer, bufferCount, ((uint64_t)page << 56) | (bitmap & 0x00FFFFFFFFFFFFFFULL), 0);
+            return true;
+        };
+
+        static OnlineBitmap decodeOnlineBitmap(const char * buffer, uint8_t bufferCount){
+            OnlineBitmap online = {0, 0};
+            if(bufferCount < 8){
+              return online;
+            }
+            uint64_t value = extractUint64FromBuffer(buffer, bufferCount, 0);
+            online.page = value >> 56;
+            online.bitmap = value & 0x00FFFFFFFFFFFFFFULL;
+            return online;
+        };
+
+//IDENTIFY
+        //REQUEST_ALL_IDENTIFY asks every device for its device info frames (DEVICE_TYPE_ID, DEVICE_SERIAL, DEVICE_MODEL, DEVICE_VENDOR, DEVICE_SHORT_NAME).
+        //The round is split in slots of slotMillis; every device answers in the slot picked by a hash of its UID, so only a few devices send at once.
+        //The amount of slots follows from the node count hint of the request, and so does the length of the round: getIdentifyDurationMillis().
+        //Layout: 8 bits node count hint, 16 bits slot millis, 8 bits round (a new number for every new round)
+        //Pick slotMillis so two devices fit in a slot: 5 extended frames take about 7 ms at 125 kbit/s. See Gm7CanIdentify.h.
+        //The hash does not limit how many UID's share a slot, so a crowded slot can run over into the next ones. The duration therefore
+        //also allows for the worst case: every device in the last slot, sending all its frames one after the other.
+        static const uint8_t IDENTIFY_FRAMES_PER_DEVICE = 5;
+        static const uint16_t IDENTIFY_FRAME_BITS = 160; //An extended frame with 8 data bytes, worst case bit stuffing and the interframe space
+        static const uint16_t IDENTIFY_SLOT_MILLIS_DEFAULT = 20;
+        static const uint16_t IDENTIFY_SLOTS_MAX = 512;
+
+        struct IdentifyRequest{
+          uint8_t nodeCountHint;
+          uint16_t slotMillis;
+          uint8_t round;
+        };
+
+        static bool encodeIdentifyRequest(char * buffer, uint8_t bufferCount, uint8_t nodeCountHint, uint16_t slotMillis, uint8_t round){
+            clearBuffer(buffer, bufferCount);
+            if(bufferCount < 4){
+              return false;
+            }
+            buffer[0] = nodeCountHint;
+            addUint16ToBuffer(buffer, bufferCount, slotMillis, 1);
+            buffer[3] = round;
+            return true;
+        };
+
+        static IdentifyRequest decodeIdentifyRequest(const char * buffer, uint8_t bufferCount){
+            IdentifyRequest request = {0, 0, 0};
+            if(bufferCount < 4){
+              return request;
+            }
+            request.nodeCountHint = buffer[0];
+            request.slotMillis = extractUint16FromBuffer(buffer, bufferCount, 1);
+            request.round = buffer[3];
+            return request;
+        };
+
+        //Twice the hint, rounded up to a power of 2, so few UID's share a slot
+        static uint16_t getIdentifySlotCount(uint8_t nodeCountHint){
+            uint16_t slots = 1;
+            while(slots < (uint16_t)nodeCountHint * 2 && slots < IDENTIFY_SLOTS_MAX){
+              slots <<= 1;
+            }
+            return slots;
+        };
+
+        static uint16_t getIdentifySlot(uint16_t uid, uint16_t slotCount){
+            return ((uint32_t)(uint16_t)(uid * 40503u) * slotCount) >> 16; //Fibonacci hashing, scaled to the slot count
+        };
+
+        //Every device has answered after this, counted from the moment the request was sent: the start of the last slot plus the bus time
+        //of the frames of all nodeCountHint devices, or the end of the last slot if that is later. This holds for any spread of UID's over
+        //the slots, as long as there are no more devices than the hint, the bus carries nothing else and devices poll at least every millisecond.
+        static uint32_t getIdentifyDurationMillis(uint8_t nodeCountHint, uint16_t slotMillis, uint32_t baudrate = 125000){
+            uint32_t slots = getIdentifySlotCount(nodeCountHint);
+            uint32_t busBits = (uint32_t)nodeCountHint * IDENTIFY_FRAMES_PER_DEVICE * IDENTIFY_FRAME_BITS;
+            uint32_t busMillis = baudrate == 0 ? 0 : ((busBits * 1000) + baudrate - 1) / baudrate;
+            uint32_t crowded = ((slots - 1) * slotMillis) + busMillis + 1; //+1 for the poll interval of the devices
+            return crowded > slots * slotMillis ? crowded : slots * slotMillis;
+        };
+
+//EVENTS
+        //decodeEvent() turns a received frame into a typed event in one call, so receivers (or a gateway feeding other software) don't need their own PMID dispatch.
+        //Nothing is allocated; the event is returned by value. Payloads that are shorter than their layout require result in EVENT_INVALID.
+        enum EventType : uint8_t {
+          EVENT_UNKNOWN = 0,
+          EVENT_INVALID = 1,
+          EVENT_EMERGENCY = 2,
+          EVENT_HEARTBEAT = 3,
+          EVENT_STATUS_AND_PROGRESS = 4,
+          EVENT_MAIN_TIMER = 5,
+          EVENT_VALIDATION_TIMER = 6,
+          EVENT_INTERNAL_TIMER = 7,
+          EVENT_TRIES = 8,
+          EVENT_REGISTRATION = 9,
+          EVENT_DEVICE_INFO = 10,
+          EVENT_REQUEST = 11,
+          EVENT_ACK = 12,
+          EVENT_ONLINE_BITMAP = 13
+        };
+
+        struct Event{
+          EventType type;
+          uint8_t canDeviceType;  //The CanDeviceType of the sender for heartbeats, statusses, timers and tries. 0 otherwise.
+          MessageId messageId;
+          union {
+            Heartbeat heartbeat;                    //EVENT_HEARTBEAT
+            StatusAndProgress statusAndProgress;    //EVENT_STATUS_AND_PROGRESS
+            TimerStatus timerStatus;                //EVENT_*_TIMER
+            Tries tries;                            //EVENT_TRIES
+            uint16_t deviceTypeId;                  //EVENT_REGISTRATION
+            Ack ack;                                //EVENT_ACK
+            OnlineBitmap onlineBitmap;              //EVENT_ONLINE_BITMAP
+          };
+        };
+
+        //Returns the CanDeviceType that owns a heartbeat or status PMID, 0 if the PMID is not in one of these sections
+        static uint8_t getCanDeviceTypeForPmid(uint16_t pmid){
+          if(pmid > HEARTBEATS_START && pmid < HEARTBEATS_END){
+            if(pmid == HEARTBEAT_CONTROLLER) { return CanDeviceType::CONTROLLER; }
+            if(pmid == HEARTBEAT_MODULE) { return CanDeviceType::MODULE; }
+            if(pmid == HEARTBEAT_PERIPHERAL) { return CanDeviceType::PERIPHERAL; }
+            if(pmid == HEARTBEAT_EXTERNAL_DEVICE) { return CanDeviceType::EXTERNAL_DEVICE; }
+            if(pmid == HEARTBEAT_CONTROLLER_ADAPTIVE) { return CanDeviceType::CONTROLLER; }
+            return 0;
+          }
+          if(pmid > CONTROLLER_SECTION_START && pmid < CONTROLLER_SECTION_END) { return CanDeviceType::CONTROLLER; }
+          if(pmid > MODULE_SECTION_START && pmid < MODULE_SECTION_END) { return CanDeviceType::MODULE; }
+          if(pmid > PERIPHERAL_SECTION_START && pmid < PERIPHERAL_SECTION_END) { return CanDeviceType::PERIPHERAL; }
+          if(pmid > EXTERNAL_DEVICE_SECTION_START && pmid < EXTERNAL_DEVICE_SECTION_END) { return CanDeviceType::EXTERNAL_DEVICE; }
+          return 0;
+        };
+
+        static Event decodeEvent(uint32_t canMessageId, const char * buffer, uint8_t bufferCount){
+          Event event;
+          memset(&event, 0, sizeof(event));
+          event.messageId = parseMessageId(canMessageId);
+          uint16_t pmid = event.messageId.pmid;
+          event.canDeviceType = getCanDeviceTypeForPmid(pmid);
+          if(event.canDeviceType != 0){
+            if(pmid < HEARTBEATS_END){
+              if(bufferCount < 4){ event.type = EVENT_INVALID; return event; }
+              event.type = EVENT_HEARTBEAT;
+              if(pmid == HEARTBEAT_CONTROLLER_ADAPTIVE){
+                if(bufferCount < 8){ event.type = EVENT_INVALID; return event; }
+                event.heartbeat = decodeAdaptiveHeartbeat(buffer, bufferCount);
+                return event;
+              }
+              event.heartbeat = decodeHeartbeat(buffer, bufferCount);
+              return event;
+            }
+            if(bufferCount < 8){ event.type = EVENT_INVALID; return event; }
+            if(pmid == CONTROLLER_ONLINE_BITMAP){
+              event.type = EVENT_ONLINE_BITMAP;
+              event.onlineBitmap = decodeOnlineBitmap(buffer, bufferCount);
+              return event;
+            }
+            //All status sections share the same layout relative to their section start
+            uint16_t sectionStart = pmid - ((pmid - CONTROLLER_SECTION_START) % (MODULE_SECTION_START - CONTROLLER_SECTION_START));
+            uint16_t offset = pmid - sectionStart;
+            if(offset == MODULE_STATUS_AND_PROGRESS - MODULE_SECTION_START){
+              event.type = EVENT_STATUS_AND_PROGRESS;
+              event.statusAndProgress = decodeModuleStatusAndProgress(buffer, bufferCount);
+            } else if(offset == MODULE_MAIN_TIMER_STATUS - MODULE_SECTION_START){
+              event.type = EVENT_MAIN_TIMER;
+              event.timerStatus = decodeTimerStatus(buffer, bufferCount);
+            } else if(offset == MODULE_VALIDATION_TIMER_STATUS - MODULE_SECTION_START){
+              event.type = EVENT_VALIDATION_TIMER;
+              event.timerStatus = decodeTimerStatus(buffer, bufferCount);
+            } else if(offset == MODULE_INTERNAL_TIMER_STATUS - MODULE_SECTION_START){
+              event.type = EVENT_INTERNAL_TIMER;
+              event.timerStatus = decodeTimerStatus(buffer, bufferCount);
+            } else if(offset == MODULE_TRIES - MODULE_SECTION_START && pmid < PERIPHERAL_SECTION_START){
+              event.type = EVENT_TRIES;
+              event.tries = decodeTries(buffer, bufferCount);
+            }
+            return event;
+          }
+          if(pmid > EMERGENCY_SECTION_START && pmid < EMERGENCY_SECTION_END){
+            event.type = EVENT_EMERGENCY;
+            return event;
+          }
+          if(pmid > REQUEST_SECTION_START && pmid < REQUEST_SECTION_END){
+            event.type = EVENT_REQUEST;
+            return event;
+          }
+          if(pmid == RESPONSE_ACK){
+            if(bufferCount < 6){ event.type = EVENT_INVALID; return event; }
+            event.type = EVENT_ACK;
+            event.ack = decodeAck(buffer, bufferCount);
+            return event;
+          }
+          if(pmid > DEVICE_SECTION_START && pmid < DEVICE_SECTION_END){
+            event.type = EVENT_DEVICE_INFO;
+            return event;
+          }
+          if(pmid == DEVICE_REGISTRATION_REQUEST){
+            if(bufferCount < 2){ event.type = EVENT_INVALID; return event; }
+            event.type = EVENT_REGISTRATION;
+            event.deviceTypeId = extractUint16FromBuffer(buffer, bufferCount, 0);
+            return event;
+          }
+          if(pmid > DEVICE_TYPE_SECTION_START && pmid < DEVICE_TYPE_SECTION_END){
+            event.type = EVENT_REGISTRATION; //The device type id is used as PMID itself
+            event.deviceTypeId = pmid;
+            return event;
+          }
+          return event;
+        };
+
+        static Event decodeEvent(CanFrame frame){
+          return decodeEvent(frame.id, frame.data, frame.length);
+        };
+
 
 ///////////////////////////////////////////////////
 /////
@@ -310,16 +1248,18 @@ class Gm7CanProtocol {
 /////
 ///////////////////////////////////////////////////
 
+        //Every PMID must have its own value. When adding one, also add it to GM7_CAN_PMID_LIST in Gm7CanPmidIndex.h; that header refuses to compile on duplicates.
+
         //EMERGENCY CALLS
         //These calls are meant to deter unsafe situations that could arise.
         //Remember that anything connected to the CAN bus can send these commands, even Read-only devices. Make sure that there are no spurious or random calls in these sections, because it can cause a lot of grief.
         //Also remember that not all connected devices may have code implemented to listen to any of these calls; makse sure you test their functionality before trusting these calls.
         //Anything that uses mains power, relays through mains power, uses high current or anything that could cause harm to people if left in a faulty state, should have these calls properly implemented.
-        const uint16_t EMERGENCY_SECTION_START = 1;
-          const uint16_t EMERGENCY_SHUTDOWN = 2; //This call should order all devices to kill power it relays trough, it receives and uses; shutting down effectively.
-          const uint16_t EMERGENCY_FAILSAFE = 3; //This call should order all connected devices on the bus to return to a safe state immediately. For example: shutting down (if possible), dropping enacted relays or stop using mains power.
-          const uint16_t EMERGENCY_FIRE_ALARM = 4; //This alarm should signal to anything that can display it, that there is a possible fire going on. Smoke detectors, connected to the CAN, bus can use this call
-        const uint16_t EMERGENCY_SECTION_END = 99;
+        static const uint16_t EMERGENCY_SECTION_START = 1;
+          static const uint16_t EMERGENCY_SHUTDOWN = 2; //This call should order all devices to kill power it relays trough, it receives and uses; shutting down effectively.
+          static const uint16_t EMERGENCY_FAILSAFE = 3; //This call should order all connected devices on the bus to return to a safe state immediately. For example: shutting down (if possible), dropping enacted relays or stop using mains power.
+          static const uint16_t EMERGENCY_FIRE_ALARM = 4; //This alarm should signal to anything that can display it, that there is a possible fire going on. Smoke detectors, connected to the CAN, bus can use this call
+        static const uint16_t EMERGENCY_SECTION_END = 99;
         
         //HEARTBEATS
         //Heartbeats are mandatory to use according to the GM7 protocol. Every 1 second a heartbeat should be sent on the bus, using one of these PMID's.
@@ -329,59 +1269,79 @@ class Gm7CanProtocol {
         //However, registration requests are not really mandatory for generic devices, but it helps the controller to keep track of what's connected.
         //Game modules must be registered, because a game will use the registered devices list as a guide to what modules to activate when the game starts.
         //Also configuration files can be saved per module UID. By registering them, these files can be saved/loaded properly.
-        const uint16_t HEARTBEATS_START = 200;
-          const uint16_t HEARTBEAT_CONTROLLER = 201;
-          const uint16_t HEARTBEAT_MODULE = 202;
-          const uint16_t HEARTBEAT_PERIPHERAL = 203;
-          const uint16_t HEARTBEAT_EXTERNAL_DEVICE = 204;
-        const uint16_t HEARTBEATS_END = 299;
+        static const uint16_t HEARTBEATS_START = 200;
+          static const uint16_t HEARTBEAT_CONTROLLER = 201;
+          static const uint16_t HEARTBEAT_MODULE = 202;
+          static const uint16_t HEARTBEAT_PERIPHERAL = 203;
+          static const uint16_t HEARTBEAT_EXTERNAL_DEVICE = 204;
+          static const uint16_t HEARTBEAT_CONTROLLER_ADAPTIVE = 205; //Controller heartbeat that also advertises the heartbeat interval and timeout all nodes should use. See encodeAdaptiveHeartbeat().
+        static const uint16_t HEARTBEATS_END = 299;
 
         //Generic statusses.
-        const uint16_t STATUS_CONTROLLER = 1001;
-        const uint16_t STATUS_MODULE = 1002;
-        const uint16_t STATUS_PERIPHERAL = 1003; 
-        const uint16_t STATUS_EXTERNAL_DEVICE = 1004; 
+        static const uint16_t STATUS_SECTION_START = 1000;
+          static const uint16_t STATUS_CONTROLLER = 1001;
+          static const uint16_t STATUS_MODULE = 1002;
+          static const uint16_t STATUS_PERIPHERAL = 1003; 
+          static const uint16_t STATUS_EXTERNAL_DEVICE = 1004; 
+        static const uint16_t STATUS_SECTION_END = 1999;
+
+        //REQUESTS
+        //All requests are between REQUEST_SECTION_START and -END, their responses follow in the RESPONSE section.
+        static const uint16_t REQUEST_SECTION_START = 2000;
 
         //Anything that sees itself as a controller needs to listen to these commands
-        const uint16_t REQUEST_CONTROLLER_STATUS_CHANGE = 2001;
-        const uint16_t REQUEST_CONTROLLER_GPIO = 2011; //First 32 bits for turning ON gpio pins, second 32 bits for turning OFF gpio pins
+        static const uint16_t REQUEST_CONTROLLER_STATUS_CHANGE = 2001; //32 bits status, 8 bits sequence
+        static const uint16_t REQUEST_CONTROLLER_GPIO = 2011; //First 32 bits for turning ON gpio pins, second 32 bits for turning OFF gpio pins
         
         //Single node/controller requests. THE FIRST 16 bits of these data packages will be parsed as message Id. 
-        const uint16_t REQUEST_ADDRESSED_FILTER_START = 2100; //Use this and the -END variant to make a filter that reject or allows requests on node-level implementations
-        const uint16_t REQUEST_STATUS_CHANGE = 2101;
-        const uint16_t REQUEST_GPIO_ON = 2111; //First 16 bits for device ID, second 32 bits for turning ON gpio pins
-        const uint16_t REQUEST_GPIO_OFF = 2112; //First 16 bits for device ID, second 32 bits for turning OFF gpio pins
-        const uint16_t REQUEST_PROGRESS_SET = 2113;
-        const uint16_t REQUEST_ADDRESSED_FILTER_END = 2199; //Use this and the -START variant to make a filter that reject or allows requests on node-level implementations
+        static const uint16_t REQUEST_ADDRESSED_FILTER_START = 2100; //Use this and the -END variant to make a filter that reject or allows requests on node-level implementations
+        static const uint16_t REQUEST_STATUS_CHANGE = 2101; //First 16 bits for device ID, 32 bits status, 8 bits sequence
+        static const uint16_t REQUEST_GPIO_ON = 2111; //First 16 bits for device ID, second 32 bits for turning ON gpio pins
+        static const uint16_t REQUEST_GPIO_OFF = 2112; //First 16 bits for device ID, second 32 bits for turning OFF gpio pins
+        static const uint16_t REQUEST_PROGRESS_SET = 2113; //First 16 bits for device ID, 16 bits progress, 16 bits progress max, 8 bits sequence
+        static const uint16_t REQUEST_ADDRESSED_FILTER_END = 2199; //Use this and the -START variant to make a filter that reject or allows requests on node-level implementations
 
         //All connected nodes and peripherals should listen to these commands, controllers are exempt.
-        const uint16_t REQUEST_ALL_NODES_STATUS_CHANGE = 2201;
-        const uint16_t REQUEST_ALL_NODES_GPIO = 2211; //First 32 bits for turning ON gpio pins, second 32 bits for turning OFF gpio pins
+        static const uint16_t REQUEST_ALL_NODES_STATUS_CHANGE = 2201;
+        static const uint16_t REQUEST_ALL_NODES_GPIO = 2211; //First 32 bits for turning ON gpio pins, second 32 bits for turning OFF gpio pins
 
         //All connected devices should listen to these commands, even controllers.
-        const uint16_t REQUEST_ALL_STATUS_CHANGE = 2301;
-        const uint16_t REQUEST_ALL_GPIO = 2311; //First 32 bits for turning ON gpio pins, second 32 bits for turning OFF gpio pins
-
-        const uint16_t DEVICE_SECTION_START = 4000;
-          const uint16_t DEVICE_SERIAL = 4001; //MAX 64 bits
-          const uint16_t DEVICE_MODEL = 4002; //MAX 7 chars (+ 1 terminator) chars
-          const uint16_t DEVICE_TYPE_ID = 4003;  //INT
-          const uint16_t DEVICE_VENDOR = 4004;  //MAX 7 chars
-          const uint16_t DEVICE_SHORT_NAME = 4005;  //MAX 7 chars
-          const uint16_t DEVICE_VITALS_BATTERY = 4004;
-          const uint16_t DEVICE_VITALS_CONNECTION = 4005;
-          const uint16_t DEVICE_VITALS_DEBUGGING = 4006;
-          const uint16_t DEVICE_STATUS = 4007; //General purpose status. To be implemented.
-        const uint16_t DEVICE_SECTION_END = 4099;
+        static const uint16_t REQUEST_ALL_STATUS_CHANGE = 2301;
+        static const uint16_t REQUEST_ALL_GPIO = 2311; //First 32 bits for turning ON gpio pins, second 32 bits for turning OFF gpio pins
+        static const uint16_t REQUEST_ALL_IDENTIFY = 2321; //8 bits node count hint, 16 bits slot millis, 8 bits round (see IDENTIFY)
+        //Devices with an assigned group slot should listen to these commands when their bit is set (see GROUPS).
+        static const uint16_t REQUEST_GROUP_SECTION_START = 2400;
+          static const uint16_t REQUEST_GROUP_STATUS_CHANGE = 2401; //48 bits group slot bitmap, 16 bits status (max GROUP_STATUS_MAX)
+          static const uint16_t REQUEST_GROUP_SLOT_ASSIGN = 2411; //First 16 bits for device ID, 8 bits group slot (see GROUPS)
+        static const uint16_t REQUEST_GROUP_SECTION_END = 2499;
+        static const uint16_t REQUEST_SECTION_END = 2499;
+
+        //Responses to requests that carry a sequence number (see REQUESTS WITH RESPONSE)
+        static const uint16_t RESPONSE_SECTION_START = 2500;
+          static const uint16_t RESPONSE_ACK = 2501; //16 bits requester UID, 16 bits request PMID, 8 bits sequence, 8 bits result
+        static const uint16_t RESPONSE_SECTION_END = 2599;
+
+        static const uint16_t DEVICE_SECTION_START = 4000;
+          static const uint16_t DEVICE_SERIAL = 4001; //MAX 64 bits
+          static const uint16_t DEVICE_MODEL = 4002; //MAX 10 packed chars, or 8 ASCII chars (see PACKED STRINGS)
+          static const uint16_t DEVICE_TYPE_ID = 4003;  //INT
+          static const uint16_t DEVICE_VENDOR = 4004;  //MAX 10 packed chars, or 8 ASCII chars
+          static const uint16_t DEVICE_SHORT_NAME = 4005;  //MAX 10 packed chars, or 8 ASCII chars
+          static const uint16_t DEVICE_VITALS_DEBUGGING = 4006;
+          static const uint16_t DEVICE_STATUS = 4007; //General purpose status. To be implemented.
+          static const uint16_t DEVICE_UID_CLAIM = 4008; //64 bits serial number of the device claiming the UID of the message ID
+          static const uint16_t DEVICE_VITALS_BATTERY = 4009; //Was 4004, which is DEVICE_VENDOR
+          static const uint16_t DEVICE_VITALS_CONNECTION = 4010; //Was 4005, which is DEVICE_SHORT_NAME
+        static const uint16_t DEVICE_SECTION_END = 4099;
 
         //The ID of any of the devices below could be sent as payload (uint16, MSB) with the device DEVICE_REGISTRATION_REQUEST
         //Alternatively it is possible to use any of these register ID's as the PMID itself for device registration, 
         //You will need to implement either of two methods (or both) in your own code and methods to parse the registration correctly.
         //It does not really matter, since none of these ID's are used as PMID's for something else anyhow. 
         //Remember that these ID's are static members, so they can be used to easily 'hardcode' Device Type ID's based on this scheme (recommended).
-        const uint16_t DEVICE_TYPE_SECTION_START =               4100;
-          const uint16_t DEVICE_REGISTRATION_REQUEST =             4100; //A request from a device to register to any connected controller. Use a device type in the payload.
-          const uint16_t DEVICE_TYPE_CONTROLLER_SECTION_START =    4100;
+        static const uint16_t DEVICE_TYPE_SECTION_START =               4100;
+          static const uint16_t DEVICE_REGISTRATION_REQUEST =             4100; //A request from a device to register to any connected controller. Use a device type in the payload.
+          static const uint16_t DEVICE_TYPE_CONTROLLER_SECTION_START =    4100;
             static const uint16_t DEVICE_TYPE_CONTROLLER_SBC =       4101;  //A Single board computer, like a Raspberry Pi or something.
             static const uint16_t DEVICE_TYPE_CONTROLLER_MCU =       4102;  //A microcontroller of any sorts
             static const uint16_t DEVICE_TYPE_CONTROLLER_SERVER =    4103;  //Some kind of server
@@ -404,8 +1364,8 @@ class Gm7CanProtocol {
             static const uint16_t DEVICE_TYPE_CONTROLLER_DEV   =     4120;  //Some random dev device
             static const uint16_t DEVICE_TYPE_CONTROLLER_TEST   =    4121;  //Some random test device
             static const uint16_t DEVICE_TYPE_CONTROLLER_DEBUG   =   4122;  //Some random debug device
-          const uint16_t DEVICE_TYPE_CONTROLLER_SECTION_END =      4199;
-          const uint16_t DEVICE_TYPE_MODULE_SECTION_START =        4200;
+          static const uint16_t DEVICE_TYPE_CONTROLLER_SECTION_END =      4199;
+          static const uint16_t DEVICE_TYPE_MODULE_SECTION_START =        4200;
             static const uint16_t DEVICE_TYPE_MODULE_TIMER       =   4201;  //An external timer module (counting down)
             static const uint16_t DEVICE_TYPE_MODULE_CLOCK       =   4202;  //An external clock module (counting up)  
             static const uint16_t DEVICE_TYPE_MODULE_TIMERCLOCK  =   4203;  //An external module consisting of clocks and timers 
@@ -416,49 +1376,50 @@ class Gm7CanProtocol {
             static const uint16_t DEVICE_TYPE_MODULE_GENERIC_RO =    4208;  //An external module reading (Read Only) generic data from the CAN network
             static const uint16_t DEVICE_TYPE_MODULE_GAME_MODULE =   4209;  //An external game module for use in room controllers and GM7UTB games. Uses advanced interaction.
             static const uint16_t DEVICE_TYPE_MODULE_TEST =          4210;  //An external module used for testing anything useful on the CAN bus
-          const uint16_t DEVICE_TYPE_MODULE_SECTION_END =          4299;
-          const uint16_t DEVICE_TYPE_PERIPHERAL_SECTION_START =    4300;
+          static const uint16_t DEVICE_TYPE_MODULE_SECTION_END =          4299;
+          static const uint16_t DEVICE_TYPE_PERIPHERAL_SECTION_START =    4300;
             static const uint16_t DEVICE_TYPE_PERIPHERAL_KEYBOARD =  4301;  //A peripheral, acting as a keyboard
-          const uint16_t DEVICE_TYPE_PERIPHERAL_SECTION_END =      4399;
-          const uint16_t DEVICE_TYPE_EXTERNAL_SECTION_START =      4400;
-            static const uint16_t DEVICE_TYPE_EXTERNAL_GENERIC =     4301;  //An external generic device.
-          const uint16_t DEVICE_TYPE_EXTERNAL_SECTION_END =        4499;
-        const uint16_t DEVICE_TYPE_SECTION_END =                 4499;
+          static const uint16_t DEVICE_TYPE_PERIPHERAL_SECTION_END =      4399;
+          static const uint16_t DEVICE_TYPE_EXTERNAL_SECTION_START =      4400;
+            static const uint16_t DEVICE_TYPE_EXTERNAL_GENERIC =     4401;  //An external generic device. Was 4301, which is DEVICE_TYPE_PERIPHERAL_KEYBOARD
+          static const uint16_t DEVICE_TYPE_EXTERNAL_SECTION_END =        4499;
+        static const uint16_t DEVICE_TYPE_SECTION_END =                 4499;
         
-        const uint16_t CONTROLLER_SECTION_START = 5100;
-          const uint16_t CONTROLLER_STATUS_AND_PROGRESS = 5101; //32 bits status, 16 bits left for progress max, 16 bits for progress current
-          const uint16_t CONTROLLER_MAIN_TIMER_STATUS = 5102; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t CONTROLLER_VALIDATION_TIMER_STATUS = 5103; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t CONTROLLER_INTERNAL_TIMER_STATUS = 5104; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t CONTROLLER_TRIES = 5105; //First 16 bits: tries current, next 16 bits: tries max, next 16 bits: total tries counter, next 16 bits: setting flags
-        const uint16_t CONTROLLER_SECTION_END = 5299;
-
-        const uint16_t MODULE_SECTION_START = 5300;
-          const uint16_t MODULE_STATUS_AND_PROGRESS = 5301; //32 bits status, 16 bits left for progress max, 16 bits for progress current
-          const uint16_t MODULE_MAIN_TIMER_STATUS = 5302; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t MODULE_VALIDATION_TIMER_STATUS = 5303; //32 bits for current validation timeleft, 32 for set validation timer
-          const uint16_t MODULE_INTERNAL_TIMER_STATUS = 5304; //32 bits for current internal timeleft, 32 for set internal timer
-          const uint16_t MODULE_TRIES = 5305; //First 16 bits: tries current, next 16 bits: tries max, next 16 bits: total tries counter, next 16 bits: setting flags
-        const uint16_t MODULE_SECTION_END = 5499;
-
-        const uint16_t PERIPHERAL_SECTION_START = 5500;
-          const uint16_t PERIPHERAL_STATUS_AND_PROGRESS = 5501; //32 bits status, 16 bits left for progress max, 16 bits for progress current
-          const uint16_t PERIPHERAL_MAIN_TIMER_STATUS = 5502; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t PERIPHERAL_VALIDATION_TIMER_STATUS = 5503; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t PERIPHERAL_INTERNAL_TIMER_STATUS = 5504; //32 bits for current internal timeleft, 32 for set internal timer
-        const uint16_t PERIPHERAL_SECTION_END = 5699;
-
-        const uint16_t EXTERNAL_DEVICE_SECTION_START = 5700;
-          const uint16_t EXTERNAL_DEVICE_STATUS_AND_PROGRESS = 5701; //32 bits status, 16 bits left for progress max, 16 bits for progress current
-          const uint16_t EXTERNAL_DEVICE_MAIN_TIMER_STATUS = 5702; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t EXTERNAL_DEVICE_VALIDATION_TIMER_STATUS = 5703; //32 bits for current main timer timeleft, 32 for set main timer
-          const uint16_t EXTERNAL_DEVICE_INTERNAL_TIMER_STATUS = 5704; //32 bits for current internal timeleft, 32 for set internal timer
-        const uint16_t EXTERNAL_DEVICE_SECTION_END = 5899;
+        static const uint16_t CONTROLLER_SECTION_START = 5100;
+          static const uint16_t CONTROLLER_STATUS_AND_PROGRESS = 5101; //32 bits status, 16 bits left for progress max, 16 bits for progress current
+          static const uint16_t CONTROLLER_MAIN_TIMER_STATUS = 5102; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t CONTROLLER_VALIDATION_TIMER_STATUS = 5103; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t CONTROLLER_INTERNAL_TIMER_STATUS = 5104; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t CONTROLLER_TRIES = 5105; //First 16 bits: tries current, next 16 bits: tries max, next 16 bits: total tries counter, next 16 bits: setting flags
+          static const uint16_t CONTROLLER_ONLINE_BITMAP = 5106; //8 bits page, 56 bits online state of the group slots (see GROUPS)
+        static const uint16_t CONTROLLER_SECTION_END = 5299;
+
+        static const uint16_t MODULE_SECTION_START = 5300;
+          static const uint16_t MODULE_STATUS_AND_PROGRESS = 5301; //32 bits status, 16 bits left for progress max, 16 bits for progress current
+          static const uint16_t MODULE_MAIN_TIMER_STATUS = 5302; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t MODULE_VALIDATION_TIMER_STATUS = 5303; //32 bits for current validation timeleft, 32 for set validation timer
+          static const uint16_t MODULE_INTERNAL_TIMER_STATUS = 5304; //32 bits for current internal timeleft, 32 for set internal timer
+          static const uint16_t MODULE_TRIES = 5305; //First 16 bits: tries current, next 16 bits: tries max, next 16 bits: total tries counter, next 16 bits: setting flags
+        static const uint16_t MODULE_SECTION_END = 5499;
+
+        static const uint16_t PERIPHERAL_SECTION_START = 5500;
+          static const uint16_t PERIPHERAL_STATUS_AND_PROGRESS = 5501; //32 bits status, 16 bits left for progress max, 16 bits for progress current
+          static const uint16_t PERIPHERAL_MAIN_TIMER_STATUS = 5502; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t PERIPHERAL_VALIDATION_TIMER_STATUS = 5503; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t PERIPHERAL_INTERNAL_TIMER_STATUS = 5504; //32 bits for current internal timeleft, 32 for set internal timer
+        static const uint16_t PERIPHERAL_SECTION_END = 5699;
+
+        static const uint16_t EXTERNAL_DEVICE_SECTION_START = 5700;
+          static const uint16_t EXTERNAL_DEVICE_STATUS_AND_PROGRESS = 5701; //32 bits status, 16 bits left for progress max, 16 bits for progress current
+          static const uint16_t EXTERNAL_DEVICE_MAIN_TIMER_STATUS = 5702; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t EXTERNAL_DEVICE_VALIDATION_TIMER_STATUS = 5703; //32 bits for current main timer timeleft, 32 for set main timer
+          static const uint16_t EXTERNAL_DEVICE_INTERNAL_TIMER_STATUS = 5704; //32 bits for current internal timeleft, 32 for set internal timer
+        static const uint16_t EXTERNAL_DEVICE_SECTION_END = 5899;
 
 
   //You can use this method to sort of automatically assign a Can Device Type to any device, based on the supplied device type id.
   //For this to work, you will need to use the device type id's as listed in the PMID list above and select the proper one for your sepcific device
-  uint8_t extractCanDeviceTypeFromDeviceTypeId(uint16_t deviceTypeId){
+  static uint8_t extractCanDeviceTypeFromDeviceTypeId(uint16_t deviceTypeId){
     if(deviceTypeId == DEVICE_TYPE_MODULE_GENERIC_RO){
       return CanDeviceType::READ_ONLY;
     }
@@ -477,7 +1438,7 @@ class Gm7CanProtocol {
     return CanDeviceType::READ_ONLY;
   };
 
-  uint16_t getPmidHeartbeatForDeviceType(uint8_t canDeviceType){
+  static uint16_t getPmidHeartbeatForDeviceType(uint8_t canDeviceType){
     if(canDeviceType == CanDeviceType::CONTROLLER) { return HEARTBEAT_CONTROLLER; }
     if(canDeviceType == CanDeviceType::MODULE) { return HEARTBEAT_MODULE; }
     if(canDeviceType == CanDeviceType::PERIPHERAL) { return HEARTBEAT_PERIPHERAL; }
@@ -485,7 +1446,7 @@ class Gm7CanProtocol {
     return 0;
   };
 
-  uint16_t getPmidGameStatusForDeviceType(uint8_t canDeviceType){
+  static uint16_t getPmidGameStatusForDeviceType(uint8_t canDeviceType){
     if(canDeviceType == CanDeviceType::CONTROLLER) { return CONTROLLER_STATUS_AND_PROGRESS; }
     if(canDeviceType == CanDeviceType::MODULE) { return MODULE_STATUS_AND_PROGRESS; }
     if(canDeviceType == CanDeviceType::PERIPHERAL) { return PERIPHERAL_STATUS_AND_PROGRESS; }
@@ -493,7 +1454,7 @@ class Gm7CanProtocol {
     return 0;
   };
 
-  uint16_t getPmidMainTimerForDeviceType(uint8_t canDeviceType){
+  static uint16_t getPmidMainTimerForDeviceType(uint8_t canDeviceType){
     if(canDeviceType == CanDeviceType::CONTROLLER) { return CONTROLLER_MAIN_TIMER_STATUS; }
     if(canDeviceType == CanDeviceType::MODULE) { return MODULE_MAIN_TIMER_STATUS; }
     if(canDeviceType == CanDeviceType::PERIPHERAL) { return PERIPHERAL_MAIN_TIMER_STATUS; }
@@ -501,7 +1462,7 @@ class Gm7CanProtocol {
     return 0;
   };
 
-  uint16_t getPmidValidationTimerForDeviceType(uint8_t canDeviceType){
+  static uint16_t getPmidValidationTimerForDeviceType(uint8_t canDeviceType){
     if(canDeviceType == CanDeviceType::CONTROLLER) { return CONTROLLER_VALIDATION_TIMER_STATUS; }
     if(canDeviceType == CanDeviceType::MODULE) { return MODULE_VALIDATION_TIMER_STATUS; }
     if(canDeviceType == CanDeviceType::PERIPHERAL) { return PERIPHERAL_VALIDATION_TIMER_STATUS; }
@@ -509,7 +1470,7 @@ class Gm7CanProtocol {
     return 0;
   };
 
-  uint16_t getPmidInternalTimerForDeviceType(uint8_t canDeviceType){
+  static uint16_t getPmidInternalTimerForDeviceType(uint8_t canDeviceType){
     if(canDeviceType == CanDeviceType::CONTROLLER) { return CONTROLLER_INTERNAL_TIMER_STATUS; }
     if(canDeviceType == CanDeviceType::MODULE) { return MODULE_INTERNAL_TIMER_STATUS; }
     if(canDeviceType == CanDeviceType::PERIPHERAL) { return PERIPHERAL_INTERNAL_TIMER_STATUS; }
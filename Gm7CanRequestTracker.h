@@ -0,0 +1,217 @@
+/*
+  Gm7CanRequestTracker.h - Keeps track of requests that are waiting for a RESPONSE_ACK, and retries them when they time out.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanRequestTracker_h
+#define Gm7CanRequestTracker_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_REQUEST_TRACKER_PENDING
+  #define CAN_REQUEST_TRACKER_PENDING 32
+#endif
+
+class Gm7CanRequestTracker {
+  //Every request sent through the tracker gets a sequence number (1-255, skipping numbers that are still pending) and an entry in a fixed size pending table,
+  //together with a copy of its payload and a deadline. A matching RESPONSE_ACK completes the entry.
+  //When the deadline passes, poll() returns the same frame again and the timeout doubles (timeout, 2x, 4x, ... up to 2^31 - 1 millis),
+  //until maxAttempts frames were sent without a response; then the request completes as timed out.
+  //The callback is called exactly once per request: with acked true and the result of the ack, or with acked false after a timeout.
+  //Every result value (0-255) is available to the application, none is reserved for timeouts.
+  //Requests to the controller (REQUEST_CONTROLLER_STATUS_CHANGE) are not addressed; the first controller that acks completes them.
+    public:
+        typedef void (*CompletionCallback)(uint16_t targetUid, uint16_t pmid, uint8_t sequence, bool acked, uint8_t result);
+
+    private:
+      struct Pending{
+        bool used;
+        uint16_t pmid;
+        uint16_t targetUid;
+        uint8_t sequence;
+        uint8_t attempts;
+        uint32_t deadlineMillis;
+        char payload[CAN_PAYLOAD_MESSAGE_BYTES];
+      };
+
+      static const uint32_t MAX_TIMEOUT_MILLIS = 0x7FFFFFFF;
+
+      uint16_t ownUid;
+      uint32_t timeoutMillis;
+      uint8_t maxAttempts;
+      uint8_t lastSequence = 0;
+      CompletionCallback callback = 0;
+      Pending pending[CAN_REQUEST_TRACKER_PENDING];
+
+      bool isSequencePending(uint8_t sequence){
+        for(uint8_t i = 0; i < CAN_REQUEST_TRACKER_PENDING; i++){
+          if(pending[i].used && pending[i].sequence == sequence){
+            return true;
+          }
+        }
+        return false;
+      };
+
+      //The next sequence number that is not pending, so an ack can never match the wrong request. 0 when all 255 are in use.
+      uint8_t nextSequence(){
+        uint8_t sequence = lastSequence;
+        for(uint16_t tries = 0; tries < 255; tries++){
+          if(++sequence == 0){
+            sequence = 1; //0 means no response expected
+          }
+          if(!isSequencePending(sequence)){
+            lastSequence = sequence;
+            return sequence;
+          }
+        }
+        return 0;
+      };
+
+      Pending * allocate(uint16_t pmid, uint16_t targetUid, uint32_t nowMillis){
+        for(uint8_t i = 0; i < CAN_REQUEST_TRACKER_PENDING; i++){
+          if(!pending[i].used){
+            uint8_t sequence = nextSequence();
+            if(sequence == 0){
+              return 0;
+            }
+            pending[i].used = true;
+            pending[i].pmid = pmid;
+            pending[i].targetUid = targetUid;
+            pending[i].sequence = sequence;
+            pending[i].attempts = 1;
+            pending[i].deadlineMillis = nowMillis + timeoutMillis;
+            return &pending[i];
+          }
+        }
+        return 0;
+      };
+
+      //timeout << attempts, saturated: deadlines are compared wrap-safe, which only works up to 2^31 - 1 millis ahead
+      uint32_t getBackoffMillis(uint8_t attempts){
+        uint32_t backoff = timeoutMillis;
+        for(uint8_t i = 0; i < attempts && backoff != MAX_TIMEOUT_MILLIS; i++){
+          backoff = backoff > MAX_TIMEOUT_MILLIS / 2 ? MAX_TIMEOUT_MILLIS : backoff * 2;
+        }
+        return backoff;
+      };
+
+      void complete(Pending & entry, bool acked, uint8_t result){
+        entry.used = false;
+        if(callback != 0){
+          callback(entry.targetUid, entry.pmid, entry.sequence, acked, result);
+        }
+      };
+
+    public:
+        Gm7CanRequestTracker(uint16_t ownDeviceUid, uint32_t responseTimeoutMillis = 50, uint8_t maxSendAttempts = 4){
+          ownUid = ownDeviceUid;
+          timeoutMillis = responseTimeoutMillis > MAX_TIMEOUT_MILLIS ? MAX_TIMEOUT_MILLIS : responseTimeoutMillis;
+          maxAttempts = maxSendAttempts;
+          memset(pending, 0, sizeof(pending));
+        };
+
+        void setCallback(CompletionCallback completionCallback){
+          callback = completionCallback;
+        };
+
+        //The send*() methods fill buffer with the frame to send with PMID pmid. They return false when the pending table is full
+        //or every sequence number is pending.
+        bool sendStatusChange(uint16_t targetUid, uint32_t status, uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          if(bufferCount < CAN_PAYLOAD_MESSAGE_BYTES){
+            return false;
+          }
+          Pending * entry = allocate(Gm7CanProtocol::REQUEST_STATUS_CHANGE, targetUid, nowMillis);
+          if(entry == 0){
+            return false;
+          }
+          Gm7CanProtocol::encodeStatusChangeRequest(entry->payload, CAN_PAYLOAD_MESSAGE_BYTES, targetUid, status, entry->sequence);
+          memcpy(buffer, entry->payload, CAN_PAYLOAD_MESSAGE_BYTES);
+          pmid = entry->pmid;
+          return true;
+        };
+
+        bool sendProgressSet(uint16_t targetUid, uint16_t progress, uint16_t progressMax, uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          if(bufferCount < CAN_PAYLOAD_MESSAGE_BYTES){
+            return false;
+          }
+          Pending * entry = allocate(Gm7CanProtocol::REQUEST_PROGRESS_SET, targetUid, nowMillis);
+          if(entry == 0){
+            return false;
+          }
+          Gm7CanProtocol::encodeProgressSetRequest(entry->payload, CAN_PAYLOAD_MESSAGE_BYTES, targetUid, progress, progressMax, entry->sequence);
+          memcpy(buffer, entry->payload, CAN_PAYLOAD_MESSAGE_BYTES);
+          pmid = entry->pmid;
+          return true;
+        };
+
+        bool sendControllerStatusChange(uint32_t status, uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          if(bufferCount < CAN_PAYLOAD_MESSAGE_BYTES){
+            return false;
+          }
+          Pending * entry = allocate(Gm7CanProtocol::REQUEST_CONTROLLER_STATUS_CHANGE, 0, nowMillis);
+          if(entry == 0){
+            return false;
+          }
+          Gm7CanProtocol::encodeControllerStatusChangeRequest(entry->payload, CAN_PAYLOAD_MESSAGE_BYTES, status, entry->sequence);
+          memcpy(buffer, entry->payload, CAN_PAYLOAD_MESSAGE_BYTES);
+          pmid = entry->pmid;
+          return true;
+        };
+
+        //Feed every received RESPONSE_ACK. Returns true if it completed a pending request.
+        bool onAck(uint16_t responderUid, Gm7CanProtocol::Ack ack){
+          if(ack.requesterUid != ownUid || ack.sequence == 0){
+            return false;
+          }
+          for(uint8_t i = 0; i < CAN_REQUEST_TRACKER_PENDING; i++){
+            Pending & entry = pending[i];
+            if(entry.used && entry.sequence == ack.sequence && entry.pmid == ack.requestPmid
+              && (entry.targetUid == responderUid || entry.pmid == Gm7CanProtocol::REQUEST_CONTROLLER_STATUS_CHANGE)){
+              complete(entry, true, ack.result);
+              return true;
+            }
+          }
+          return false;
+        };
+
+        //Call every loop. Returns true and fills pmid and buffer when a request has to be sent again; call again until it returns false.
+        //Requests that ran out of attempts are completed as timed out from here. A buffer shorter than 8 bytes returns false
+        //and leaves every request pending.
+        bool poll(uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          if(bufferCount < CAN_PAYLOAD_MESSAGE_BYTES){
+            return false;
+          }
+          for(uint8_t i = 0; i < CAN_REQUEST_TRACKER_PENDING; i++){
+            Pending & entry = pending[i];
+            if(!entry.used || (int32_t)(nowMillis - entry.deadlineMillis) < 0){
+              continue;
+            }
+            if(entry.attempts >= maxAttempts){
+              complete(entry, false, 0);
+              continue;
+            }
+            entry.deadlineMillis = nowMillis + getBackoffMillis(entry.attempts);
+            entry.attempts++;
+            memcpy(buffer, entry.payload, CAN_PAYLOAD_MESSAGE_BYTES);
+            pmid = entry.pmid;
+            return true;
+          }
+          return false;
+        };
+
+        uint8_t getPendingCount(){
+          uint8_t count = 0;
+          for(uint8_t i = 0; i < CAN_REQUEST_TRACKER_PENDING; i++){
+            if(pending[i].used){
+              count++;
+            }
+          }
+          return count;
+        };
+
+};
+
+#endif
@@ -0,0 +1,245 @@
+/*
+  Gm7CanScheduler.h - One place for all periodic protocol traffic (heartbeats, device updates, status and timer frames) and one-shot jobs,
+                      instead of a millis() comparison per frame type in the loop.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanScheduler_h
+#define Gm7CanScheduler_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_SCHEDULER_JOBS
+  #define CAN_SCHEDULER_JOBS 8 //Max 254, about 36 bytes each
+#endif
+
+class Gm7CanScheduler {
+  //Jobs are kept in a min-heap on their deadline, so run() only looks at the jobs that are due and getNextDeadline() is a single read.
+  //Periodic jobs are rescheduled from their previous deadline, not from the time they ran, so they do not drift. Give jobs with the same
+  //period different phase offsets to spread them out instead of sending them in one burst.
+  //When a periodic job falls a whole period or more behind (a blocking loop), the missed runs are skipped and counted instead of
+  //being run back to back. Lateness (the time between the deadline and the run) is tracked per job.
+  //Call run() every loop; the time until the next deadline can be spent sleeping. Callbacks may add and cancel jobs, also their own.
+  //Job ids are reused after a one-shot job ran or a job was cancelled, so do not keep them around after that.
+    public:
+        static const uint8_t JOB_NONE = 0xFF;
+
+        typedef void (*JobCallback)(uint8_t job, uint32_t nowMillis, void * context);
+
+        struct JobStats{
+          uint32_t runs;
+          uint32_t missedRuns;          //Periods that were skipped because the job was too late
+          uint32_t maxLatenessMillis;
+          uint32_t totalLatenessMillis; //Divide by runs for the average
+        };
+
+    private:
+      struct Job{
+        bool used;
+        uint8_t heapIndex;
+        uint32_t deadlineMillis;
+        uint32_t periodMillis;  //0 for one-shot jobs
+        JobCallback callback;
+        void * context;
+        JobStats stats;
+      };
+
+      Job jobs[CAN_SCHEDULER_JOBS];
+      uint8_t heap[CAN_SCHEDULER_JOBS];
+      uint8_t heapSize = 0;
+
+      bool isBefore(uint8_t a, uint8_t b){
+        return (int32_t)(jobs[heap[a]].deadlineMillis - jobs[heap[b]].deadlineMillis) < 0; //Survives the millis() overflow
+      };
+
+      void swap(uint8_t a, uint8_t b){
+        uint8_t job = heap[a];
+        heap[a] = heap[b];
+        heap[b] = job;
+        jobs[heap[a]].heapIndex = a;
+        jobs[heap[b]].heapIndex = b;
+      };
+
+      void siftUp(uint8_t index){
+        while(index > 0 && isBefore(index, (index - 1) / 2)){
+          swap(index, (index - 1) / 2);
+          index = (index - 1) / 2;
+        }
+      };
+
+      void siftDown(uint8_t index){
+        while(true){
+          uint8_t first = index;
+          uint8_t left = (2 * index) + 1;
+          uint8_t right = left + 1;
+          if(left < heapSize && isBefore(left, first)){
+            first = left;
+          }
+          if(right < heapSize && isBefore(right, first)){
+            first = right;
+          }
+          if(first == index){
+            return;
+          }
+          swap(index, first);
+          index = first;
+        }
+      };
+
+      void removeFromHeap(uint8_t index){
+        heapSize--;
+        if(index == heapSize){
+          return;
+        }
+        swap(index, heapSize);
+        siftDown(index);
+        siftUp(index);
+      };
+
+      uint8_t addJob(uint32_t deadlineMillis, uint32_t periodMillis, JobCallback callback, void * context){
+        if(callback == 0){
+          return JOB_NONE;
+        }
+        for(uint8_t i = 0; i < CAN_SCHEDULER_JOBS; i++){
+          if(!jobs[i].used){
+            memset(&jobs[i], 0, sizeof(Job));
+            jobs[i].used = true;
+            jobs[i].deadlineMillis = deadlineMillis;
+            jobs[i].periodMillis = periodMillis;
+            jobs[i].callback = callback;
+            jobs[i].context = context;
+            jobs[i].heapIndex = heapSize;
+            heap[heapSize] = i;
+            heapSize++;
+            siftUp(heapSize - 1);
+            return i;
+          }
+        }
+        return JOB_NONE;
+      };
+
+    public:
+        Gm7CanScheduler(){
+          memset(jobs, 0, sizeof(jobs));
+        };
+
+        //First run at nowMillis + phaseMillis, then every periodMillis. Returns JOB_NONE when all jobs are in use.
+        uint8_t addPeriodic(uint32_t nowMillis, uint32_t periodMillis, JobCallback callback, void * context = 0, uint32_t phaseMillis = 0){
+          if(periodMillis == 0){
+            return JOB_NONE;
+          }
+          return addJob(nowMillis + phaseMillis, periodMillis, callback, context);
+        };
+
+        uint8_t addOnce(uint32_t nowMillis, uint32_t delayMillis, JobCallback callback, void * context = 0){
+          return addJob(nowMillis + delayMillis, 0, callback, context);
+        };
+
+        //Heartbeats at the interval of the protocol instance. Call setPeriod() when the interval changes (followHeartbeatTiming()).
+        uint8_t addHeartbeat(Gm7CanProtocol & protocol, uint32_t nowMillis, JobCallback callback, void * context = 0, uint32_t phaseMillis = 0){
+          return addPeriodic(nowMillis, protocol.getHeartbeatIntervalRateInMillis(), callback, context, phaseMillis);
+        };
+
+        //Device info updates at the (randomized) device update interval of the protocol instance
+        uint8_t addDeviceUpdate(Gm7CanProtocol & protocol, uint32_t nowMillis, JobCallback callback, void * context = 0, uint32_t phaseMillis = 0){
+          return addPeriodic(nowMillis, protocol.getDeviceUpdateIntervalRateInMillis(), callback, context, phaseMillis);
+        };
+
+        bool cancel(uint8_t job){
+          if(job >= CAN_SCHEDULER_JOBS || !jobs[job].used){
+            return false;
+          }
+          removeFromHeap(jobs[job].heapIndex);
+          jobs[job].used = false;
+          return true;
+        };
+
+        //Takes effect after the next run of the job
+        bool setPeriod(uint8_t job, uint32_t periodMillis){
+          if(job >= CAN_SCHEDULER_JOBS || !jobs[job].used || jobs[job].periodMillis == 0 || periodMillis == 0){
+            return false;
+          }
+          jobs[job].periodMillis = periodMillis;
+          return true;
+        };
+
+        //Moves the next run of a job, for example to send a heartbeat early
+        bool reschedule(uint8_t job, uint32_t deadlineMillis){
+          if(job >= CAN_SCHEDULER_JOBS || !jobs[job].used){
+            return false;
+          }
+          jobs[job].deadlineMillis = deadlineMillis;
+          siftDown(jobs[job].heapIndex);
+          siftUp(jobs[job].heapIndex);
+          return true;
+        };
+
+        //Runs every job that is due and returns how many ran
+        uint8_t run(uint32_t nowMillis){
+          uint8_t ran = 0;
+          while(heapSize > 0 && (int32_t)(nowMillis - jobs[heap[0]].deadlineMillis) >= 0 && ran < CAN_SCHEDULER_JOBS){
+            uint8_t job = heap[0];
+            Job & current = jobs[job];
+            uint32_t lateness = nowMillis - current.deadlineMillis;
+            current.stats.runs++;
+            current.stats.totalLatenessMillis += lateness;
+            if(lateness > current.stats.maxLatenessMillis){
+              current.stats.maxLatenessMillis = lateness;
+            }
+            JobCallback callback = current.callback;
+            void * context = current.context;
+            if(current.periodMillis == 0){
+              removeFromHeap(0);
+              current.used = false;
+            } else {
+              uint32_t missed = lateness / current.periodMillis;
+              current.stats.missedRuns += missed;
+              current.deadlineMillis += (missed + 1) * current.periodMillis;
+              siftDown(0);
+            }
+            ran++;
+            callback(job, nowMillis, context);
+          }
+          return ran;
+        };
+
+        //Returns false when there are no jobs
+        bool getNextDeadline(uint32_t & deadlineMillis){
+          if(heapSize == 0){
+            return false;
+          }
+          deadlineMillis = jobs[heap[0]].deadlineMillis;
+          return true;
+        };
+
+        //0 when a job is due, 0xFFFFFFFF when there are no jobs
+        uint32_t getMillisUntilNext(uint32_t nowMillis){
+          uint32_t deadlineMillis;
+          if(!getNextDeadline(deadlineMillis)){
+            return 0xFFFFFFFF;
+          }
+          int32_t left = deadlineMillis - nowMillis;
+          return left > 0 ? left : 0;
+        };
+
+        JobStats getStats(uint8_t job){
+          JobStats empty = {0, 0, 0, 0};
+          return job < CAN_SCHEDULER_JOBS && jobs[job].used ? jobs[job].stats : empty;
+        };
+
+        void resetStats(uint8_t job){
+          if(job < CAN_SCHEDULER_JOBS){
+            memset(&jobs[job].stats, 0, sizeof(JobStats));
+          }
+        };
+
+        uint8_t getJobCount(){
+          return heapSize;
+        };
+
+};
+
+#endif
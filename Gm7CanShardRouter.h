@@ -0,0 +1,154 @@
+/*
+  Gm7CanShardRouter.h - Spreading received frames over several consumers (worker threads on a host), by UID.
+                        Frames of one UID always go to the same consumer, in the order they were received.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanShardRouter_h
+#define Gm7CanShardRouter_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_FRAME_QUEUE_SIZE
+  #define CAN_FRAME_QUEUE_SIZE 32 //Must be a power of 2, max 128
+#endif
+
+#ifndef CAN_SHARD_COUNT
+  #define CAN_SHARD_COUNT 4 //One per worker
+#endif
+
+class Gm7CanFrameQueue {
+  //Single producer, single consumer FIFO of CanFrames, without locks.
+  //The producer only writes head and the consumer only writes tail. Both are single bytes, so they are also read and written
+  //atomically on AVR; an interrupt can push while the main loop pops.
+  //On other targets head and tail each get their own cache line, so a push on one core and a pop on another do not keep
+  //moving one line back and forth.
+    private:
+      static_assert(CAN_FRAME_QUEUE_SIZE >= 1 && CAN_FRAME_QUEUE_SIZE <= 128 && (CAN_FRAME_QUEUE_SIZE & (CAN_FRAME_QUEUE_SIZE - 1)) == 0,
+        "CAN_FRAME_QUEUE_SIZE must be a power of 2, at most 128 so the 8-bit head and tail can tell a full queue from an empty one");
+
+      Gm7CanProtocol::CanFrame frames[CAN_FRAME_QUEUE_SIZE];
+      GM7_CAN_CACHE_LINE_ALIGNMENT volatile uint8_t head = 0; //Frames pushed so far (wraps)
+      GM7_CAN_CACHE_LINE_ALIGNMENT volatile uint8_t tail = 0; //Frames popped so far (wraps)
+
+    public:
+        //Producer side. Returns false when the queue is full; the frame is not queued.
+        bool push(const Gm7CanProtocol::CanFrame & frame){
+          uint8_t position = head;
+          if((uint8_t)(position - tail) >= CAN_FRAME_QUEUE_SIZE){
+            return false;
+          }
+          frames[position & (CAN_FRAME_QUEUE_SIZE - 1)] = frame;
+          GM7_CAN_MEMORY_BARRIER();
+          head = position + 1;
+          return true;
+        };
+
+        //Consumer side. Returns false when the queue is empty.
+        bool pop(Gm7CanProtocol::CanFrame & frame){
+          uint8_t position = tail;
+          if(position == head){
+            return false;
+          }
+          GM7_CAN_MEMORY_BARRIER();
+          frame = frames[position & (CAN_FRAME_QUEUE_SIZE - 1)];
+          GM7_CAN_MEMORY_BARRIER();
+          tail = position + 1;
+          return true;
+        };
+
+        //Safe from both sides; the result may be outdated by the time it is used
+        uint8_t size(){
+          return head - tail;
+        };
+
+        bool isEmpty(){
+          return head == tail;
+        };
+
+};
+
+class Gm7CanShardRouter {
+  //The producer (the thread reading the bus) calls route() for every frame. The UID picks one of CAN_SHARD_COUNT queues,
+  //and each consumer (worker) drains its own queue with pop(). Since a UID always maps to the same queue, and every queue is a FIFO,
+  //the frames of a device are processed in bus order by one worker, so per-device state needs no locking.
+  //Devices are spread over the shards by a hash of the UID; sequential UID's end up on different shards.
+  //Backpressure: route() returns false when the shard of the frame is full. The producer can wait and retry the same frame
+  //(keeping the order) or drop it; dropped frames are counted per shard. isBackpressured() warns earlier, at 3/4 full.
+  //With several buses, use one router per bus reader thread and let every worker pop its shard from each router:
+  //a UID is only on one bus, so its order is still kept.
+  //Each shard (queue and statistics) starts on its own cache line, so workers on different cores do not share lines.
+  //Allocate the router statically or as a member of such an object; before C++17, new does not honour the 64 byte alignment.
+    public:
+        struct ShardStats{
+          uint32_t routedFrames;
+          uint32_t rejectedFrames;  //route() returned false
+          uint8_t highWater;        //Highest fill seen by route()
+        };
+
+    private:
+      static_assert(CAN_SHARD_COUNT >= 1 && CAN_SHARD_COUNT <= 255, "CAN_SHARD_COUNT must be 1-255");
+
+      struct GM7_CAN_CACHE_LINE_ALIGNMENT Shard{
+        Gm7CanFrameQueue queue;
+        ShardStats stats;     //Producer side only, after the consumer's tail line
+      };
+
+      Shard shards[CAN_SHARD_COUNT];
+
+    public:
+        Gm7CanShardRouter(){
+          for(uint8_t i = 0; i < CAN_SHARD_COUNT; i++){
+            memset(&shards[i].stats, 0, sizeof(ShardStats));
+          }
+        };
+
+        static uint8_t getShard(uint16_t uid){
+          return (uint8_t)(((uint16_t)(uid * 40503u)) >> 8) % CAN_SHARD_COUNT; //Fibonacci hashing
+        };
+
+        //Producer side
+        bool route(const Gm7CanProtocol::CanFrame & frame){
+          uint8_t shard = getShard(frame.getUid());
+          ShardStats & shardStats = shards[shard].stats;
+          if(!shards[shard].queue.push(frame)){
+            shardStats.rejectedFrames++;
+            return false;
+          }
+          shardStats.routedFrames++;
+          uint8_t fill = shards[shard].queue.size();
+          if(fill > shardStats.highWater){
+            shardStats.highWater = fill;
+          }
+          return true;
+        };
+
+        bool route(uint32_t canMessageId, const char * payload, uint8_t length){
+          return route(Gm7CanProtocol::createFrameFromBuffer(canMessageId, payload, length));
+        };
+
+        //Consumer side, only from the worker that owns the shard
+        bool pop(uint8_t shard, Gm7CanProtocol::CanFrame & frame){
+          return shard < CAN_SHARD_COUNT && shards[shard].queue.pop(frame);
+        };
+
+        bool isBackpressured(uint8_t shard){
+          return shard < CAN_SHARD_COUNT && shards[shard].queue.size() >= (CAN_FRAME_QUEUE_SIZE * 3) / 4;
+        };
+
+        uint8_t getShardFill(uint8_t shard){
+          return shard < CAN_SHARD_COUNT ? shards[shard].queue.size() : 0;
+        };
+
+        //Written by the producer; read it from the producer side or accept slightly outdated values
+        ShardStats getShardStats(uint8_t shard){
+          ShardStats empty = {0, 0, 0};
+          return shard < CAN_SHARD_COUNT ? shards[shard].stats : empty;
+        };
+
+};
+
+#endif
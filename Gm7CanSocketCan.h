@@ -0,0 +1,340 @@
+/*
+  Gm7CanSocketCan.h - Gateway from Linux SocketCAN buses to typed GM7 CAN events, for a controller, logger or bridge running on a host.
+                      Every bus is a non-blocking CAN_RAW socket in one epoll set. Frames are read in batches with recvmmsg,
+                      stamped with the hardware or kernel receive time, decoded with Gm7CanProtocol::decodeEvent and handed to a
+                      callback, and to a Gm7CanFrameRing when one is set so any amount of other consumers can read them too.
+                      Linux only; on the boards this header is empty. extras/Gm7CanGateway is a daemon built on it.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanSocketCan_h
+#define Gm7CanSocketCan_h
+
+#if defined(__linux__)
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+#include "Gm7CanFrameRing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+
+#ifndef CAN_SOCKETCAN_BUSES
+  #define CAN_SOCKETCAN_BUSES 4
+#endif
+
+#ifndef CAN_SOCKETCAN_BATCH
+  #define CAN_SOCKETCAN_BATCH 64 //Frames read with one recvmmsg call
+#endif
+
+class Gm7CanSocketCanGateway {
+  //A bus at 1 Mbit/s carries at most about 15000 extended frames a second, 7500 when they all have 8 bytes of payload.
+  //Reading those with one recv() each would cost a system call per frame. recvmmsg reads up to CAN_SOCKETCAN_BATCH frames
+  //per call and decodeEvent is a handful of compares, so a single core keeps up with several buses at line rate.
+  //Frames that arrive faster than they are read wait in the socket receive buffer, which is enlarged to RECEIVE_BUFFER_BYTES.
+  //Frames the kernel still had to drop are counted in BusStats.kernelDrops instead of disappearing silently.
+  //Timestamps are in nanoseconds: the raw hardware time of the CAN controller when the driver provides it, otherwise the
+  //kernel receive time (CLOCK_REALTIME). Sockets without either, like the socketpairs of the tests, get the time they were read.
+  //The ring does not record the bus a frame came from; use the callback, or a gateway per bus, when that matters.
+
+    public:
+        typedef void (*EventCallback)(uint8_t bus, const Gm7CanProtocol::Event & event, const Gm7CanProtocol::CanFrame & frame, uint64_t timestampNanos, void * context);
+
+        static const uint8_t TIMESTAMP_READ = 0;      //The time the frame was read from the socket
+        static const uint8_t TIMESTAMP_KERNEL = 1;
+        static const uint8_t TIMESTAMP_HARDWARE = 2;
+
+        static const int RECEIVE_BUFFER_BYTES = 1 << 20;
+
+        struct BusStats{
+          uint32_t frames;        //Frames handed to the callback and the ring
+          uint32_t batches;       //recvmmsg calls that returned frames
+          uint32_t skipped;       //Standard, error and malformed frames; GM7 only uses extended ID's
+          uint32_t kernelDrops;   //Frames dropped by the kernel because the receive buffer was full
+          uint32_t readErrors;
+          uint8_t timestamping;   //TIMESTAMP_* of the last frame
+        };
+
+    private:
+      static const size_t CONTROL_BYTES = CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(uint32_t));
+
+      struct Bus{
+        int fd;
+        uint32_t dropCount;     //Last value of the SO_RXQ_OVFL counter, which counts from the moment the socket was opened
+        BusStats stats;
+      };
+
+      int epollFd;
+      uint8_t busCount = 0;
+      Bus buses[CAN_SOCKETCAN_BUSES];
+      EventCallback callback = 0;
+      void * callbackContext = 0;
+      Gm7CanFrameRing * ring = 0;
+
+      struct can_frame frames[CAN_SOCKETCAN_BATCH];
+      struct iovec vectors[CAN_SOCKETCAN_BATCH];
+      struct mmsghdr messages[CAN_SOCKETCAN_BATCH];
+      alignas(struct cmsghdr) char control[CAN_SOCKETCAN_BATCH][CONTROL_BYTES];
+
+      static uint64_t toNanos(const struct timespec & time){
+        return ((uint64_t)time.tv_sec * 1000000000ULL) + time.tv_nsec;
+      };
+
+      static uint64_t getReadNanos(){
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        return toNanos(now);
+      };
+
+      //Takes the receive time and the kernel drop counter from the control messages of one frame, returns 0 without a timestamp
+      uint64_t parseControl(struct msghdr & header, Bus & bus){
+        uint64_t nanos = 0;
+        for(struct cmsghdr * message = CMSG_FIRSTHDR(&header); message != 0; message = CMSG_NXTHDR(&header, message)){
+          if(message->cmsg_level != SOL_SOCKET){
+            continue;
+          }
+          if(message->cmsg_type == SO_TIMESTAMPING){
+            struct scm_timestamping stamps;
+            memcpy(&stamps, CMSG_DATA(message), sizeof(stamps));
+            if(stamps.ts[2].tv_sec != 0 || stamps.ts[2].tv_nsec != 0){
+              nanos = toNanos(stamps.ts[2]);
+              bus.stats.timestamping = TIMESTAMP_HARDWARE;
+            } else if(stamps.ts[0].tv_sec != 0 || stamps.ts[0].tv_nsec != 0){
+              nanos = toNanos(stamps.ts[0]);
+              bus.stats.timestamping = TIMESTAMP_KERNEL;
+            }
+          } else if(message->cmsg_type == SO_TIMESTAMPNS){
+            struct timespec stamp;
+            memcpy(&stamp, CMSG_DATA(message), sizeof(stamp));
+            nanos = toNanos(stamp);
+            bus.stats.timestamping = TIMESTAMP_KERNEL;
+          } else if(message->cmsg_type == SO_RXQ_OVFL){
+            uint32_t dropCount;
+            memcpy(&dropCount, CMSG_DATA(message), sizeof(dropCount));
+            bus.stats.kernelDrops += dropCount - bus.dropCount;
+            bus.dropCount = dropCount;
+          }
+        }
+        return nanos;
+      };
+
+      //Reads until the socket is empty, returns the amount of frames handed on
+      uint32_t readBus(uint8_t busIndex){
+        Bus & bus = buses[busIndex];
+        uint32_t handled = 0;
+        while(true){
+          for(uint8_t i = 0; i < CAN_SOCKETCAN_BATCH; i++){
+            messages[i].msg_hdr.msg_controllen = CONTROL_BYTES; //The kernel sets it to what it used
+            messages[i].msg_hdr.msg_flags = 0;
+          }
+          int received = recvmmsg(bus.fd, messages, CAN_SOCKETCAN_BATCH, MSG_DONTWAIT, 0);
+          if(received < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+              bus.stats.readErrors++;
+            }
+            return handled;
+          }
+          if(received == 0){
+            return handled;
+          }
+          bus.stats.batches++;
+          uint64_t readNanos = 0;
+          for(int i = 0; i < received; i++){
+            const struct can_frame & raw = frames[i];
+            uint64_t nanos = parseControl(messages[i].msg_hdr, bus);
+            if(messages[i].msg_len != sizeof(struct can_frame) || (messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+              || (raw.can_id & (CAN_EFF_FLAG | CAN_ERR_FLAG)) != CAN_EFF_FLAG){
+              bus.stats.skipped++;
+              continue;
+            }
+            if(nanos == 0){
+              if(readNanos == 0){
+                readNanos = getReadNanos(); //Once per batch, they were all waiting already
+              }
+              nanos = readNanos;
+              bus.stats.timestamping = TIMESTAMP_READ;
+            }
+            Gm7CanProtocol::CanFrame frame = Gm7CanProtocol::createFrameFromBuffer(raw.can_id & CAN_EFF_MASK, (const char *)raw.data, raw.can_dlc);
+            if(raw.can_id & CAN_RTR_FLAG){
+              frame.flags |= Gm7CanProtocol::CAN_FRAME_FLAG_REMOTE;
+            }
+            if(callback != 0){
+              callback(busIndex, Gm7CanProtocol::decodeEvent(frame), frame, nanos, callbackContext);
+            }
+            if(ring != 0){
+              ring->publish(frame, (uint32_t)(nanos / 1000000));
+            }
+            bus.stats.frames++;
+            handled++;
+          }
+          if(received < CAN_SOCKETCAN_BATCH){
+            return handled; //A short batch means the socket was empty
+          }
+        }
+      };
+
+    public:
+        Gm7CanSocketCanGateway(){
+          epollFd = epoll_create1(EPOLL_CLOEXEC);
+          memset(messages, 0, sizeof(messages));
+          for(uint8_t i = 0; i < CAN_SOCKETCAN_BATCH; i++){
+            vectors[i].iov_base = &frames[i];
+            vectors[i].iov_len = sizeof(struct can_frame);
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_control = control[i];
+          }
+        };
+
+        ~Gm7CanSocketCanGateway(){
+          for(uint8_t i = 0; i < busCount; i++){
+            ::close(buses[i].fd);
+          }
+          if(epollFd >= 0){
+            ::close(epollFd);
+          }
+        };
+
+        Gm7CanSocketCanGateway(const Gm7CanSocketCanGateway &) = delete; //It owns the sockets
+        Gm7CanSocketCanGateway & operator=(const Gm7CanSocketCanGateway &) = delete;
+
+        //Opens a CAN_RAW socket on a SocketCAN interface, like "can0" or "vcan0", and adds it.
+        //Returns the bus number, -1 when it failed (errno tells why).
+        int8_t openBus(const char * interfaceName){
+          if(busCount >= CAN_SOCKETCAN_BUSES){
+            errno = ENOSPC;
+            return -1;
+          }
+          struct sockaddr_can address;
+          memset(&address, 0, sizeof(address));
+          address.can_family = AF_CAN;
+          address.can_ifindex = if_nametoindex(interfaceName);
+          if(address.can_ifindex == 0){
+            return -1;
+          }
+          int fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+          if(fd < 0){
+            return -1;
+          }
+          struct can_filter filter = {CAN_EFF_FLAG, CAN_EFF_FLAG}; //Only extended frames, so the kernel drops the rest for us
+          if(setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) < 0
+            || bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0){
+            int error = errno;
+            ::close(fd);
+            errno = error;
+            return -1;
+          }
+          //Ask the driver for hardware receive timestamps. That needs CAP_NET_ADMIN and a driver that has them,
+          //without either the kernel timestamps are used.
+          struct hwtstamp_config config;
+          memset(&config, 0, sizeof(config));
+          config.tx_type = HWTSTAMP_TX_OFF;
+          config.rx_filter = HWTSTAMP_FILTER_ALL;
+          struct ifreq request;
+          memset(&request, 0, sizeof(request));
+          strncpy(request.ifr_name, interfaceName, IFNAMSIZ - 1);
+          request.ifr_data = (char *)&config;
+          ioctl(fd, SIOCSHWTSTAMP, &request);
+          int8_t bus = addSocket(fd);
+          if(bus < 0){
+            int error = errno;
+            ::close(fd);
+            errno = error;
+          }
+          return bus;
+        };
+
+        //Adds a socket that is already open and receives struct can_frame datagrams: a CAN_RAW socket opened elsewhere,
+        //or one end of a socketpair. On success the gateway owns the socket. Returns the bus number, -1 when it failed.
+        int8_t addSocket(int fd){
+          if(epollFd < 0 || busCount >= CAN_SOCKETCAN_BUSES){
+            errno = epollFd < 0 ? EBADF : ENOSPC;
+            return -1;
+          }
+          int flags = fcntl(fd, F_GETFL);
+          if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0){
+            return -1;
+          }
+          //All optional: without them there are less frames buffered, no drop count or only the read time
+          int receiveBufferBytes = RECEIVE_BUFFER_BYTES;
+          setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferBytes, sizeof(receiveBufferBytes));
+          int enable = 1;
+          setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+          int timestamping = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+          if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &timestamping, sizeof(timestamping)) < 0){
+            setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+          }
+          struct epoll_event event;
+          memset(&event, 0, sizeof(event));
+          event.events = EPOLLIN;
+          event.data.u32 = busCount;
+          if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0){
+            return -1;
+          }
+          Bus & bus = buses[busCount];
+          bus.fd = fd;
+          bus.dropCount = 0;
+          memset(&bus.stats, 0, sizeof(bus.stats));
+          return busCount++;
+        };
+
+        void setCallback(EventCallback eventCallback, void * context = 0){
+          callback = eventCallback;
+          callbackContext = context;
+        };
+
+        //Every frame is published to the ring as well, with the timestamp in millis. 0 stops publishing.
+        void setRing(Gm7CanFrameRing * frameRing){
+          ring = frameRing;
+        };
+
+        //Waits up to timeoutMillis (-1 for ever, 0 not at all) for frames on any bus and handles all frames that are waiting.
+        //Returns the amount of frames handled, -1 when waiting failed for another reason than a signal.
+        int32_t poll(int timeoutMillis){
+          struct epoll_event events[CAN_SOCKETCAN_BUSES];
+          int ready = epoll_wait(epollFd, events, CAN_SOCKETCAN_BUSES, timeoutMillis);
+          if(ready < 0){
+            return errno == EINTR ? 0 : -1;
+          }
+          int32_t handled = 0;
+          for(int i = 0; i < ready; i++){
+            uint8_t bus = events[i].data.u32;
+            handled += readBus(bus);
+            if(events[i].events & EPOLLHUP){
+              epoll_ctl(epollFd, EPOLL_CTL_DEL, buses[bus].fd, 0); //The other end is gone, stop waking up for it
+            }
+          }
+          return handled;
+        };
+
+        uint8_t getBusCount(){
+          return busCount;
+        };
+
+        BusStats getStats(uint8_t bus){
+          if(bus >= busCount){
+            BusStats empty;
+            memset(&empty, 0, sizeof(empty));
+            return empty;
+          }
+          return buses[bus].stats;
+        };
+
+};
+
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+/*
+  Gm7CanStateCache.h - The last received status, timers and tries of every device, in one place.
+                       Written by the receiver, read by any number of readers (dashboards, game logic) without locks.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanStateCache_h
+#define Gm7CanStateCache_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_STATE_CACHE_NODES
+  #define CAN_STATE_CACHE_NODES 16 //Power of 2, about 120 bytes each
+#endif
+
+class Gm7CanStateCache {
+  //Every device gets an entry (found by UID in an open addressed table) with one slot per kind of state:
+  //the STATUS_AND_PROGRESS, MAIN_TIMER_STATUS, VALIDATION_TIMER_STATUS, INTERNAL_TIMER_STATUS and TRIES frames of its device section.
+  //A slot keeps the last payload, when it was received and how often it changed. Readers poll getChangeCount() and only
+  //read the slot again when the count moved.
+  //Slots are protected by a sequence lock: the writer makes the sequence odd while it writes and even again when done.
+  //Readers copy the slot and retry when the sequence was odd or changed during the copy, so they never see half a write
+  //and never block the writer. There must be a single writer (the thread or interrupt that calls update()).
+    public:
+        enum StateKind : uint8_t {
+          STATE_STATUS_AND_PROGRESS = 0,
+          STATE_MAIN_TIMER = 1,
+          STATE_VALIDATION_TIMER = 2,
+          STATE_INTERNAL_TIMER = 3,
+          STATE_TRIES = 4,
+          STATE_KIND_COUNT = 5
+        };
+
+        struct Value{
+          uint16_t pmid;
+          uint8_t length;
+          uint32_t changes;         //Times the payload changed, 0 if nothing was received yet
+          uint32_t updatedMillis;   //Last time a frame was received, also when it did not change
+          char payload[CAN_PAYLOAD_MESSAGE_BYTES];
+        };
+
+    private:
+      static_assert(CAN_STATE_CACHE_NODES >= 1 && CAN_STATE_CACHE_NODES <= 0x8000 && (CAN_STATE_CACHE_NODES & (CAN_STATE_CACHE_NODES - 1)) == 0,
+        "CAN_STATE_CACHE_NODES must be a power of 2, at most 32768");
+
+#if defined(__AVR__)
+      typedef uint8_t Sequence;   //Single byte, so it is read atomically. A read takes microseconds, it can not miss 128 writes.
+#else
+      typedef uint32_t Sequence;
+#endif
+
+      struct Slot{
+        volatile Sequence sequence;
+        Value value;
+      };
+
+      struct Entry{
+        volatile bool used;
+        uint16_t uid;
+        Slot slots[STATE_KIND_COUNT];
+      };
+
+      Entry entries[CAN_STATE_CACHE_NODES];
+      uint32_t untrackedFrames = 0;
+
+      static uint16_t getIndex(uint16_t uid){
+        return (uint16_t)(uid * 40503u) & (CAN_STATE_CACHE_NODES - 1); //Fibonacci hashing
+      };
+
+      Entry * findEntry(uint16_t uid, bool create){
+        uint16_t index = getIndex(uid);
+        for(uint16_t i = 0; i < CAN_STATE_CACHE_NODES; i++){
+          Entry & entry = entries[(index + i) & (CAN_STATE_CACHE_NODES - 1)];
+          if(!entry.used){
+            if(!create){
+              return 0;
+            }
+            memset(entry.slots, 0, sizeof(entry.slots));
+            entry.uid = uid;
+            GM7_CAN_MEMORY_BARRIER();
+            entry.used = true; //Published last, readers never see an entry without its UID
+            return &entry;
+          }
+          if(entry.uid == uid){
+            return &entry;
+          }
+        }
+        return 0;
+      };
+
+      //Returns false when the slot does not exist or was never written
+      bool readSlot(uint16_t uid, uint8_t kind, Value & value){
+        Entry * entry = kind < STATE_KIND_COUNT ? findEntry(uid, false) : 0;
+        if(entry == 0){
+          return false;
+        }
+        Slot & slot = entry->slots[kind];
+        while(true){
+          Sequence before = slot.sequence;
+          GM7_CAN_MEMORY_BARRIER();
+          if(before & 1){
+            continue; //Being written
+          }
+          value = slot.value;
+          GM7_CAN_MEMORY_BARRIER();
+          if(slot.sequence == before){
+            return value.changes != 0;
+          }
+        }
+      };
+
+    public:
+        Gm7CanStateCache(){
+          memset(entries, 0, sizeof(entries));
+        };
+
+        //The kind of state of a PMID, STATE_KIND_COUNT if it is not one of them. Only controllers and modules send tries.
+        static uint8_t getKind(uint16_t pmid){
+          if(pmid <= Gm7CanProtocol::CONTROLLER_SECTION_START || pmid >= Gm7CanProtocol::EXTERNAL_DEVICE_SECTION_END){
+            return STATE_KIND_COUNT;
+          }
+          //The device sections have the same size and layout
+          uint16_t offset = (pmid - Gm7CanProtocol::CONTROLLER_SECTION_START) % (Gm7CanProtocol::MODULE_SECTION_START - Gm7CanProtocol::CONTROLLER_SECTION_START);
+          if(offset < Gm7CanProtocol::CONTROLLER_STATUS_AND_PROGRESS - Gm7CanProtocol::CONTROLLER_SECTION_START
+            || offset > Gm7CanProtocol::CONTROLLER_TRIES - Gm7CanProtocol::CONTROLLER_SECTION_START){
+            return STATE_KIND_COUNT;
+          }
+          if(offset == Gm7CanProtocol::CONTROLLER_TRIES - Gm7CanProtocol::CONTROLLER_SECTION_START && pmid >= Gm7CanProtocol::PERIPHERAL_SECTION_START){
+            return STATE_KIND_COUNT; //Not defined for peripherals and external devices, decodeEvent() does not know it either
+          }
+          return offset - (Gm7CanProtocol::CONTROLLER_STATUS_AND_PROGRESS - Gm7CanProtocol::CONTROLLER_SECTION_START);
+        };
+
+        //Writer side. Feed every received frame; returns true when it was cached.
+        bool update(uint32_t canMessageId, const char * payload, uint8_t length, uint32_t nowMillis){
+          Gm7CanProtocol::MessageId messageId = Gm7CanProtocol::parseMessageId(canMessageId);
+          uint8_t kind = getKind(messageId.pmid);
+          if(kind == STATE_KIND_COUNT){
+            return false;
+          }
+          Entry * entry = findEntry(messageId.uid, true);
+          if(entry == 0){
+            untrackedFrames++;
+            return false;
+          }
+          if(length > CAN_PAYLOAD_MESSAGE_BYTES){
+            length = CAN_PAYLOAD_MESSAGE_BYTES;
+          }
+          Slot & slot = entry->slots[kind];
+          bool changed = slot.value.changes == 0 || slot.value.pmid != messageId.pmid || slot.value.length != length
+            || memcmp(slot.value.payload, payload, length) != 0;
+          slot.sequence = slot.sequence + 1;
+          GM7_CAN_MEMORY_BARRIER();
+          slot.value.pmid = messageId.pmid;
+          slot.value.length = length;
+          slot.value.updatedMillis = nowMillis;
+          if(changed){
+            memcpy(slot.value.payload, payload, length);
+            slot.value.changes++;
+          }
+          GM7_CAN_MEMORY_BARRIER();
+          slot.sequence = slot.sequence + 1;
+          return true;
+        };
+
+        bool update(const Gm7CanProtocol::CanFrame & frame, uint32_t nowMillis){
+          return update(frame.id, frame.data, frame.length, nowMillis);
+        };
+
+        //Reader side. All of these can be called from any thread, at any time.
+        bool get(uint16_t uid, uint8_t kind, Value & value){
+          return readSlot(uid, kind, value);
+        };
+
+        //0 until the first frame; compare with the count of the previous poll to see if something changed
+        uint32_t getChangeCount(uint16_t uid, uint8_t kind){
+          Value value;
+          return readSlot(uid, kind, value) ? value.changes : 0;
+        };
+
+        bool getStatusAndProgress(uint16_t uid, Gm7CanProtocol::StatusAndProgress & statusAndProgress){
+          Value value;
+          if(!readSlot(uid, STATE_STATUS_AND_PROGRESS, value) || value.length < 8){
+            return false;
+          }
+          statusAndProgress = Gm7CanProtocol::decodeModuleStatusAndProgress(value.payload, value.length);
+          return true;
+        };
+
+        //kind is STATE_MAIN_TIMER, STATE_VALIDATION_TIMER or STATE_INTERNAL_TIMER
+        bool getTimerStatus(uint16_t uid, uint8_t kind, Gm7CanProtocol::TimerStatus & timerStatus){
+          Value value;
+          if(kind < STATE_MAIN_TIMER || kind > STATE_INTERNAL_TIMER || !readSlot(uid, kind, value) || value.length < 8){
+            return false;
+          }
+          timerStatus = Gm7CanProtocol::decodeTimerStatus(value.payload, value.length);
+          return true;
+        };
+
+        bool getTries(uint16_t uid, Gm7CanProtocol::Tries & tries){
+          Value value;
+          if(!readSlot(uid, STATE_TRIES, value) || value.length < 8){
+            return false;
+          }
+          tries = Gm7CanProtocol::decodeTries(value.payload, value.length);
+          return true;
+        };
+
+        //Frames of devices that did not fit in the cache anymore
+        uint32_t getUntrackedFrames(){
+          return untrackedFrames;
+        };
+
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+  Gm7CanStatusPublisher.h - Rate limited sending of StatusAndProgress frames.
+                            Game code can report progress as often as it likes; only changes reach the bus, and at a bounded rate.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanStatusPublisher_h
+#define Gm7CanStatusPublisher_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_STATUS_PUBLISHER_SLOTS
+  #define CAN_STATUS_PUBLISHER_SLOTS 4 //Amount of different PMID's that can be published
+#endif
+
+class Gm7CanStatusPublisher {
+  //The publisher keeps the last sent StatusAndProgress for every PMID (MODULE_STATUS_AND_PROGRESS for example).
+  //- An update equal to what was sent last is dropped.
+  //- A progress-only update is held back until minIntervalMillis have passed since the last frame for that PMID.
+  //  Newer updates within that time replace it, so only the latest state is sent.
+  //- A change of the status word is sent at the next poll(), regardless of the interval.
+  //Call poll() every loop and send every frame it returns.
+    private:
+      struct Slot{
+        uint16_t pmid;
+        bool used;
+        bool sentOnce;
+        bool pending;
+        bool urgent;
+        uint32_t lastSentMillis;
+        Gm7CanProtocol::StatusAndProgress sent;
+        Gm7CanProtocol::StatusAndProgress next;
+      };
+
+      uint32_t minIntervalMillis;
+      Slot slots[CAN_STATUS_PUBLISHER_SLOTS];
+      uint32_t suppressedUpdates = 0;
+
+      static bool isEqual(const Gm7CanProtocol::StatusAndProgress & a, const Gm7CanProtocol::StatusAndProgress & b){
+        return a.status == b.status && a.progress == b.progress && a.progressMax == b.progressMax;
+      };
+
+    public:
+        Gm7CanStatusPublisher(uint32_t minimumIntervalMillis = 100){
+          minIntervalMillis = minimumIntervalMillis;
+          memset(slots, 0, sizeof(slots));
+        };
+
+        void setMinIntervalMillis(uint32_t millis){
+          minIntervalMillis = millis;
+        };
+
+        //Returns false if all slots are taken by other PMID's
+        bool update(uint16_t pmid, Gm7CanProtocol::StatusAndProgress statusAndProgress){
+          Slot * slot = 0;
+          for(uint8_t i = 0; i < CAN_STATUS_PUBLISHER_SLOTS; i++){
+            if(slots[i].used && slots[i].pmid == pmid){
+              slot = &slots[i];
+              break;
+            }
+            if(!slots[i].used && slot == 0){
+              slot = &slots[i];
+            }
+          }
+          if(slot == 0){
+            return false;
+          }
+          if(!slot->used){
+            slot->used = true;
+            slot->pmid = pmid;
+            slot->sentOnce = false;
+            slot->urgent = true;
+          }
+          if(slot->sentOnce && isEqual(statusAndProgress, slot->sent)){
+            if(slot->pending){
+              slot->pending = false; //Changed back before it was sent
+              slot->urgent = false;
+            }
+            suppressedUpdates++;
+            return true;
+          }
+          if(slot->pending){
+            suppressedUpdates++; //Coalesced into the pending update
+          }
+          if(!slot->sentOnce || statusAndProgress.status != slot->sent.status){
+            slot->urgent = true;
+          }
+          slot->next = statusAndProgress;
+          slot->pending = true;
+          return true;
+        };
+
+        bool update(uint16_t pmid, uint32_t status, uint16_t progress, uint16_t progressMax){
+          Gm7CanProtocol::StatusAndProgress statusAndProgress = {status, progress, progressMax};
+          return update(pmid, statusAndProgress);
+        };
+
+        //Returns true and fills pmid and buffer when a frame should be sent now. Call it again until it returns false.
+        bool poll(uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          Slot * due = 0;
+          for(uint8_t i = 0; i < CAN_STATUS_PUBLISHER_SLOTS; i++){
+            Slot & slot = slots[i];
+            if(!slot.used || !slot.pending){
+              continue;
+            }
+            if(slot.urgent){
+              due = &slot;
+              break;
+            }
+            if(due == 0 && nowMillis - slot.lastSentMillis >= minIntervalMillis){
+              due = &slot;
+            }
+          }
+          if(due == 0 || !Gm7CanProtocol::encodeModuleStatusAndProgress(buffer, bufferCount, due->next)){
+            return false;
+          }
+          pmid = due->pmid;
+          due->sent = due->next;
+          due->sentOnce = true;
+          due->pending = false;
+          due->urgent = false;
+          due->lastSentMillis = nowMillis;
+          return true;
+        };
+
+        bool hasPending(){
+          for(uint8_t i = 0; i < CAN_STATUS_PUBLISHER_SLOTS; i++){
+            if(slots[i].used && slots[i].pending){
+              return true;
+            }
+          }
+          return false;
+        };
+
+        //Updates that never reached the bus, because they were duplicates or were replaced by a newer update
+        uint32_t getSuppressedUpdates(){
+          return suppressedUpdates;
+        };
+
+};
+
+#endif
@@ -0,0 +1,386 @@
+/*
+  Gm7CanUidCollision.h - Detecting devices that share a UID, and optionally negotiating a free UID on startup.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanUidCollision_h
+#define Gm7CanUidCollision_h
+
+#include <Arduino.h>
+#include "Gm7CanProtocol.h"
+
+#ifndef CAN_UID_COLLISION_SLOTS
+  #if defined(__AVR__)
+    #define CAN_UID_COLLISION_SLOTS 64 //Power of 2, about 20 bytes each. Tracks up to 64 UID's; more do not fit in the RAM of an AVR.
+  #else
+    #define CAN_UID_COLLISION_SLOTS 512 //Power of 2, about 24 bytes each. Enough for rooms with hundreds of nodes.
+  #endif
+#endif
+
+#ifndef CAN_UID_CLAIM_INTERVAL_MILLIS
+  #define CAN_UID_CLAIM_INTERVAL_MILLIS 250
+#endif
+
+#ifndef CAN_UID_CLAIM_COUNT
+  #define CAN_UID_CLAIM_COUNT 3 //Claims sent without an objection before the UID is owned
+#endif
+
+#ifndef CAN_UID_DEFEND_LIMIT
+  #define CAN_UID_DEFEND_LIMIT 3 //Defends in one conflict before the UID is given up to a device that does not back off
+#endif
+
+class Gm7CanUidCollisionDetector {
+  //Remembers what each UID told about itself (serial number, device type id and the CanDeviceType of its heartbeats)
+  //and reports a collision when a UID contradicts itself:
+  //- COLLISION_SERIAL: two different serial numbers (DEVICE_SERIAL or DEVICE_UID_CLAIM).
+  //- COLLISION_TYPE_ID: two different device type id's (DEVICE_TYPE_ID).
+  //- COLLISION_DEVICE_TYPE: heartbeats of two different CanDeviceTypes, or a heartbeat that does not match the device type id.
+  //- COLLISION_HEARTBEAT: millisCurrent of the heartbeats keeps jumping back. A single jump back is a restart;
+  //  two devices with the same heartbeat PMID interleave and jump back on almost every beat.
+  //- COLLISION_OWN_UID: a frame with the UID of this device. CAN controllers do not receive their own frames, so another device uses it.
+  //  Reported once, until setOwnUid() or reset() is called; getOwnUidFrames() counts every frame.
+  //The UID's are kept in an open addressed hash table, so every frame costs a couple of compares, also with hundreds of nodes.
+  //At most CAN_UID_COLLISION_SLOTS UID's are tracked; when the table is full, new UID's are not (see getUntrackedFrames()).
+    public:
+        enum CollisionReason : uint8_t {
+          COLLISION_NONE = 0,
+          COLLISION_SERIAL = 1,
+          COLLISION_TYPE_ID = 2,
+          COLLISION_DEVICE_TYPE = 3,
+          COLLISION_HEARTBEAT = 4,
+          COLLISION_OWN_UID = 5
+        };
+
+        typedef void (*CollisionCallback)(uint16_t uid, uint8_t collisionReason);
+
+        struct Node{
+          uint16_t uid;
+          bool used;
+          bool hasSerial;
+          bool hasTypeId;
+          uint8_t canDeviceType;     //From the heartbeat PMID, 0 until a heartbeat was seen
+          uint8_t collisionReason;   //The first collision seen for this UID, COLLISION_NONE if there was none
+          uint8_t heartbeatRegressions;
+          uint8_t heartbeatRises;    //Heartbeats in a row without a jump back
+          uint16_t typeId;
+          uint32_t lastHeartbeatMillis;
+          uint64_t serialNumber;
+        };
+
+    private:
+      static_assert((CAN_UID_COLLISION_SLOTS & (CAN_UID_COLLISION_SLOTS - 1)) == 0 && CAN_UID_COLLISION_SLOTS >= 1 && CAN_UID_COLLISION_SLOTS <= 0x8000,
+        "CAN_UID_COLLISION_SLOTS must be a power of 2, at most 32768");
+
+      static const uint8_t HEARTBEAT_REGRESSION_LIMIT = 3;
+      static const uint8_t HEARTBEAT_RISES_TO_FORGET = 8;
+
+      Node nodes[CAN_UID_COLLISION_SLOTS];
+      uint16_t ownUid = 0;
+      bool hasOwnUid = false;
+      bool ownUidReported = false;
+      uint32_t ownUidFrames = 0;
+      uint32_t collisions = 0;
+      uint32_t untrackedFrames = 0;
+      CollisionCallback callback = 0;
+
+      static uint16_t getSlot(uint16_t uid){
+        return (uint16_t)(uid * 40503u) & (CAN_UID_COLLISION_SLOTS - 1); //Fibonacci hashing, UID's are often sequential
+      };
+
+      Node * findNode(uint16_t uid, bool create){
+        uint16_t slot = getSlot(uid);
+        for(uint16_t i = 0; i < CAN_UID_COLLISION_SLOTS; i++){
+          Node & node = nodes[(slot + i) & (CAN_UID_COLLISION_SLOTS - 1)];
+          if(node.used && node.uid == uid){
+            return &node;
+          }
+          if(!node.used){
+            if(!create){
+              return 0;
+            }
+            memset(&node, 0, sizeof(Node));
+            node.used = true;
+            node.uid = uid;
+            return &node;
+          }
+        }
+        return 0;
+      };
+
+      uint8_t report(Node * node, uint16_t uid, uint8_t reason){
+        if(node != 0 && node->collisionReason == COLLISION_NONE){
+          node->collisionReason = reason;
+        }
+        collisions++;
+        if(callback != 0){
+          callback(uid, reason);
+        }
+        return reason;
+      };
+
+      uint8_t checkDeviceType(Node & node){
+        if(node.hasTypeId && node.canDeviceType != 0 && Gm7CanProtocol::extractCanDeviceTypeFromDeviceTypeId(node.typeId) != node.canDeviceType){
+          return report(&node, node.uid, COLLISION_DEVICE_TYPE);
+        }
+        return COLLISION_NONE;
+      };
+
+    public:
+        Gm7CanUidCollisionDetector(){
+          memset(nodes, 0, sizeof(nodes));
+        };
+
+        void setCallback(CollisionCallback collisionCallback){
+          callback = collisionCallback;
+        };
+
+        //Frames received with this UID are reported as COLLISION_OWN_UID. Do not set it when the CAN controller runs in loopback mode.
+        void setOwnUid(uint16_t uid){
+          ownUid = uid;
+          hasOwnUid = true;
+          ownUidReported = false;
+        };
+
+        //Feed every received frame. Returns the collision it revealed, COLLISION_NONE otherwise.
+        uint8_t onFrame(uint32_t canMessageId, const char * buffer, uint8_t bufferCount){
+          Gm7CanProtocol::MessageId messageId = Gm7CanProtocol::parseMessageId(canMessageId);
+          uint16_t pmid = messageId.pmid;
+          uint16_t uid = messageId.uid;
+          if(hasOwnUid && uid == ownUid){
+            ownUidFrames++;
+            if(ownUidReported){
+              return COLLISION_NONE; //Already reported, a callback per frame would flood the application
+            }
+            ownUidReported = true;
+            return report(0, uid, COLLISION_OWN_UID);
+          }
+          bool heartbeat = pmid > Gm7CanProtocol::HEARTBEATS_START && pmid < Gm7CanProtocol::HEARTBEATS_END;
+          bool serial = pmid == Gm7CanProtocol::DEVICE_SERIAL || pmid == Gm7CanProtocol::DEVICE_UID_CLAIM;
+          if(!heartbeat && !serial && pmid != Gm7CanProtocol::DEVICE_TYPE_ID){
+            return COLLISION_NONE;
+          }
+          Node * node = findNode(uid, true);
+          if(node == 0){
+            untrackedFrames++;
+            return COLLISION_NONE;
+          }
+          uint8_t found = COLLISION_NONE;
+          if(serial){
+            uint64_t serialNumber = Gm7CanProtocol::extractSerialNumberFromBuffer(buffer, bufferCount);
+            if(node->hasSerial && node->serialNumber != serialNumber){
+              found = report(node, uid, COLLISION_SERIAL);
+            }
+            node->serialNumber = serialNumber;
+            node->hasSerial = true;
+          } else if(pmid == Gm7CanProtocol::DEVICE_TYPE_ID){
+            uint16_t typeId = Gm7CanProtocol::extractDeviceTypeIdFromBuffer(buffer, bufferCount);
+            if(node->hasTypeId && node->typeId != typeId){
+              found = report(node, uid, COLLISION_TYPE_ID);
+            }
+            node->typeId = typeId;
+            node->hasTypeId = true;
+            if(found == COLLISION_NONE){
+              found = checkDeviceType(*node);
+            }
+          } else {
+            uint8_t canDeviceType = Gm7CanProtocol::getCanDeviceTypeForPmid(pmid);
+            if(node->canDeviceType != 0 && canDeviceType != node->canDeviceType){
+              found = report(node, uid, COLLISION_DEVICE_TYPE);
+            }
+            node->canDeviceType = canDeviceType;
+            if(found == COLLISION_NONE){
+              found = checkDeviceType(*node);
+            }
+            uint32_t millisCurrent = Gm7CanProtocol::decodeHeartbeat(buffer, bufferCount).millisCurrent;
+            if(millisCurrent < node->lastHeartbeatMillis){
+              node->heartbeatRises = 0;
+              if(++node->heartbeatRegressions == HEARTBEAT_REGRESSION_LIMIT){
+                found = report(node, uid, COLLISION_HEARTBEAT);
+              }
+            } else if(node->heartbeatRegressions < HEARTBEAT_REGRESSION_LIMIT && ++node->heartbeatRises == HEARTBEAT_RISES_TO_FORGET){
+              node->heartbeatRegressions = 0; //A restart is followed by rising values, interleaved devices keep jumping back
+              node->heartbeatRises = 0;
+            }
+            node->lastHeartbeatMillis = millisCurrent;
+          }
+          return found;
+        };
+
+        bool hasCollision(uint16_t uid){
+          const Node * node = getNode(uid);
+          return node != 0 && node->collisionReason != COLLISION_NONE;
+        };
+
+        const Node * getNode(uint16_t uid){
+          return findNode(uid, false);
+        };
+
+        const Node * getNodeAt(uint16_t index){
+          if(index >= CAN_UID_COLLISION_SLOTS || !nodes[index].used){
+            return 0;
+          }
+          return &nodes[index];
+        };
+
+        uint32_t getCollisionCount(){
+          return collisions;
+        };
+
+        //Frames of UID's that did not fit in the table anymore
+        uint32_t getUntrackedFrames(){
+          return untrackedFrames;
+        };
+
+        //Frames received with the own UID
+        uint32_t getOwnUidFrames(){
+          return ownUidFrames;
+        };
+
+        //Forgets everything, for example after the colliding devices were given new UID's
+        void reset(){
+          memset(nodes, 0, sizeof(nodes));
+          collisions = 0;
+          untrackedFrames = 0;
+          ownUidFrames = 0;
+          ownUidReported = false;
+        };
+
+};
+
+class Gm7CanUidClaimer {
+  //Optional dynamic UID's. Instead of the low 16 bits of the serial number, the UID is Gm7CanProtocol::getUidForSerial(serial, attempt).
+  //On startup the device claims it by sending DEVICE_UID_CLAIM (with its full serial number) CAN_UID_CLAIM_COUNT times,
+  //CAN_UID_CLAIM_INTERVAL_MILLIS apart. Any objection restarts the claim with the next attempt:
+  //- A claim or DEVICE_SERIAL for the same UID with a lower serial number. The lowest serial number always wins, so both sides agree.
+  //- Any other frame with the same UID while claiming; a device with a fixed UID can not give it up.
+  //A claim from a higher serial number, or any frame with our UID once it is owned, is answered with a claim of our own (defend),
+  //at most once per CAN_UID_CLAIM_INTERVAL_MILLIS. A device that still uses the UID after CAN_UID_DEFEND_LIMIT defends (a device with a
+  //fixed UID) gets it: we claim the next UID instead of fighting over it forever, since two devices sending the same
+  //CAN id with different data cause bus errors.
+  //Do not send other frames before isOwned() returns true. Feed every received frame to onFrame() and call poll() every loop.
+    public:
+        enum ClaimState : uint8_t {
+          CLAIM_IDLE = 0,
+          CLAIM_CLAIMING = 1,
+          CLAIM_OWNED = 2
+        };
+
+    private:
+      uint64_t serialNumber;
+      ClaimState state = CLAIM_IDLE;
+      uint8_t attempt = 0;
+      uint8_t claimsSent = 0;
+      bool defendPending = false;
+      uint8_t defendsSent = 0;       //In the current conflict
+      uint32_t lastDefendMillis = 0;
+      uint32_t lastConflictMillis = 0;
+      uint16_t uid = 0;
+      uint32_t nextClaimMillis = 0;
+      uint32_t lostClaims = 0;
+
+      void startClaim(uint32_t nowMillis){
+        uid = Gm7CanProtocol::getUidForSerial(serialNumber, attempt);
+        state = CLAIM_CLAIMING;
+        claimsSent = 0;
+        defendPending = false;
+        defendsSent = 0;
+        nextClaimMillis = nowMillis;
+      };
+
+    public:
+        Gm7CanUidClaimer(uint64_t deviceSerialNumber){
+          serialNumber = deviceSerialNumber;
+        };
+
+        void begin(uint32_t nowMillis){
+          attempt = 0;
+          startClaim(nowMillis);
+        };
+
+        //Feed every received frame. Returns true when it cost us the UID; claiming restarts with a new UID.
+        bool onFrame(uint32_t canMessageId, const char * buffer, uint8_t bufferCount, uint32_t nowMillis){
+          Gm7CanProtocol::MessageId messageId = Gm7CanProtocol::parseMessageId(canMessageId);
+          if(state == CLAIM_IDLE || messageId.uid != uid){
+            return false;
+          }
+          uint16_t pmid = messageId.pmid;
+          bool lost;
+          if(pmid == Gm7CanProtocol::DEVICE_UID_CLAIM || pmid == Gm7CanProtocol::DEVICE_SERIAL){
+            uint64_t otherSerialNumber = Gm7CanProtocol::extractSerialNumberFromBuffer(buffer, bufferCount);
+            if(otherSerialNumber == serialNumber){
+              return false; //Loopback of our own claim
+            }
+            lost = otherSerialNumber < serialNumber;
+          } else {
+            lost = state == CLAIM_CLAIMING;
+          }
+          if(!lost){
+            if(defendsSent > 0 && nowMillis - lastConflictMillis > 4 * CAN_UID_CLAIM_INTERVAL_MILLIS){
+              defendsSent = 0; //The previous conflict ended, this is a new one
+            }
+            lastConflictMillis = nowMillis;
+            if(defendPending || (defendsSent > 0 && nowMillis - lastDefendMillis < CAN_UID_CLAIM_INTERVAL_MILLIS)){
+              return false; //Rate limited, one defend per interval
+            }
+            if(defendsSent < CAN_UID_DEFEND_LIMIT){
+              defendPending = true;
+              return false;
+            }
+            //The other device does not back off, give the UID up
+          }
+          lostClaims++;
+          attempt++;
+          startClaim(nowMillis + (serialNumber % CAN_UID_CLAIM_INTERVAL_MILLIS)); //Spread out devices that lost at the same moment
+          return true;
+        };
+
+        //Returns true and fills pmid and buffer when a claim should be sent now. The frame must be sent with getUid().
+        bool poll(uint32_t nowMillis, uint16_t & pmid, char * buffer, uint8_t bufferCount){
+          if(state == CLAIM_IDLE || (!defendPending && (state == CLAIM_OWNED || (int32_t)(nowMillis - nextClaimMillis) < 0))){
+            return false;
+          }
+          if(state == CLAIM_CLAIMING && !defendPending && claimsSent >= CAN_UID_CLAIM_COUNT){
+            state = CLAIM_OWNED; //The last claim went unanswered for a full interval
+            return false;
+          }
+          if(!Gm7CanProtocol::encodeSerialNumberToBuffer(buffer, bufferCount, serialNumber)){
+            return false;
+          }
+          pmid = Gm7CanProtocol::DEVICE_UID_CLAIM;
+          if(defendPending){
+            defendPending = false;
+            defendsSent++;
+            lastDefendMillis = nowMillis;
+          } else {
+            claimsSent++;
+            nextClaimMillis = nowMillis + CAN_UID_CLAIM_INTERVAL_MILLIS;
+          }
+          return true;
+        };
+
+        bool isOwned(){
+          return state == CLAIM_OWNED;
+        };
+
+        ClaimState getState(){
+          return state;
+        };
+
+        //The UID being claimed, or the owned UID
+        uint16_t getUid(){
+          return uid;
+        };
+
+        uint8_t getAttempt(){
+          return attempt;
+        };
+
+        uint32_t getLostClaims(){
+          return lostClaims;
+        };
+
+};
+
+#endif
@@ -0,0 +1,103 @@
+/*
+  Gm7CanGateway.cpp - Daemon that reads GM7 CAN traffic from one or more SocketCAN interfaces and writes every frame to stdout
+                      as a candump -L line followed by its decoded event, for other processes to consume through a pipe:
+                        (1700000000.123456) can0 00CA0102#0000138800000FA0 HEARTBEAT millis=5000 last=4000
+                      The lines stay readable by Gm7CanCandump::parseLine, which stops at the space after the payload.
+                      Statistics per bus go to stderr when it stops (SIGINT or SIGTERM).
+                      Linux only. Build it from the root of the library; the Arduino.h in test stands in for the Arduino core:
+                        g++ -std=gnu++11 -O2 -Wall -Wextra -I test -I . extras/Gm7CanGateway/Gm7CanGateway.cpp -o gm7can-gateway
+                        ./gm7can-gateway can0 can1
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#include <stdio.h>
+#include <signal.h>
+#include "Gm7CanSocketCan.h"
+#include "Gm7CanCandump.h"
+
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int signal){
+  (void)signal;
+  running = 0;
+}
+
+static const char * getEventName(uint8_t type){
+  static const char * names[] = {"UNKNOWN", "INVALID", "EMERGENCY", "HEARTBEAT", "STATUS_AND_PROGRESS", "MAIN_TIMER", "VALIDATION_TIMER",
+    "INTERNAL_TIMER", "TRIES", "REGISTRATION", "DEVICE_INFO", "REQUEST", "ACK", "ONLINE_BITMAP"};
+  return type < sizeof(names) / sizeof(names[0]) ? names[type] : "UNKNOWN";
+}
+
+static void printEvent(uint8_t bus, const Gm7CanProtocol::Event & event, const Gm7CanProtocol::CanFrame & frame, uint64_t timestampNanos, void * context){
+  char * const * interfaceNames = (char * const *)context;
+  char line[96];
+  uint16_t length = Gm7CanCandump::formatLine(line, sizeof(line), timestampNanos / 1000000000ULL, (timestampNanos / 1000) % 1000000,
+    interfaceNames[bus], frame.id, frame.data, frame.length);
+  if(length == 0){
+    return;
+  }
+  printf("%s %s", line, getEventName(event.type));
+  switch(event.type){
+    case Gm7CanProtocol::EVENT_HEARTBEAT:
+      printf(" millis=%u last=%u", event.heartbeat.millisCurrent, event.heartbeat.millisLast);
+      break;
+    case Gm7CanProtocol::EVENT_STATUS_AND_PROGRESS:
+      printf(" status=%u progress=%u/%u", event.statusAndProgress.status, event.statusAndProgress.progress, event.statusAndProgress.progressMax);
+      break;
+    case Gm7CanProtocol::EVENT_MAIN_TIMER:
+    case Gm7CanProtocol::EVENT_VALIDATION_TIMER:
+    case Gm7CanProtocol::EVENT_INTERNAL_TIMER:
+      printf(" left=%u set=%u", event.timerStatus.timeLeft, event.timerStatus.timeSet);
+      break;
+    case Gm7CanProtocol::EVENT_TRIES:
+      printf(" tries=%u/%u total=%u", event.tries.current, event.tries.max, event.tries.total);
+      break;
+    case Gm7CanProtocol::EVENT_REGISTRATION:
+      printf(" type=%u", event.deviceTypeId);
+      break;
+    case Gm7CanProtocol::EVENT_ACK:
+      printf(" requester=%04X pmid=%u sequence=%u result=%u", event.ack.requesterUid, event.ack.requestPmid, event.ack.sequence, event.ack.result);
+      break;
+    case Gm7CanProtocol::EVENT_ONLINE_BITMAP:
+      printf(" page=%u bitmap=%014llX", event.onlineBitmap.page, (unsigned long long)event.onlineBitmap.bitmap);
+      break;
+    default:
+      break; //The frame itself says all there is
+  }
+  putchar('\n');
+}
+
+int main(int argc, char ** argv){
+  if(argc < 2 || argc - 1 > CAN_SOCKETCAN_BUSES){
+    fprintf(stderr, "usage: %s interface [interface ...] (at most %d)\n", argv[0], CAN_SOCKETCAN_BUSES);
+    return 2;
+  }
+  Gm7CanSocketCanGateway gateway;
+  for(int i = 1; i < argc; i++){
+    if(gateway.openBus(argv[i]) < 0){
+      perror(argv[i]);
+      return 1;
+    }
+  }
+  gateway.setCallback(printEvent, &argv[1]);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onSignal; //No SA_RESTART, so the wait returns on a signal
+  sigaction(SIGINT, &action, 0);
+  sigaction(SIGTERM, &action, 0);
+  while(running){
+    if(gateway.poll(1000) < 0){
+      perror("epoll_wait");
+      return 1;
+    }
+    fflush(stdout); //Once per batch of frames, not per line
+  }
+  for(uint8_t bus = 0; bus < gateway.getBusCount(); bus++){
+    Gm7CanSocketCanGateway::BusStats stats = gateway.getStats(bus);
+    fprintf(stderr, "%s: %u frames in %u batches, %u skipped, %u dropped by the kernel, %u read errors\n",
+      argv[bus + 1], stats.frames, stats.batches, stats.skipped, stats.kernelDrops, stats.readErrors);
+  }
+  return 0;
+}
@@ -0,0 +1,32 @@
+/*
+  Arduino.h - The few parts of the Arduino core the library uses, so the headers can be tested on a host.
+              Only found through -I test, never when building for a board.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+inline long random(long howBig){
+  return howBig <= 0 ? 0 : rand() % howBig;
+}
+
+inline long random(long howSmall, long howBig){
+  return howSmall >= howBig ? howSmall : howSmall + (rand() % (howBig - howSmall));
+}
+
+inline unsigned long millis(){
+  return 0; //Tests pass the time to every method themselves
+}
+
+inline void noInterrupts(){}
+inline void interrupts(){}
+
+#endif
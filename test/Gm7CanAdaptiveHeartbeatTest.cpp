@@ -0,0 +1,65 @@
+//Host tests for Gm7CanAdaptiveHeartbeat.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanAdaptiveHeartbeat.h"
+
+//Runs a controller with a busy bus until busyUntilMillis and a quiet bus after it. The node follows every controller heartbeat
+//and checks that the next one arrives within the timeout it uses at that moment.
+static void runBus(uint32_t busyUntilMillis, uint32_t endMillis, uint8_t & changes, uint32_t & longestGapMillis, bool & timedOut){
+  Gm7CanProtocol controllerProtocol;
+  Gm7CanAdaptiveHeartbeat adaptive(controllerProtocol, 8000);
+  adaptive.setHoldMillis(3000);
+  Gm7CanProtocol nodeProtocol;
+  uint32_t lastHeartbeatMillis = 0;
+  bool seen = false;
+  char buffer[8];
+  for(uint32_t now = 0; now < endMillis; now++){
+    if(now < busyUntilMillis){
+      adaptive.recordFrame(8);
+      adaptive.recordFrame(8);
+    }
+    if(adaptive.update(now)){
+      changes++;
+    }
+    if(seen && now - lastHeartbeatMillis > nodeProtocol.getHeartbeatTimeoutTresholdInMillis()){
+      timedOut = true;
+    }
+    if(adaptive.isHeartbeatDue(now)){
+      CHECK(adaptive.encodeHeartbeat(buffer, 8, now));
+      CHECK(!adaptive.isHeartbeatDue(now));
+      if(seen && now - lastHeartbeatMillis > longestGapMillis){
+        longestGapMillis = now - lastHeartbeatMillis;
+      }
+      nodeProtocol.followHeartbeatTiming(Gm7CanProtocol::decodeAdaptiveHeartbeat(buffer, 8));
+      lastHeartbeatMillis = now;
+      seen = true;
+    }
+  }
+}
+
+static void testGrowAndShrink(){
+  uint8_t changes = 0;
+  uint32_t longestGapMillis = 0;
+  bool timedOut = false;
+  runBus(20000, 60000, changes, longestGapMillis, timedOut);
+  CHECK(changes >= 4);              //Grew to the maximum and came back
+  CHECK_EQUAL(8000, longestGapMillis);
+  CHECK(!timedOut);                 //The controller was never late for the timeout the node used
+}
+
+static void testTimeouts(){
+  CHECK_EQUAL(1250, Gm7CanAdaptiveHeartbeat::getTimeoutForInterval(1000));
+  CHECK_EQUAL(350, Gm7CanAdaptiveHeartbeat::getTimeoutForInterval(100));
+  Gm7CanProtocol protocol;
+  Gm7CanAdaptiveHeartbeat adaptive(protocol);
+  CHECK(adaptive.isHeartbeatDue(0)); //The first heartbeat right away
+  char buffer[8];
+  CHECK(!adaptive.encodeHeartbeat(buffer, 7, 0));
+  CHECK(adaptive.isHeartbeatDue(0));
+}
+
+int main(){
+  testGrowAndShrink();
+  testTimeouts();
+  return finishTests("Gm7CanAdaptiveHeartbeatTest");
+}
@@ -0,0 +1,144 @@
+//Host tests for Gm7CanAwait.h, see Gm7CanTest.h for how to build and run them; build with -std=c++20 to test the coroutines too
+
+#include "Gm7CanTest.h"
+#include "Gm7CanAwait.h"
+
+static uint32_t makeId(uint16_t pmid, uint16_t uid){
+  return ((uint32_t)pmid << 16) | uid;
+}
+
+static void testMatching(){
+  Gm7CanWaitTable table;
+  char buffer[8] = {0x12, 0x34, 0x56, 0x78, 1, 2, 3, 4};
+  Gm7CanWaitTable::Handle any = table.expect(1001, 0x0042, 100, 0);
+  Gm7CanWaitTable::Handle masked = table.expect(1001, 0x0042, 100, 0, 0x12000000, 0xFF000000);
+  Gm7CanWaitTable::Handle wrongValue = table.expect(1001, 0x0042, 100, 0, 0x13000000, 0xFF000000);
+  Gm7CanWaitTable::Handle otherUid = table.expect(1001, 0x0043, 100, 0);
+  CHECK(any != 0);
+  CHECK_EQUAL(4, table.getPendingCount());
+  table.onFrame(makeId(1001, 0x0042), buffer, 8);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_DONE, table.getState(any));
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_DONE, table.getState(masked));
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_PENDING, table.getState(wrongValue));
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_PENDING, table.getState(otherUid));
+  char payload[8];
+  CHECK_EQUAL(8, table.getPayload(any, payload, 8));
+  CHECK(memcmp(payload, buffer, 8) == 0);
+  CHECK_EQUAL(0, table.getPayload(wrongValue, payload, 8));
+  Gm7CanWaitTable::Handle handles[2] = {any, wrongValue};
+  CHECK(!table.isSettled(handles, 2));
+  table.poll(99);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_PENDING, table.getState(wrongValue));
+  table.poll(100);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_TIMED_OUT, table.getState(wrongValue));
+  CHECK(table.isSettled(handles, 2));
+  CHECK_EQUAL(0, table.getPendingCount());
+}
+
+static void testStaleHandles(){
+  Gm7CanWaitTable table;
+  Gm7CanWaitTable::Handle handle = table.expect(1001, 1, 100, 0);
+  table.release(handle);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_INVALID, table.getState(handle));
+  Gm7CanWaitTable::Handle reused = table.expect(1001, 1, 100, 0);
+  CHECK_EQUAL(handle & 0xFFFF, reused & 0xFFFF); //Same entry, new generation
+  CHECK(reused != handle);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_INVALID, table.getState(handle));
+  table.release(handle); //Does not release the new wait
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_PENDING, table.getState(reused));
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_INVALID, table.getState(0));
+  for(uint16_t i = 1; i < CAN_WAIT_TABLE_ENTRIES; i++){
+    CHECK(table.expect(1001, i + 1, 100, 0) != 0);
+  }
+  CHECK_EQUAL(0, table.expect(1001, 0xFFFF, 100, 0)); //Full
+}
+
+struct Rearm{
+  Gm7CanWaitTable * table;
+  Gm7CanWaitTable::Handle handle;
+  uint32_t nowMillis;
+  uint32_t timeoutMillis;
+  uint16_t resumes;
+  uint16_t timeouts;
+};
+
+static void rearm(void * context){
+  Rearm * state = (Rearm *)context;
+  state->resumes++;
+  if(state->table->getState(state->handle) == Gm7CanWaitTable::WAIT_TIMED_OUT){
+    state->timeouts++;
+  }
+  state->table->release(state->handle);
+  state->handle = state->table->expect(1001, 1, state->timeoutMillis, state->nowMillis);
+  state->table->setResume(state->handle, rearm, state);
+}
+
+//A wait created from a resume callback in poll() can reuse an entry that was already walked, its deadline must still count
+static void testRearmFromPoll(bool shortFirst){
+  Gm7CanWaitTable table;
+  Rearm fast = {&table, 0, 0, 100, 0, 0};
+  Gm7CanWaitTable::Handle slow = 0;
+  if(!shortFirst){
+    slow = table.expect(2002, 2, 5000, 0);
+  }
+  fast.handle = table.expect(1001, 1, 100, 0);
+  table.setResume(fast.handle, rearm, &fast);
+  if(shortFirst){
+    slow = table.expect(2002, 2, 5000, 0);
+  }
+  for(uint32_t now = 0; now <= 1000; now++){
+    fast.nowMillis = now;
+    table.poll(now);
+  }
+  CHECK_EQUAL(10, fast.timeouts);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_PENDING, table.getState(slow));
+}
+
+//A wait started from a resume callback does not complete on the frame that triggered that callback
+static void testNoCompletionByTriggeringFrame(){
+  Gm7CanWaitTable table;
+  Rearm again = {&table, 0, 0, 100, 0, 0};
+  again.handle = table.expect(1001, 1, 100, 0);
+  table.setResume(again.handle, rearm, &again);
+  char buffer[8] = {0};
+  table.onFrame(makeId(1001, 1), buffer, 8);
+  CHECK_EQUAL(1, again.resumes);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_PENDING, table.getState(again.handle));
+  table.onFrame(makeId(1001, 1), buffer, 8);
+  CHECK_EQUAL(2, again.resumes);
+  CHECK_EQUAL(0, again.timeouts);
+}
+
+#ifdef GM7_CAN_COROUTINES
+static Gm7CanWaitTable::WaitState awaitedState = Gm7CanWaitTable::WAIT_INVALID;
+
+static Gm7CanTask awaitBoth(Gm7CanWaitTable & table){
+  Gm7CanWaitTable::Handle first = table.expect(1001, 1, 100, 0);
+  Gm7CanWaitTable::Handle second = table.expect(1001, 2, 100, 0);
+  co_await table.wait(first);
+  awaitedState = co_await table.wait(second);
+}
+
+static void testCoroutine(){
+  Gm7CanWaitTable table;
+  awaitBoth(table);
+  char buffer[8] = {0};
+  table.onFrame(makeId(1001, 2), buffer, 8); //The second frame first, it is kept until awaited
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_INVALID, awaitedState);
+  table.onFrame(makeId(1001, 1), buffer, 8);
+  CHECK_EQUAL(Gm7CanWaitTable::WAIT_DONE, awaitedState);
+  CHECK_EQUAL(0, table.getPendingCount());
+}
+#endif
+
+int main(){
+  testMatching();
+  testStaleHandles();
+  testRearmFromPoll(true);
+  testRearmFromPoll(false);
+  testNoCompletionByTriggeringFrame();
+#ifdef GM7_CAN_COROUTINES
+  testCoroutine();
+#endif
+  return finishTests("Gm7CanAwaitTest");
+}
@@ -0,0 +1,90 @@
+//Host tests for Gm7CanCandump.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanCandump.h"
+
+static bool parse(const char * line, Gm7CanCandump::LogFrame & frame){
+  return Gm7CanCandump::parseLine(line, strlen(line), frame);
+}
+
+static void testParseLine(){
+  Gm7CanCandump::LogFrame frame;
+  const char * line = "(1676000000.123456) can0 13950007#00000000000003E8";
+  CHECK(parse(line, frame));
+  CHECK_EQUAL(1676000000UL, frame.seconds);
+  CHECK_EQUAL(123456, frame.micros);
+  CHECK_EQUAL(0x13950007UL, frame.canMessageId);
+  CHECK(frame.extended);
+  CHECK_EQUAL(8, frame.length);
+  CHECK_EQUAL(0x03, (uint8_t)frame.payload[6]);
+  CHECK_EQUAL(0xE8, (uint8_t)frame.payload[7]);
+  CHECK_EQUAL(20, frame.interfaceStart);
+  CHECK_EQUAL(4, frame.interfaceLength);
+  CHECK(strncmp(&line[frame.interfaceStart], "can0", frame.interfaceLength) == 0);
+}
+
+static void testParseVariants(){
+  Gm7CanCandump::LogFrame frame;
+  CHECK(parse("(1.5) vcan1 123#", frame)); //Short micros, standard id, no payload
+  CHECK_EQUAL(500000, frame.micros);
+  CHECK_EQUAL(0x123, frame.canMessageId);
+  CHECK(!frame.extended);
+  CHECK_EQUAL(0, frame.length);
+  CHECK(parse("(2.1234567) can0 1fffffff#ab", frame)); //Extra micro digits are ignored, lower case hex
+  CHECK_EQUAL(123456, frame.micros);
+  CHECK_EQUAL(0x1FFFFFFFUL, frame.canMessageId);
+  CHECK_EQUAL(0xAB, (uint8_t)frame.payload[0]);
+  CHECK(parse("(3.000000) can0 00000001#01 T", frame)); //Trailing flags after a space
+  CHECK_EQUAL(1, frame.length);
+}
+
+static void testRejectInvalidLines(){
+  Gm7CanCandump::LogFrame frame;
+  CHECK(!parse("", frame));
+  CHECK(!parse("1676000000.123456 can0 13950007#00", frame));
+  CHECK(!parse("(1676000000.123456) can0 13950007", frame));
+  CHECK(!parse("(1676000000.123456) can0 13950007##100", frame));   //CAN FD
+  CHECK(!parse("(1676000000.123456) can0 1395000G#00", frame));     //Not hex
+  CHECK(!parse("(1676000000.123456) can0 113950007#00", frame));    //9 id digits
+  CHECK(!parse("(1676000000.123456) can0 13950007#000", frame));    //Half a byte
+  CHECK(!parse("(1676000000.123456) can0 13950007#000000000000000000", frame)); //9 bytes
+}
+
+static void testFormatRoundTrip(){
+  char payload[3] = {0x01, (char)0xA0, 0x7F};
+  char line[64];
+  uint16_t length = Gm7CanCandump::formatLine(line, sizeof(line), 12, 3456, "can0", 0x07D10102, payload, 3);
+  CHECK_EQUAL(strlen("(0000000012.003456) can0 07D10102#01A07F"), length);
+  CHECK(strcmp(line, "(0000000012.003456) can0 07D10102#01A07F") == 0);
+  Gm7CanCandump::LogFrame frame;
+  CHECK(Gm7CanCandump::parseLine(line, length, frame));
+  CHECK_EQUAL(12, frame.seconds);
+  CHECK_EQUAL(3456, frame.micros);
+  CHECK_EQUAL(0x07D10102UL, frame.canMessageId);
+  CHECK_EQUAL(3, frame.length);
+  CHECK(memcmp(frame.payload, payload, 3) == 0);
+  CHECK_EQUAL(0, Gm7CanCandump::formatLine(line, 20, 12, 3456, "can0", 0x07D10102, payload, 3)); //Too small
+}
+
+static void testReplayDelay(){
+  Gm7CanCandump::LogFrame previous;
+  Gm7CanCandump::LogFrame next;
+  previous.seconds = 100;
+  previous.micros = 900000;
+  next.seconds = 101;
+  next.micros = 100000;
+  CHECK_EQUAL(200000, Gm7CanCandump::getReplayDelayMicros(previous, next));
+  CHECK_EQUAL(0, Gm7CanCandump::getReplayDelayMicros(next, previous));
+  next.seconds = previous.seconds + 7200; //Two hours of silence, more than 32 bits of micros
+  next.micros = previous.micros;
+  CHECK_EQUAL(7200000000ULL, Gm7CanCandump::getReplayDelayMicros(previous, next));
+}
+
+int main(){
+  testParseLine();
+  testParseVariants();
+  testRejectInvalidLines();
+  testFormatRoundTrip();
+  testReplayDelay();
+  return finishTests("Gm7CanCandumpTest");
+}
@@ -0,0 +1,193 @@
+//Host tests for Gm7CanCapture.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanCapture.h"
+
+static uint32_t makeId(uint16_t pmid, uint16_t uid){
+  return ((uint32_t)pmid << 16) | uid;
+}
+
+static void testBlockRoundTrip(){
+  Gm7CanCaptureBlock block;
+  char payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  CHECK(block.isEmpty());
+  for(uint8_t i = 0; i < 10; i++){
+    CHECK(block.append(makeId(1001 + i, 0x0100 + i), payload, i % 9, 5000 + (i * 20)));
+  }
+  uint8_t out[512];
+  uint16_t size = block.serialize(out, sizeof(out));
+  CHECK_EQUAL(block.getSerializedSize(), size);
+  CHECK_EQUAL(0, block.serialize(out, size - 1));
+
+  Gm7CanCaptureReader reader(out, size);
+  CHECK(reader.isValid());
+  CHECK_EQUAL(10, reader.getHeader().frameCount);
+  CHECK_EQUAL(1001, reader.getHeader().pmidMin);
+  CHECK_EQUAL(1010, reader.getHeader().pmidMax);
+  CHECK_EQUAL(5000, reader.getHeader().firstMillis);
+  CHECK_EQUAL(5180, reader.getHeader().lastMillis);
+  Gm7CanCaptureBlock::Frame frame;
+  for(uint8_t i = 0; i < 10; i++){
+    CHECK(reader.next(frame));
+    CHECK_EQUAL(makeId(1001 + i, 0x0100 + i), frame.canMessageId);
+    CHECK_EQUAL(5000 + (i * 20), frame.timestampMillis);
+    CHECK_EQUAL(i % 9, frame.length);
+    CHECK(memcmp(frame.payload, payload, frame.length) == 0);
+  }
+  CHECK(!reader.next(frame));
+}
+
+static void testAppendLimits(){
+  Gm7CanCaptureBlock block;
+  char payload[8] = {0};
+  CHECK(block.append(makeId(1001, 1), payload, 8, 0));
+  CHECK(!block.append(makeId(1001, 1), payload, 9, 1));         //Too long
+  CHECK(block.append(makeId(1001, 1), payload, 8, 70000));      //Long gaps are fine
+  CHECK(!block.append(makeId(1001, 1), payload, 8, 69999));     //Older than the previous frame
+  CHECK(!block.append(makeId(1001, 1), payload, 8, 0x100000000ULL)); //2^32 millis after the first frame
+  for(uint8_t i = 2; i < CAN_CAPTURE_BLOCK_FRAMES; i++){
+    CHECK(block.append(makeId(1001, 1), payload, 8, 70000 + i));
+  }
+  CHECK(block.isFull());
+  CHECK(!block.append(makeId(1001, 1), payload, 8, 100));
+}
+
+static void testRejectDamagedBlock(){
+  Gm7CanCaptureBlock block;
+  char payload[8] = {0};
+  block.append(makeId(1001, 1), payload, 8, 0);
+  uint8_t out[128];
+  uint16_t size = block.serialize(out, sizeof(out));
+  Gm7CanCaptureReader truncated(out, size - 1);
+  CHECK(!truncated.isValid());
+  out[0] = 'X';
+  Gm7CanCaptureReader badMagic(out, size);
+  CHECK(!badMagic.isValid());
+}
+
+static void testMayContain(){
+  Gm7CanCaptureBlock block;
+  char payload[8] = {0};
+  block.append(makeId(1001, 0x0200), payload, 8, 1000);
+  block.append(makeId(1002, 0x0204), payload, 8, 2000);
+  uint8_t out[128];
+  uint16_t size = block.serialize(out, sizeof(out));
+  Gm7CanCaptureReader reader(out, size);
+  uint32_t all = 0xFFFFFFFF;
+  CHECK(reader.mayContain(Gm7CanProtocol::createFrameFilter(0, 0x1FFF), 0, all));
+  CHECK(reader.mayContain(Gm7CanProtocol::createFrameFilter(1001, 1001, 0x0204, 0xFFFF), 0, all));
+  CHECK(!reader.mayContain(Gm7CanProtocol::createFrameFilter(1001, 1001, 0x0203, 0xFFFF), 0, all)); //UID bit not set
+  CHECK(!reader.mayContain(Gm7CanProtocol::createFrameFilter(3000, 3999), 0, all));                 //PMID range
+  CHECK(!reader.mayContain(Gm7CanProtocol::createFrameFilter(0, 0x1FFF), 2001, all));               //Time window
+  //Masked filters use the UID range and bitmap too
+  CHECK(reader.mayContain(Gm7CanProtocol::createFrameFilter(0, 0x1FFF, 0x0200, 0xFF00), 0, all));
+  CHECK(!reader.mayContain(Gm7CanProtocol::createFrameFilter(0, 0x1FFF, 0x0300, 0xFF00), 0, all));
+  CHECK(!reader.mayContain(Gm7CanProtocol::createFrameFilter(0, 0x1FFF, 0x0007, 0x000F), 0, all));
+  CHECK(reader.mayContain(Gm7CanProtocol::createFrameFilter(0, 0x1FFF, 0x0004, 0x000F), 0, all));
+}
+
+//Unix epoch millis, like candump logs, over more than 49.7 days: the time window still picks the right blocks and frames
+static void testEpochTimestamps(){
+  const uint64_t start = 1767225600000ULL; //2026-01-01 00:00:00 UTC
+  const uint64_t hour = 3600000ULL;
+  const uint64_t day = 24 * hour;
+  uint8_t file[4096];
+  uint32_t fileSize = 0;
+  uint8_t index[1024];
+  uint32_t indexSize = Gm7CanCaptureIndex::writeFileHeader(index, sizeof(index));
+  Gm7CanCaptureBlock block;
+  char payload[8] = {0};
+  for(uint8_t d = 0; d < 60; d += 10){ //A block every 10 days, one frame per hour for 4 hours
+    for(uint8_t h = 0; h < 4; h++){
+      CHECK(block.append(makeId(1001, d), payload, 2, start + (d * day) + (h * hour)));
+    }
+    uint32_t offset = fileSize;
+    fileSize += block.serialize(&file[fileSize], sizeof(file) - fileSize);
+    indexSize += Gm7CanCaptureIndex::writeEntry(&index[indexSize], sizeof(index) - indexSize, offset, block.getHeader());
+    block.reset();
+  }
+  Gm7CanCaptureIndex reader(index, indexSize);
+  CHECK_EQUAL(6, reader.getEntryCount());
+  //The third hour of day 50, which lies past the 32 bit wrap of the day 0 millis
+  uint64_t from = start + (50 * day) + (2 * hour);
+  uint64_t to = from + hour - 1;
+  Gm7CanProtocol::FrameFilter all = Gm7CanProtocol::createFrameFilter(0, 0x1FFF);
+  uint64_t offset;
+  Gm7CanCaptureBlock::Header header;
+  uint8_t blocks = 0;
+  uint8_t frames = 0;
+  while(reader.nextMatching(all, from, to, offset, header)){
+    blocks++;
+    CHECK_EQUAL(start + (50 * day), header.firstMillis);
+    CHECK_EQUAL(start + (50 * day) + (3 * hour), header.lastMillis);
+    Gm7CanCaptureReader blockReader(&file[offset], header.blockSize);
+    Gm7CanCaptureBlock::Frame frame;
+    while(blockReader.nextMatching(all, from, to, frame)){
+      CHECK_EQUAL(from, frame.timestampMillis);
+      CHECK_EQUAL(50, frame.canMessageId & 0xFFFF);
+      frames++;
+    }
+  }
+  CHECK_EQUAL(1, blocks);
+  CHECK_EQUAL(1, frames);
+}
+
+static void testIndex(){
+  uint8_t file[2048];
+  uint32_t fileSize = 0;
+  uint8_t index[512];
+  uint32_t indexSize = Gm7CanCaptureIndex::writeFileHeader(index, sizeof(index));
+  CHECK_EQUAL(CAN_CAPTURE_INDEX_HEADER_BYTES, indexSize);
+  Gm7CanCaptureBlock block;
+  char payload[8] = {0};
+  uint64_t offsets[3];
+  for(uint8_t b = 0; b < 3; b++){
+    for(uint8_t i = 0; i < 4 + b; i++){ //Blocks of different sizes
+      block.append(makeId(1000 + (b * 1000), (b * 0x0100) + i), payload, 8, (b * 1000) + i);
+    }
+    offsets[b] = fileSize;
+    fileSize += block.serialize(&file[fileSize], sizeof(file) - fileSize);
+    indexSize += Gm7CanCaptureIndex::writeEntry(&index[indexSize], sizeof(index) - indexSize, offsets[b], block.getHeader());
+    block.reset();
+  }
+  Gm7CanCaptureIndex reader(index, indexSize);
+  CHECK(reader.isValid());
+  CHECK_EQUAL(3, reader.getEntryCount());
+  uint64_t offset;
+  Gm7CanCaptureBlock::Header header;
+  CHECK(reader.getEntry(2, offset, header));
+  CHECK_EQUAL(offsets[2], offset);
+  CHECK_EQUAL(6, header.frameCount);
+  CHECK(!reader.getEntry(3, offset, header));
+
+  Gm7CanProtocol::FrameFilter filter = Gm7CanProtocol::createFrameFilter(2000, 2000, 0x0100, 0xFF00);
+  CHECK(reader.nextMatching(filter, 0, 0xFFFFFFFF, offset, header));
+  CHECK_EQUAL(offsets[1], offset);
+  Gm7CanCaptureReader blockReader(&file[offset], header.blockSize);
+  CHECK(blockReader.isValid());
+  Gm7CanCaptureBlock::Frame frame;
+  uint8_t matches = 0;
+  while(blockReader.nextMatching(filter, 0, 0xFFFFFFFF, frame)){
+    matches++;
+  }
+  CHECK_EQUAL(5, matches);
+  CHECK(!reader.nextMatching(filter, 0, 0xFFFFFFFF, offset, header));
+  reader.rewind();
+  CHECK(reader.nextMatching(filter, 0, 0xFFFFFFFF, offset, header));
+
+  Gm7CanCaptureIndex partial(index, indexSize - 1); //A partly written last entry is ignored
+  CHECK_EQUAL(2, partial.getEntryCount());
+  index[3] = 'X';
+  Gm7CanCaptureIndex badMagic(index, indexSize);
+  CHECK(!badMagic.isValid());
+}
+
+int main(){
+  testBlockRoundTrip();
+  testAppendLimits();
+  testRejectDamagedBlock();
+  testMayContain();
+  testEpochTimestamps();
+  testIndex();
+  return finishTests("Gm7CanCaptureTest");
+}
@@ -0,0 +1,136 @@
+//Host tests for Gm7CanDeviceRegistry.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanDeviceRegistry.h"
+
+static uint32_t makeId(uint16_t pmid, uint16_t uid){
+  return ((uint32_t)pmid << 16) | uid;
+}
+
+static void registerDevice(Gm7CanDeviceRegistry & registry, uint16_t uid, uint64_t serialNumber, const char * model, uint32_t nowMillis){
+  char buffer[8];
+  Gm7CanProtocol::addUint16ToBuffer(buffer, 8, Gm7CanProtocol::DEVICE_TYPE_MODULE_GENERIC_RO, 0);
+  registry.onFrame(makeId(Gm7CanProtocol::DEVICE_REGISTRATION_REQUEST, uid), buffer, 2, nowMillis);
+  Gm7CanProtocol::encodeSerialNumberToBuffer(buffer, 8, serialNumber);
+  registry.onFrame(makeId(Gm7CanProtocol::DEVICE_SERIAL, uid), buffer, 8, nowMillis);
+  Gm7CanProtocol::encodeModelToBuffer(buffer, 8, model);
+  registry.onFrame(makeId(Gm7CanProtocol::DEVICE_MODEL, uid), buffer, 8, nowMillis);
+}
+
+static void testLearnsDevices(){
+  Gm7CanDeviceRegistry registry;
+  char buffer[8];
+  Gm7CanProtocol::encodeHeartbeat(buffer, 8, 100);
+  CHECK(!registry.onFrame(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, 7), buffer, 8, 0)); //Heartbeats do not register
+  CHECK_EQUAL(0, registry.getDeviceCount());
+  registerDevice(registry, 0x1234, 0xDEADBEEF12345678ULL, "TIMER", 0);
+  CHECK(registry.isDirty());
+  const Gm7CanDeviceRegistry::Device * device = registry.getDevice(0x1234);
+  CHECK(device != 0);
+  if(device == 0){
+    return;
+  }
+  CHECK_EQUAL(Gm7CanProtocol::DEVICE_TYPE_MODULE_GENERIC_RO, device->typeId);
+  CHECK_EQUAL(0xDEADBEEF12345678ULL, device->serialNumber);
+  CHECK(strcmp(device->model, "TIMER") == 0);
+  CHECK(device->confirmed);
+  Gm7CanProtocol::encodeModuleStatusAndProgress(buffer, 8, 5, 50, 100);
+  CHECK(registry.onFrame(makeId(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x1234), buffer, 8, 10));
+  CHECK(!registry.onFrame(makeId(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x1234), buffer, 8, 20)); //Unchanged
+  CHECK_EQUAL(5, device->lastStatus.status);
+  CHECK_EQUAL(50, device->lastStatus.progress);
+}
+
+static void testSnapshotRoundTrip(){
+  Gm7CanDeviceRegistry registry;
+  registerDevice(registry, 0x1234, 1111, "TIMER", 0);
+  registerDevice(registry, 0x2222, 2222, "LOCK", 0);
+  char snapshot[256];
+  uint16_t size = registry.saveSnapshot(snapshot, sizeof(snapshot));
+  CHECK_EQUAL(registry.getSnapshotSize(), size);
+  CHECK_EQUAL(CAN_DEVICE_REGISTRY_HEADER_BYTES + (2 * CAN_DEVICE_REGISTRY_ENTRY_BYTES), size);
+  CHECK(!registry.isDirty());
+  CHECK_EQUAL(0, registry.saveSnapshot(snapshot, size - 1));
+
+  Gm7CanDeviceRegistry restarted;
+  CHECK(restarted.loadSnapshot(snapshot, size, 1000, 3000));
+  CHECK_EQUAL(2, restarted.getDeviceCount());
+  CHECK_EQUAL(0, restarted.getDeviceCount(true)); //Nothing confirmed yet
+  CHECK(restarted.isConfirming());
+  const Gm7CanDeviceRegistry::Device * device = restarted.getDevice(0x2222);
+  CHECK(device != 0);
+  if(device != 0){
+    CHECK_EQUAL(2222, device->serialNumber);
+    CHECK(strcmp(device->model, "LOCK") == 0);
+  }
+
+  //Only 0x1234 sends a heartbeat within the confirm window
+  char buffer[8];
+  Gm7CanProtocol::encodeHeartbeat(buffer, 8, 100);
+  restarted.onFrame(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, 0x1234), buffer, 8, 2000);
+  CHECK_EQUAL(1, restarted.getDeviceCount(true));
+  restarted.update(3999);
+  CHECK_EQUAL(2, restarted.getDeviceCount());
+  restarted.update(4000);
+  CHECK(!restarted.isConfirming());
+  CHECK_EQUAL(1, restarted.getDeviceCount());
+  CHECK(restarted.getDevice(0x2222) == 0);
+  CHECK(restarted.isDirty());
+}
+
+//With implicit heartbeats a device may only send status frames; those confirm it as well
+static void testConfirmedByAnyFrame(){
+  Gm7CanDeviceRegistry registry;
+  registerDevice(registry, 0x1234, 1111, "TIMER", 0);
+  registerDevice(registry, 0x2222, 2222, "LOCK", 0);
+  char snapshot[256];
+  uint16_t size = registry.saveSnapshot(snapshot, sizeof(snapshot));
+  Gm7CanDeviceRegistry restarted;
+  CHECK(restarted.loadSnapshot(snapshot, size, 0, 3000));
+  char buffer[8];
+  Gm7CanProtocol::encodeModuleStatusAndProgress(buffer, 8, 0, 0, 0); //Same as the snapshot
+  CHECK(!restarted.onFrame(makeId(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x1234), buffer, 8, 1000));
+  Gm7CanProtocol::encodeSerialNumberToBuffer(buffer, 8, 2222);
+  CHECK(!restarted.onFrame(makeId(Gm7CanProtocol::DEVICE_SERIAL, 0x2222), buffer, 8, 1000)); //Known information changes nothing
+  CHECK(!restarted.isDirty());
+  CHECK_EQUAL(2, restarted.getDeviceCount(true));
+  restarted.update(3000);
+  CHECK_EQUAL(2, restarted.getDeviceCount());
+  CHECK(!restarted.isDirty());
+  Gm7CanProtocol::encodeModelToBuffer(buffer, 8, "DOOR");
+  CHECK(restarted.onFrame(makeId(Gm7CanProtocol::DEVICE_MODEL, 0x2222), buffer, 8, 4000));
+  CHECK(restarted.isDirty());
+}
+
+static void testRejectsDamagedSnapshots(){
+  Gm7CanDeviceRegistry registry;
+  registerDevice(registry, 0x1234, 1111, "TIMER", 0);
+  char snapshot[128];
+  uint16_t size = registry.saveSnapshot(snapshot, sizeof(snapshot));
+  Gm7CanDeviceRegistry other;
+  registerDevice(other, 0x0BAD, 9999, "KEEP", 0);
+
+  snapshot[CAN_DEVICE_REGISTRY_HEADER_BYTES + 5] ^= 0x01; //A flipped bit in an entry fails the CRC
+  CHECK(!other.loadSnapshot(snapshot, size, 0, 1000));
+  snapshot[CAN_DEVICE_REGISTRY_HEADER_BYTES + 5] ^= 0x01;
+  CHECK(!other.loadSnapshot(snapshot, size - 1, 0, 1000)); //Truncated
+  snapshot[4] = CAN_DEVICE_REGISTRY_SNAPSHOT_VERSION + 1;
+  CHECK(!other.loadSnapshot(snapshot, size, 0, 1000)); //Newer version
+  snapshot[4] = CAN_DEVICE_REGISTRY_SNAPSHOT_VERSION;
+  snapshot[0] = 'X';
+  CHECK(!other.loadSnapshot(snapshot, size, 0, 1000)); //Foreign data
+  //A rejected snapshot keeps the registry as it was
+  CHECK_EQUAL(1, other.getDeviceCount());
+  CHECK(other.getDevice(0x0BAD) != 0);
+  snapshot[0] = 'G';
+  CHECK(other.loadSnapshot(snapshot, size, 0, 1000));
+  CHECK(other.getDevice(0x1234) != 0);
+}
+
+int main(){
+  testLearnsDevices();
+  testSnapshotRoundTrip();
+  testConfirmedByAnyFrame();
+  testRejectsDamagedSnapshots();
+  return finishTests("Gm7CanDeviceRegistryTest");
+}
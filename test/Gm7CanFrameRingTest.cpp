@@ -0,0 +1,137 @@
+//Host tests for Gm7CanFrameRing.h, see Gm7CanTest.h for how to build and run them; add -pthread, the torn read test uses threads
+
+#include "Gm7CanTest.h"
+#include "Gm7CanFrameRing.h"
+#include <thread>
+
+//Every field of frame number count carries count, so a reader can tell a frame that was half overwritten
+static void publishCounted(Gm7CanFrameRing & ring, uint32_t count){
+  char payload[8];
+  Gm7CanProtocol::addUint32ToBuffer(payload, 8, count, 0);
+  Gm7CanProtocol::addUint32ToBuffer(payload, 8, count, 4);
+  Gm7CanProtocol::MessageId messageId = {(uint16_t)(count & 0x1FFF), (uint16_t)(count & 0xFFFF)};
+  ring.publish(messageId, payload, 8, count);
+}
+
+static bool isCounted(const Gm7CanFrameRing::Frame & frame, uint32_t count){
+  return frame.timestampMillis == count && frame.length == 8
+    && frame.messageId.pmid == (count & 0x1FFF) && frame.messageId.uid == (count & 0xFFFF)
+    && Gm7CanProtocol::extractUint32FromBuffer(frame.payload, 8, 0) == count
+    && Gm7CanProtocol::extractUint32FromBuffer(frame.payload, 8, 4) == count;
+}
+
+static void testReaders(){
+  static Gm7CanFrameRing ring;
+  Gm7CanFrameRing::Frame frame;
+  Gm7CanFrameRing::Cursor first = ring.createCursor();
+  CHECK(!ring.read(first, frame)); //Nothing published yet, not even the empty slots are returned
+  for(uint32_t i = 0; i < 5; i++){
+    publishCounted(ring, i);
+  }
+  Gm7CanFrameRing::Cursor late = ring.createCursor(); //Starts at the next frame
+  publishCounted(ring, 5);
+
+  CHECK_EQUAL(6, ring.available(first));
+  for(uint32_t i = 0; i < 6; i++){
+    CHECK(ring.read(first, frame));
+    CHECK(isCounted(frame, i));
+  }
+  CHECK(!ring.read(first, frame));
+  CHECK_EQUAL(0, first.skipped);
+
+  CHECK_EQUAL(1, ring.available(late));
+  CHECK(ring.read(late, frame));
+  CHECK(isCounted(frame, 5));
+  CHECK(!ring.read(late, frame));
+
+  //A long payload is cut to 8 bytes, a short one keeps its length
+  Gm7CanProtocol::MessageId messageId = {1, 2};
+  char payload[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  ring.publish(messageId, payload, 12, 0);
+  ring.publish(Gm7CanProtocol::createFrameFromBuffer(((uint32_t)3 << 16) | 4, payload, 3), 7);
+  CHECK(ring.read(first, frame));
+  CHECK_EQUAL(CAN_PAYLOAD_MESSAGE_BYTES, frame.length);
+  CHECK_EQUAL(8, frame.payload[7]);
+  CHECK(ring.read(first, frame));
+  CHECK_EQUAL(3, frame.messageId.pmid);
+  CHECK_EQUAL(4, frame.messageId.uid);
+  CHECK_EQUAL(3, frame.length);
+  CHECK_EQUAL(7, frame.timestampMillis);
+}
+
+static void testLapped(){
+  static Gm7CanFrameRing ring;
+  Gm7CanFrameRing::Frame frame;
+  Gm7CanFrameRing::Cursor cursor = ring.createCursor();
+  for(uint32_t i = 0; i < CAN_FRAME_RING_SIZE + 5; i++){
+    publishCounted(ring, i);
+  }
+  CHECK_EQUAL(CAN_FRAME_RING_SIZE, ring.available(cursor));
+  //The oldest 5 are gone, the reader continues with the oldest one left
+  for(uint32_t i = 5; i < CAN_FRAME_RING_SIZE + 5; i++){
+    CHECK(ring.read(cursor, frame));
+    CHECK(isCounted(frame, i));
+  }
+  CHECK_EQUAL(5, cursor.skipped);
+  CHECK(!ring.read(cursor, frame));
+
+  //Lapped many times over
+  for(uint32_t i = 0; i < CAN_FRAME_RING_SIZE * 10; i++){
+    publishCounted(ring, CAN_FRAME_RING_SIZE + 5 + i);
+  }
+  uint32_t read = 0;
+  while(ring.read(cursor, frame)){
+    read++;
+  }
+  CHECK_EQUAL(CAN_FRAME_RING_SIZE, read);
+  CHECK_EQUAL(5 + (CAN_FRAME_RING_SIZE * 9), cursor.skipped);
+  CHECK(isCounted(frame, (CAN_FRAME_RING_SIZE * 11) + 4));
+}
+
+//One writer publishes as fast as it can, two readers check that every frame they get is whole and in order,
+//and that every frame was either read or counted as skipped.
+static void testTornReads(){
+  static Gm7CanFrameRing ring;
+  const uint32_t frames = 200000;
+  Gm7CanFrameRing::Cursor cursors[2] = {ring.createCursor(), ring.createCursor()};
+  uint32_t read[2] = {0, 0};
+  uint32_t broken[2] = {0, 0};
+  std::thread readers[2];
+  for(uint8_t r = 0; r < 2; r++){
+    readers[r] = std::thread([&, r](){
+      Gm7CanFrameRing::Frame frame;
+      while(cursors[r].next < frames){
+        if(!ring.read(cursors[r], frame)){
+          std::this_thread::yield();
+          continue;
+        }
+        read[r]++;
+        if(!isCounted(frame, cursors[r].next - 1)){
+          broken[r]++;
+        }
+      }
+    });
+  }
+  std::thread writer([&](){
+    for(uint32_t i = 0; i < frames; i++){
+      publishCounted(ring, i);
+      if((i % 1000) == 0){
+        std::this_thread::yield(); //Give the readers a chance on a single core too
+      }
+    }
+  });
+  writer.join();
+  for(uint8_t r = 0; r < 2; r++){
+    readers[r].join();
+    CHECK_EQUAL(0, broken[r]);
+    CHECK_EQUAL(frames, read[r] + cursors[r].skipped);
+    CHECK(read[r] > 0); //The last frames are never overwritten
+  }
+}
+
+int main(){
+  testReaders();
+  testLapped();
+  testTornReads();
+  return finishTests("Gm7CanFrameRingTest");
+}
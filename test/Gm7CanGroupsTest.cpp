@@ -0,0 +1,91 @@
+//Host tests for the group codecs in Gm7CanProtocol.h and for Gm7CanGroups.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanGroups.h"
+
+static void testSlotAssignCodec(){
+  char buffer[8];
+  CHECK(Gm7CanProtocol::encodeGroupSlotAssign(buffer, 8, 0xBEEF, 47));
+  CHECK_EQUAL(0xBE, (uint8_t)buffer[0]);
+  CHECK_EQUAL(0xEF, (uint8_t)buffer[1]);
+  CHECK_EQUAL(47, (uint8_t)buffer[2]);
+  Gm7CanProtocol::GroupSlotAssign assign = Gm7CanProtocol::decodeGroupSlotAssign(buffer, 8);
+  CHECK_EQUAL(0xBEEF, assign.targetUid);
+  CHECK_EQUAL(47, assign.slot);
+  CHECK(Gm7CanProtocol::encodeGroupSlotAssign(buffer, 8, 0xBEEF, Gm7CanProtocol::GROUP_SLOT_NONE));
+  CHECK(!Gm7CanProtocol::encodeGroupSlotAssign(buffer, 8, 0xBEEF, Gm7CanProtocol::GROUP_SLOTS));
+  CHECK(!Gm7CanProtocol::encodeGroupSlotAssign(buffer, 2, 0xBEEF, 1));
+  buffer[2] = 60; //Out of range slots decode as no slot
+  CHECK_EQUAL(Gm7CanProtocol::GROUP_SLOT_NONE, Gm7CanProtocol::decodeGroupSlotAssign(buffer, 8).slot);
+  CHECK_EQUAL(Gm7CanProtocol::GROUP_SLOT_NONE, Gm7CanProtocol::decodeGroupSlotAssign(buffer, 2).slot);
+}
+
+static void testStatusChangeCodec(){
+  char buffer[8];
+  uint64_t bitmap = ((uint64_t)1 << 47) | ((uint64_t)1 << 8) | 1;
+  CHECK(Gm7CanProtocol::encodeGroupStatusChange(buffer, 8, bitmap, 0x1234));
+  Gm7CanProtocol::GroupStatusChange change = Gm7CanProtocol::decodeGroupStatusChange(buffer, 8);
+  CHECK_EQUAL(bitmap, change.slotBitmap);
+  CHECK_EQUAL(0x1234, change.status);
+  CHECK(Gm7CanProtocol::isGroupTarget(buffer, 8, 0));
+  CHECK(Gm7CanProtocol::isGroupTarget(buffer, 8, 8));
+  CHECK(Gm7CanProtocol::isGroupTarget(buffer, 8, 47));
+  CHECK(!Gm7CanProtocol::isGroupTarget(buffer, 8, 1));
+  CHECK(!Gm7CanProtocol::isGroupTarget(buffer, 8, 46));
+  CHECK(!Gm7CanProtocol::isGroupTarget(buffer, 8, Gm7CanProtocol::GROUP_SLOT_NONE));
+  CHECK(!Gm7CanProtocol::isGroupTarget(buffer, 5, 0));
+  //Statuses above 16 bits are rejected, not cut off
+  CHECK(Gm7CanProtocol::encodeGroupStatusChange(buffer, 8, bitmap, Gm7CanProtocol::GROUP_STATUS_MAX));
+  CHECK(!Gm7CanProtocol::encodeGroupStatusChange(buffer, 8, bitmap, Gm7CanProtocol::GROUP_STATUS_MAX + 1));
+  CHECK(!Gm7CanProtocol::encodeGroupStatusChange(buffer, 7, bitmap, 1));
+  //Bits above slot 47 do not leak into the status
+  CHECK(Gm7CanProtocol::encodeGroupStatusChange(buffer, 8, ~(uint64_t)0, 0));
+  CHECK_EQUAL(0, Gm7CanProtocol::decodeGroupStatusChange(buffer, 8).status);
+}
+
+static void testAllocator(){
+  Gm7CanGroupAllocator allocator;
+  CHECK_EQUAL(0, allocator.assign(100));
+  CHECK_EQUAL(1, allocator.assign(200));
+  CHECK_EQUAL(0, allocator.assign(100)); //Same slot again
+  CHECK(allocator.release(100));
+  CHECK(!allocator.release(100));
+  CHECK_EQUAL(0, allocator.assign(300)); //Reuses the free slot
+  for(uint16_t uid = 1000; uid < 1000 + Gm7CanProtocol::GROUP_SLOTS - 2; uid++){
+    CHECK(allocator.assign(uid) != Gm7CanProtocol::GROUP_SLOT_NONE);
+  }
+  CHECK_EQUAL(Gm7CanProtocol::GROUP_SLOT_NONE, allocator.assign(5000));
+  uint16_t uid = 0;
+  CHECK(allocator.getUidAt(1, uid));
+  CHECK_EQUAL(200, uid);
+  uint16_t targets[3] = {200, 300, 5000};
+  uint8_t missing;
+  CHECK_EQUAL(3, allocator.getBitmap(targets, 3, &missing));
+  CHECK_EQUAL(1, missing);
+}
+
+static void testMember(){
+  Gm7CanGroupMember member(0x0042);
+  char buffer[8];
+  uint32_t assignId = (uint32_t)Gm7CanProtocol::REQUEST_GROUP_SLOT_ASSIGN << 16;
+  Gm7CanProtocol::encodeGroupSlotAssign(buffer, 8, 0x0043, 5);
+  CHECK(!member.onFrame(assignId, buffer, 3)); //Someone else
+  CHECK_EQUAL(Gm7CanProtocol::GROUP_SLOT_NONE, member.getSlot());
+  Gm7CanProtocol::encodeGroupSlotAssign(buffer, 8, 0x0042, 5);
+  CHECK(member.onFrame(assignId, buffer, 3));
+  CHECK_EQUAL(5, member.getSlot());
+  uint32_t groupId = (uint32_t)Gm7CanProtocol::REQUEST_GROUP_STATUS_CHANGE << 16;
+  Gm7CanProtocol::encodeGroupStatusChange(buffer, 8, (uint64_t)1 << 5, 7);
+  CHECK(member.isTarget(groupId, buffer, 8));
+  CHECK(!member.isTarget((uint32_t)Gm7CanProtocol::REQUEST_ALL_GPIO << 16, buffer, 8)); //Not a group request
+  Gm7CanProtocol::encodeGroupStatusChange(buffer, 8, (uint64_t)1 << 6, 7);
+  CHECK(!member.isTarget(groupId, buffer, 8));
+}
+
+int main(){
+  testSlotAssignCodec();
+  testStatusChangeCodec();
+  testAllocator();
+  testMember();
+  return finishTests("Gm7CanGroupsTest");
+}
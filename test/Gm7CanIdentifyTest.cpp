@@ -0,0 +1,155 @@
+//Host tests for the identify codec in Gm7CanProtocol.h and for Gm7CanIdentify.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanIdentify.h"
+
+static void testRequestCodec(){
+  char buffer[8];
+  CHECK(Gm7CanProtocol::encodeIdentifyRequest(buffer, 8, 40, 0x1234, 7));
+  Gm7CanProtocol::IdentifyRequest request = Gm7CanProtocol::decodeIdentifyRequest(buffer, 8);
+  CHECK_EQUAL(40, request.nodeCountHint);
+  CHECK_EQUAL(0x1234, request.slotMillis);
+  CHECK_EQUAL(7, request.round);
+  CHECK(!Gm7CanProtocol::encodeIdentifyRequest(buffer, 3, 40, 20, 1));
+  CHECK_EQUAL(0, Gm7CanProtocol::decodeIdentifyRequest(buffer, 3).slotMillis);
+}
+
+static void testSlots(){
+  CHECK_EQUAL(1, Gm7CanProtocol::getIdentifySlotCount(0));
+  CHECK_EQUAL(2, Gm7CanProtocol::getIdentifySlotCount(1));
+  CHECK_EQUAL(32, Gm7CanProtocol::getIdentifySlotCount(10));
+  CHECK_EQUAL(32, Gm7CanProtocol::getIdentifySlotCount(16));
+  CHECK_EQUAL(Gm7CanProtocol::IDENTIFY_SLOTS_MAX, Gm7CanProtocol::getIdentifySlotCount(255));
+  CHECK_EQUAL(685, Gm7CanProtocol::getIdentifyDurationMillis(10, 20)); //Last slot at 620, 50 frames of 1.28 ms and a poll
+  CHECK_EQUAL(640, Gm7CanProtocol::getIdentifyDurationMillis(10, 20, 0));        //Without a baudrate only the slots count
+  CHECK_EQUAL(20, Gm7CanProtocol::getIdentifyDurationMillis(0, 20));
+  CHECK_EQUAL(5110 + 204 + 1, Gm7CanProtocol::getIdentifyDurationMillis(255, 10, 1000000));
+  for(uint32_t uid = 0; uid <= 0xFFFF; uid++){
+    if(Gm7CanProtocol::getIdentifySlot(uid, 32) >= 32){
+      CHECK(false);
+      break;
+    }
+  }
+  //Sequential UID's are spread over the slots
+  uint8_t used[32] = {0};
+  for(uint16_t uid = 0x0100; uid < 0x0110; uid++){
+    used[Gm7CanProtocol::getIdentifySlot(uid, 32)]++;
+  }
+  uint8_t busiest = 0;
+  for(uint8_t slot = 0; slot < 32; slot++){
+    busiest = used[slot] > busiest ? used[slot] : busiest;
+  }
+  CHECK(busiest <= 2);
+}
+
+static void testRound(){
+  Gm7CanIdentifyRound round;
+  char request[8];
+  uint16_t pmid;
+  CHECK(round.begin(1000, pmid, request, 8, 10, 20));
+  CHECK_EQUAL(Gm7CanProtocol::REQUEST_ALL_IDENTIFY, pmid);
+  CHECK_EQUAL(1, round.getRound());
+  CHECK_EQUAL(685, round.getDurationMillis());
+
+  const uint8_t devices = 10;
+  Gm7CanIdentifyResponder * responders[devices];
+  uint8_t frames[devices] = {0};
+  for(uint8_t i = 0; i < devices; i++){
+    responders[i] = new Gm7CanIdentifyResponder(0x0200 + (i * 7), 5000 + i, Gm7CanProtocol::DEVICE_TYPE_MODULE_GENERIC_RO, "MODEL", i % 2 ? "GM7" : 0);
+    CHECK(responders[i]->onFrame((uint32_t)pmid << 16, request, 8, 1000));
+  }
+  CHECK(!responders[0]->onFrame((uint32_t)pmid << 16, request, 8, 1001)); //A resent request of the same round is ignored
+
+  uint32_t lastFrameMillis = 0;
+  for(uint32_t now = 1000; now < 3000; now++){
+    for(uint8_t i = 0; i < devices; i++){
+      char buffer[8];
+      uint16_t framePmid;
+      while(responders[i]->poll(now, framePmid, buffer, 8)){
+        if(frames[i] == 0){
+          CHECK_EQUAL(Gm7CanProtocol::DEVICE_TYPE_ID, framePmid);
+          CHECK_EQUAL(Gm7CanProtocol::DEVICE_TYPE_MODULE_GENERIC_RO, Gm7CanProtocol::extractDeviceTypeIdFromBuffer(buffer, 8));
+        }
+        if(framePmid == Gm7CanProtocol::DEVICE_SERIAL){
+          CHECK_EQUAL(5000 + i, Gm7CanProtocol::extractSerialNumberFromBuffer(buffer, 8));
+        }
+        frames[i]++;
+        lastFrameMillis = now;
+      }
+    }
+  }
+  for(uint8_t i = 0; i < devices; i++){
+    CHECK_EQUAL(i % 2 ? 4 : 3, frames[i]); //Type id, serial, model, and the vendor when there is one
+    CHECK(!responders[i]->isPending());
+  }
+  CHECK(lastFrameMillis < 1000 + round.getDurationMillis());
+  CHECK(round.isRunning(1000 + round.getDurationMillis() - 1));
+  CHECK(round.isComplete(1000 + round.getDurationMillis()));
+
+  //A new round is answered again
+  CHECK(round.begin(5000, pmid, request, 8, 10, 20));
+  CHECK_EQUAL(2, round.getRound());
+  CHECK(responders[0]->onFrame((uint32_t)pmid << 16, request, 8, 5000));
+  for(uint8_t i = 0; i < devices; i++){
+    delete responders[i];
+  }
+}
+
+//Every device in the last slot: the frames queue up on the bus, the last one must still be sent within the duration
+static void testCrowdedLastSlot(){
+  const uint8_t devices = 10;
+  const uint16_t slotCount = Gm7CanProtocol::getIdentifySlotCount(devices);
+  const uint32_t frameMicros = (Gm7CanProtocol::IDENTIFY_FRAME_BITS * 1000000UL) / 125000;
+  Gm7CanIdentifyResponder * responders[devices];
+  uint8_t found = 0;
+  for(uint32_t uid = 0; uid <= 0xFFFF && found < devices; uid++){
+    if(Gm7CanProtocol::getIdentifySlot(uid, slotCount) == slotCount - 1){
+      responders[found++] = new Gm7CanIdentifyResponder(uid, uid, Gm7CanProtocol::DEVICE_TYPE_MODULE_GENERIC_RO, "MODEL", "GM7", "NAME");
+    }
+  }
+  CHECK_EQUAL(devices, found);
+  Gm7CanIdentifyRound round;
+  char request[8];
+  uint16_t pmid;
+  round.begin(0, pmid, request, 8, devices, 20);
+  for(uint8_t i = 0; i < devices; i++){
+    responders[i]->onFrame((uint32_t)pmid << 16, request, 8, 0);
+  }
+  //Every millisecond each device queues what poll() gives it; the bus sends the queued frames one after the other, frameMicros each
+  uint32_t queued = 0;
+  uint32_t sent = 0;
+  uint32_t busFreeMicros = 0;
+  uint32_t lastSentMicros = 0;
+  for(uint32_t now = 0; now < 2000 && sent < devices * Gm7CanProtocol::IDENTIFY_FRAMES_PER_DEVICE; now++){
+    char buffer[8];
+    uint16_t framePmid;
+    for(uint8_t i = 0; i < devices; i++){
+      if(responders[i]->poll(now, framePmid, buffer, 8)){ //A device hands one frame to its controller per loop
+        queued++;
+      }
+    }
+    if(busFreeMicros < now * 1000){
+      busFreeMicros = now * 1000;
+    }
+    while(queued > 0 && busFreeMicros < (now + 1) * 1000){ //Frames start within this millisecond and end when they end
+      busFreeMicros += frameMicros;
+      lastSentMicros = busFreeMicros;
+      queued--;
+      sent++;
+    }
+  }
+  CHECK_EQUAL(devices * Gm7CanProtocol::IDENTIFY_FRAMES_PER_DEVICE, sent);
+  CHECK(lastSentMicros > (slotCount * 20 * 1000)); //Runs past the end of the last slot
+  CHECK(lastSentMicros <= round.getDurationMillis() * 1000);
+  for(uint8_t i = 0; i < devices; i++){
+    delete responders[i];
+  }
+}
+
+int main(){
+  testRequestCodec();
+  testSlots();
+  testRound();
+  testCrowdedLastSlot();
+  return finishTests("Gm7CanIdentifyTest");
+}
@@ -0,0 +1,89 @@
+//Host tests for Gm7CanMetrics.h, see Gm7CanTest.h for how to build and run them
+
+#define GM7_CAN_METRICS
+#include "Gm7CanTest.h"
+#include "Gm7CanMetrics.h"
+
+static uint32_t makeId(uint16_t pmid, uint16_t uid){
+  return ((uint32_t)pmid << 16) | uid;
+}
+
+static void testSections(){
+  Gm7CanMetrics metrics;
+  metrics.recordReceived(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, 1), 8, 100);
+  metrics.recordReceived(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, 2), 8, 103);
+  metrics.recordSent(makeId(Gm7CanProtocol::REQUEST_STATUS_CHANGE, 1), 7);
+  metrics.recordDropped(makeId(Gm7CanProtocol::REQUEST_STATUS_CHANGE, 1));
+  Gm7CanMetrics::SectionCounters counters;
+  CHECK(metrics.copySection(Gm7CanMetrics::SECTION_HEARTBEAT, counters));
+  CHECK_EQUAL(2, counters.receivedFrames);
+  CHECK_EQUAL(16, counters.receivedBytes);
+  CHECK_EQUAL(1, counters.interArrival[Gm7CanMetrics::getHistogramBucket(3)]);
+  CHECK(metrics.copySection(Gm7CanMetrics::SECTION_REQUEST, counters));
+  CHECK_EQUAL(1, counters.sentFrames);
+  CHECK_EQUAL(1, counters.droppedFrames);
+  CHECK(!metrics.copySection(Gm7CanMetrics::SECTION_COUNT, counters));
+  CHECK_EQUAL(0, Gm7CanMetrics::getHistogramBucket(0));
+  CHECK_EQUAL(1, Gm7CanMetrics::getHistogramBucket(1));
+  CHECK_EQUAL(2, Gm7CanMetrics::getHistogramBucket(3));
+  CHECK_EQUAL(CAN_METRICS_HISTOGRAM_BUCKETS - 1, Gm7CanMetrics::getHistogramBucket(0xFFFFFFFF));
+}
+
+//Far more UID's than slots, with one of them flooding the bus: it must be in the table with a count close to the truth
+static void testFindsFlooder(){
+  Gm7CanMetrics metrics;
+  const uint16_t flooder = 0x0F00;
+  uint32_t flooderFrames = 0;
+  uint32_t now = 0;
+  for(uint16_t round = 0; round < 20; round++){
+    for(uint16_t uid = 0x0100; uid < 0x0100 + (4 * CAN_METRICS_UID_SLOTS); uid++){
+      metrics.recordReceived(makeId(Gm7CanProtocol::STATUS_MODULE, uid), 8, now++);
+      if(uid % 4 == 0){
+        metrics.recordReceived(makeId(Gm7CanProtocol::STATUS_MODULE, flooder), 8, now++);
+        flooderFrames++;
+      }
+    }
+  }
+  CHECK(metrics.getUidEvictions() > 0);
+  Gm7CanMetrics::UidCounters counters;
+  CHECK(metrics.copyUid(flooder, counters));
+  CHECK(counters.receivedFrames >= flooderFrames);
+  CHECK(counters.receivedFrames - counters.overcountFrames <= flooderFrames);
+  CHECK(counters.receivedFrames - counters.overcountFrames >= flooderFrames / 2);
+  //And it is the busiest UID of the table
+  uint32_t busiest = 0;
+  uint16_t busiestUid = 0;
+  for(uint8_t slot = 0; slot < CAN_METRICS_UID_SLOTS; slot++){
+    if(metrics.copyUidSlot(slot, counters) && counters.receivedFrames > busiest){
+      busiest = counters.receivedFrames;
+      busiestUid = counters.uid;
+    }
+  }
+  CHECK_EQUAL(flooder, busiestUid);
+}
+
+static void testFewUids(){
+  Gm7CanMetrics metrics;
+  for(uint16_t uid = 1; uid <= CAN_METRICS_UID_SLOTS; uid++){
+    metrics.recordReceived(makeId(Gm7CanProtocol::STATUS_MODULE, uid), 4, uid);
+    metrics.recordError(makeId(Gm7CanProtocol::STATUS_MODULE, uid));
+  }
+  CHECK_EQUAL(0, metrics.getUidEvictions()); //Exact counts while every UID fits
+  Gm7CanMetrics::UidCounters counters;
+  for(uint16_t uid = 1; uid <= CAN_METRICS_UID_SLOTS; uid++){
+    CHECK(metrics.copyUid(uid, counters));
+    CHECK_EQUAL(1, counters.receivedFrames);
+    CHECK_EQUAL(0, counters.overcountFrames);
+    CHECK_EQUAL(1, counters.errors);
+  }
+  metrics.recordError(makeId(Gm7CanProtocol::STATUS_MODULE, 999)); //Errors do not add UID's
+  CHECK(!metrics.copyUid(999, counters));
+  CHECK_EQUAL(0, metrics.getUidEvictions());
+}
+
+int main(){
+  testSections();
+  testFindsFlooder();
+  testFewUids();
+  return finishTests("Gm7CanMetricsTest");
+}
@@ -0,0 +1,107 @@
+//Host tests for the online bitmap codec in Gm7CanProtocol.h and for Gm7CanOnlineMap.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanOnlineMap.h"
+
+static uint32_t makeId(uint16_t pmid, uint16_t uid){
+  return ((uint32_t)pmid << 16) | uid;
+}
+
+static void testBitmapCodec(){
+  char buffer[8];
+  uint64_t bitmap = ((uint64_t)1 << 55) | 0x8001;
+  CHECK(Gm7CanProtocol::encodeOnlineBitmap(buffer, 8, 3, bitmap));
+  CHECK_EQUAL(3, (uint8_t)buffer[0]);
+  CHECK_EQUAL(0x01, (uint8_t)buffer[7]); //Slot 0 is the lowest bit of the last byte
+  Gm7CanProtocol::OnlineBitmap online = Gm7CanProtocol::decodeOnlineBitmap(buffer, 8);
+  CHECK_EQUAL(3, online.page);
+  CHECK_EQUAL(bitmap, online.bitmap);
+  CHECK(Gm7CanProtocol::encodeOnlineBitmap(buffer, 8, 0, ~(uint64_t)0)); //Bits above 56 do not overwrite the page
+  CHECK_EQUAL(0, Gm7CanProtocol::decodeOnlineBitmap(buffer, 8).page);
+  CHECK(!Gm7CanProtocol::encodeOnlineBitmap(buffer, 7, 0, 1));
+  CHECK_EQUAL(0, Gm7CanProtocol::decodeOnlineBitmap(buffer, 7).bitmap);
+}
+
+//Runs a controller for durationMillis with heartbeats of onlineUids, handing every frame it sends to the map.
+//The frames first pass the fast reject of a module with UID 12, as they would in its receive interrupt.
+static void runController(Gm7CanOnlineBroadcaster & broadcaster, Gm7CanLivenessTracker & tracker, Gm7CanOnlineMap & map,
+  const uint16_t * onlineUids, uint8_t count, uint32_t fromMillis, uint32_t toMillis, uint16_t & assignments){
+  char buffer[8];
+  uint16_t pmid;
+  for(uint32_t now = fromMillis; now < toMillis; now += 10){
+    for(uint8_t i = 0; i < count; i++){
+      tracker.onFrame(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, onlineUids[i]), now);
+    }
+    while(broadcaster.poll(now, pmid, buffer, 8)){
+      if(pmid == Gm7CanProtocol::REQUEST_GROUP_SLOT_ASSIGN){
+        assignments++;
+      }
+      if(!Gm7CanProtocol::isAddressedToOtherDevice(makeId(pmid, 1), buffer, 8, 12)){
+        map.onFrame(makeId(pmid, 1), buffer, 8, now);
+      }
+    }
+  }
+}
+
+static void testLateModuleLearnsSlots(){
+  Gm7CanProtocol protocol;
+  Gm7CanLivenessTracker tracker(protocol);
+  Gm7CanGroupAllocator allocator;
+  Gm7CanOnlineBroadcaster broadcaster(tracker, allocator, 1000, 250);
+  for(uint16_t uid = 10; uid < 15; uid++){
+    allocator.assign(uid);
+  }
+  //The map starts after the assignments were made, it only learns them from the repeats
+  Gm7CanOnlineMap map(2500);
+  uint16_t online[2] = {11, 13};
+  uint16_t assignments = 0;
+  runController(broadcaster, tracker, map, online, 2, 0, 3000, assignments);
+  CHECK(assignments >= 5);
+  CHECK(map.isFresh(2990));
+  CHECK(!map.isOnline(10, 2990));
+  CHECK(map.isOnline(11, 2990));
+  CHECK(!map.isOnline(12, 2990));
+  CHECK(map.isOnline(13, 2990));
+  CHECK(!map.isOnline(99, 2990));
+  CHECK_EQUAL(2, map.getOnlineCount(2990));
+  CHECK(!map.isOnline(11, 2990 + 3000)); //Stale without new bitmaps
+  CHECK_EQUAL(0, map.getOnlineCount(2990 + 3000));
+}
+
+static void testReassignedSlot(){
+  Gm7CanOnlineMap map;
+  char buffer[8];
+  uint32_t assignId = makeId(Gm7CanProtocol::REQUEST_GROUP_SLOT_ASSIGN, 1);
+  Gm7CanProtocol::encodeGroupSlotAssign(buffer, 8, 20, 0);
+  map.onFrame(assignId, buffer, 3, 0);
+  Gm7CanProtocol::encodeGroupSlotAssign(buffer, 8, 20, 4); //A restarted controller moved UID 20 to slot 4
+  map.onFrame(assignId, buffer, 3, 0);
+  Gm7CanProtocol::encodeOnlineBitmap(buffer, 8, 0, 1); //Only slot 0 online
+  map.onFrame(makeId(Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP, 1), buffer, 8, 0);
+  CHECK(!map.isOnline(20, 0));
+  Gm7CanProtocol::encodeOnlineBitmap(buffer, 8, 0, 1 << 4);
+  map.onFrame(makeId(Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP, 1), buffer, 8, 0);
+  CHECK(map.isOnline(20, 0));
+  CHECK(map.isSlotOnline(4, 0));
+}
+
+static void testRepeatsCanBeTurnedOff(){
+  Gm7CanProtocol protocol;
+  Gm7CanLivenessTracker tracker(protocol);
+  Gm7CanGroupAllocator allocator;
+  Gm7CanOnlineBroadcaster broadcaster(tracker, allocator, 1000, 0);
+  allocator.assign(10);
+  Gm7CanOnlineMap map;
+  uint16_t online[1] = {10};
+  uint16_t assignments = 0;
+  runController(broadcaster, tracker, map, online, 1, 0, 3000, assignments);
+  CHECK_EQUAL(0, assignments);
+}
+
+int main(){
+  testBitmapCodec();
+  testLateModuleLearnsSlots();
+  testReassignedSlot();
+  testRepeatsCanBeTurnedOff();
+  return finishTests("Gm7CanOnlineMapTest");
+}
@@ -0,0 +1,91 @@
+//Host tests for Gm7CanPmidIndex.h, see Gm7CanTest.h for how to build and run them; run it from the root of the library, it reads Gm7CanProtocol.h
+
+#include "Gm7CanTest.h"
+#include "Gm7CanPmidIndex.h"
+
+//Both directions are usable at compile time
+static_assert(Gm7CanPmidIndex::getPmid(Gm7CanPmidIndex::getIndex(Gm7CanProtocol::MODULE_TRIES)) == Gm7CanProtocol::MODULE_TRIES, "constexpr round trip");
+static_assert(Gm7CanPmidIndex::getIndex(Gm7CanProtocol::MODULE_SECTION_START) == Gm7CanPmidIndex::NOT_CATALOGUED, "section bounds are not PMID's");
+
+static uint8_t getLabel(uint16_t pmid){
+  switch(Gm7CanPmidIndex::getIndex(pmid)){
+    case Gm7CanPmidIndex::getIndex(Gm7CanProtocol::HEARTBEAT_MODULE):
+      return 1;
+    case Gm7CanPmidIndex::INDEX_RESPONSE_ACK:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+static void testRoundTrip(){
+  CHECK(Gm7CanPmidIndex::PMID_COUNT > 0);
+  for(uint16_t index = 0; index < Gm7CanPmidIndex::PMID_COUNT; index++){
+    uint16_t pmid = Gm7CanPmidIndex::getPmid(index);
+    CHECK(pmid != 0);
+    CHECK(pmid < 0x2000); //13 bits
+    CHECK_EQUAL(index, Gm7CanPmidIndex::getIndex(pmid));
+    CHECK(Gm7CanPmidIndex::isCatalogued(pmid));
+  }
+  CHECK_EQUAL(0, Gm7CanPmidIndex::getPmid(Gm7CanPmidIndex::PMID_COUNT));
+  CHECK_EQUAL(0, Gm7CanPmidIndex::getPmid(0xFFFF));
+  CHECK_EQUAL(Gm7CanPmidIndex::INDEX_CONTROLLER_ONLINE_BITMAP, Gm7CanPmidIndex::getIndex(Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP));
+  CHECK_EQUAL(1, getLabel(Gm7CanProtocol::HEARTBEAT_MODULE));
+  CHECK_EQUAL(2, getLabel(Gm7CanProtocol::RESPONSE_ACK));
+  CHECK_EQUAL(0, getLabel(Gm7CanProtocol::HEARTBEAT_CONTROLLER));
+
+  //Every 13-bit value is either catalogued once or not at all
+  uint16_t catalogued = 0;
+  for(uint16_t pmid = 0; pmid < 0x2000; pmid++){
+    if(Gm7CanPmidIndex::isCatalogued(pmid)){
+      catalogued++;
+    }
+  }
+  CHECK_EQUAL(Gm7CanPmidIndex::PMID_COUNT, catalogued);
+  CHECK(!Gm7CanPmidIndex::isCatalogued(Gm7CanProtocol::HEARTBEATS_START));
+  CHECK(!Gm7CanPmidIndex::isCatalogued(Gm7CanProtocol::REQUEST_ADDRESSED_FILTER_END));
+}
+
+//GM7_CAN_PMID_LIST must name every PMID of the PMID SECTION of Gm7CanProtocol.h.
+//Reads the header and looks up the value of every constant in it that is not a _START or _END bound.
+static void testListComplete(){
+  FILE * file = fopen("Gm7CanProtocol.h", "r");
+  CHECK(file != 0);
+  if(file == 0){
+    return;
+  }
+  char line[512];
+  bool inSection = false;
+  uint16_t found = 0;
+  while(fgets(line, sizeof(line), file) != 0){
+    if(strstr(line, "PMID SECTION") != 0){
+      inSection = true;
+    }
+    const char * constant = inSection ? strstr(line, "static const uint16_t ") : 0;
+    if(constant == 0){
+      continue;
+    }
+    char name[64];
+    unsigned int value;
+    if(sscanf(constant, "static const uint16_t %63[A-Z0-9_] = %u", name, &value) != 2){
+      continue;
+    }
+    size_t length = strlen(name);
+    if((length > 6 && strcmp(name + length - 6, "_START") == 0) || (length > 4 && strcmp(name + length - 4, "_END") == 0)){
+      continue;
+    }
+    found++;
+    if(!Gm7CanPmidIndex::isCatalogued(value)){
+      printf("%s (%u) is missing from GM7_CAN_PMID_LIST\n", name, value);
+      CHECK(false);
+    }
+  }
+  fclose(file);
+  CHECK_EQUAL(Gm7CanPmidIndex::PMID_COUNT, found);
+}
+
+int main(){
+  testRoundTrip();
+  testListComplete();
+  return finishTests("Gm7CanPmidIndexTest");
+}
@@ -0,0 +1,114 @@
+//Host tests for Gm7CanRequestTracker.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanRequestTracker.h"
+
+static uint8_t completions = 0;
+static bool lastAcked = false;
+static uint8_t lastResult = 0;
+
+static void onCompleted(uint16_t, uint16_t, uint8_t, bool acked, uint8_t result){
+  completions++;
+  lastAcked = acked;
+  lastResult = result;
+}
+
+static Gm7CanProtocol::Ack makeAck(uint16_t requesterUid, uint16_t pmid, uint8_t sequence, uint8_t result){
+  Gm7CanProtocol::Ack ack = {requesterUid, pmid, sequence, result};
+  return ack;
+}
+
+static void testAckAndRetries(){
+  completions = 0;
+  Gm7CanRequestTracker tracker(0x0001, 50, 3);
+  tracker.setCallback(onCompleted);
+  uint16_t pmid;
+  char buffer[8];
+  CHECK(tracker.sendStatusChange(0x0042, 7, 0, pmid, buffer, 8));
+  CHECK_EQUAL(Gm7CanProtocol::REQUEST_STATUS_CHANGE, pmid);
+  uint8_t sequence = buffer[6];
+  CHECK(sequence != 0);
+  CHECK(!tracker.poll(49, pmid, buffer, 8));
+  CHECK(tracker.poll(50, pmid, buffer, 8));  //Second attempt, next timeout 100
+  CHECK(!tracker.poll(149, pmid, buffer, 8));
+  CHECK(tracker.poll(150, pmid, buffer, 8)); //Third attempt
+  CHECK(!tracker.onAck(0x0043, makeAck(0x0001, Gm7CanProtocol::REQUEST_STATUS_CHANGE, sequence, 0))); //Other device
+  CHECK(tracker.onAck(0x0042, makeAck(0x0001, Gm7CanProtocol::REQUEST_STATUS_CHANGE, sequence, 200)));
+  CHECK_EQUAL(1, completions);
+  CHECK(lastAcked);
+  CHECK_EQUAL(200, lastResult);
+  CHECK_EQUAL(0, tracker.getPendingCount());
+}
+
+static void testTimeout(){
+  completions = 0;
+  Gm7CanRequestTracker tracker(0x0001, 50, 2);
+  tracker.setCallback(onCompleted);
+  uint16_t pmid;
+  char buffer[8];
+  CHECK(tracker.sendProgressSet(0x0042, 1, 2, 0, pmid, buffer, 8));
+  CHECK(tracker.poll(50, pmid, buffer, 8));
+  CHECK(!tracker.poll(150, pmid, buffer, 8));
+  CHECK_EQUAL(1, completions);
+  CHECK(!lastAcked);
+}
+
+//A too short buffer is a mistake of the caller, not a timeout of the network
+static void testShortBufferKeepsRequest(){
+  completions = 0;
+  Gm7CanRequestTracker tracker(0x0001, 50, 4);
+  tracker.setCallback(onCompleted);
+  uint16_t pmid;
+  char buffer[8];
+  CHECK(tracker.sendStatusChange(0x0042, 7, 0, pmid, buffer, 8));
+  CHECK(!tracker.poll(1000, pmid, buffer, 4));
+  CHECK_EQUAL(0, completions);
+  CHECK_EQUAL(1, tracker.getPendingCount());
+  CHECK(tracker.poll(1000, pmid, buffer, 8));
+}
+
+//With many attempts the backoff saturates instead of shifting past 32 bits
+static void testBackoffSaturates(){
+  completions = 0;
+  Gm7CanRequestTracker tracker(0x0001, 1000, 255);
+  tracker.setCallback(onCompleted);
+  uint16_t pmid;
+  char buffer[8];
+  CHECK(tracker.sendStatusChange(0x0042, 7, 0, pmid, buffer, 8));
+  uint32_t now = 0;
+  uint32_t previousBackoff = 1000;
+  now += previousBackoff;
+  for(uint8_t attempt = 2; attempt < 40; attempt++){
+    CHECK(tracker.poll(now, pmid, buffer, 8));
+    uint32_t backoff = previousBackoff > 0x7FFFFFFF / 2 ? 0x7FFFFFFF : previousBackoff * 2;
+    CHECK(!tracker.poll(now + backoff - 1, pmid, buffer, 8)); //Not due before the saturated backoff
+    now += backoff;
+    previousBackoff = backoff;
+  }
+  CHECK_EQUAL(0x7FFFFFFF, previousBackoff);
+  CHECK_EQUAL(0, completions);
+}
+
+static void testSequencesSkipPending(){
+  Gm7CanRequestTracker tracker(0x0001, 50, 4);
+  uint16_t pmid;
+  char buffer[8];
+  CHECK(tracker.sendStatusChange(0x0042, 7, 0, pmid, buffer, 8));
+  uint8_t first = buffer[6];
+  for(uint16_t i = 0; i < 300; i++){ //Wraps the sequence numbers while the first request stays pending
+    CHECK(tracker.sendControllerStatusChange(1, 0, pmid, buffer, 8));
+    CHECK(buffer[4] != (char)first);
+    CHECK(buffer[4] != 0);
+    tracker.onAck(0x0099, makeAck(0x0001, Gm7CanProtocol::REQUEST_CONTROLLER_STATUS_CHANGE, buffer[4], 0));
+  }
+  CHECK_EQUAL(1, tracker.getPendingCount());
+}
+
+int main(){
+  testAckAndRetries();
+  testTimeout();
+  testShortBufferKeepsRequest();
+  testBackoffSaturates();
+  testSequencesSkipPending();
+  return finishTests("Gm7CanRequestTrackerTest");
+}
@@ -0,0 +1,143 @@
+//Host tests for Gm7CanScheduler.h, see Gm7CanTest.h for how to build and run them
+
+#include "Gm7CanTest.h"
+#include "Gm7CanScheduler.h"
+
+struct Log{
+  uint8_t count;
+  uint8_t jobs[32];
+  uint32_t millis[32];
+};
+
+static void logJob(uint8_t job, uint32_t nowMillis, void * context){
+  Log * log = (Log *)context;
+  if(log->count < 32){
+    log->jobs[log->count] = job;
+    log->millis[log->count] = nowMillis;
+    log->count++;
+  }
+}
+
+static void testHeapOrder(){
+  Gm7CanScheduler scheduler;
+  Log log = {};
+  uint32_t delays[6] = {50, 10, 40, 30, 60, 20};
+  uint8_t ids[6];
+  for(uint8_t i = 0; i < 6; i++){
+    ids[i] = scheduler.addOnce(0, delays[i], logJob, &log);
+  }
+  CHECK_EQUAL(6, scheduler.getJobCount());
+  uint32_t deadline = 0;
+  CHECK(scheduler.getNextDeadline(deadline));
+  CHECK_EQUAL(10, deadline);
+  CHECK_EQUAL(6, scheduler.run(100)); //All due, run in deadline order
+  CHECK_EQUAL(6, log.count);
+  CHECK_EQUAL(ids[1], log.jobs[0]);
+  CHECK_EQUAL(ids[5], log.jobs[1]);
+  CHECK_EQUAL(ids[3], log.jobs[2]);
+  CHECK_EQUAL(ids[2], log.jobs[3]);
+  CHECK_EQUAL(ids[0], log.jobs[4]);
+  CHECK_EQUAL(ids[4], log.jobs[5]);
+  CHECK_EQUAL(0, scheduler.getJobCount());
+  CHECK(!scheduler.getNextDeadline(deadline));
+  CHECK_EQUAL(0xFFFFFFFF, scheduler.getMillisUntilNext(100));
+}
+
+static void testPhaseAndPeriod(){
+  Gm7CanScheduler scheduler;
+  Log log = {};
+  uint8_t a = scheduler.addPeriodic(0, 100, logJob, &log);
+  uint8_t b = scheduler.addPeriodic(0, 100, logJob, &log, 50);
+  for(uint32_t now = 0; now < 300; now++){
+    scheduler.run(now);
+  }
+  CHECK_EQUAL(6, log.count);
+  for(uint8_t i = 0; i < 6; i++){
+    CHECK_EQUAL(i % 2 ? b : a, log.jobs[i]);
+    CHECK_EQUAL(i * 50, log.millis[i]);
+  }
+  CHECK_EQUAL(50, scheduler.getMillisUntilNext(250));
+  CHECK_EQUAL(0, scheduler.getMillisUntilNext(320));
+  CHECK(scheduler.setPeriod(a, 10));
+  CHECK(!scheduler.setPeriod(a, 0));
+  CHECK(!scheduler.setPeriod(Gm7CanScheduler::JOB_NONE, 10));
+}
+
+static void testMissedRuns(){
+  Gm7CanScheduler scheduler;
+  Log log = {};
+  uint8_t job = scheduler.addPeriodic(0, 100, logJob, &log);
+  scheduler.run(0);
+  CHECK_EQUAL(1, scheduler.run(350)); //A blocking loop: runs once, not three times
+  CHECK_EQUAL(2, log.count);
+  Gm7CanScheduler::JobStats stats = scheduler.getStats(job);
+  CHECK_EQUAL(2, stats.runs);
+  CHECK_EQUAL(2, stats.missedRuns);         //The runs at 100 and 200
+  CHECK_EQUAL(250, stats.maxLatenessMillis);
+  CHECK_EQUAL(250, stats.totalLatenessMillis);
+  uint32_t deadline = 0;
+  CHECK(scheduler.getNextDeadline(deadline));
+  CHECK_EQUAL(400, deadline);               //Stays on the original grid
+  CHECK_EQUAL(0, scheduler.run(399));
+  CHECK_EQUAL(1, scheduler.run(405));
+  stats = scheduler.getStats(job);
+  CHECK_EQUAL(3, stats.runs);
+  CHECK_EQUAL(2, stats.missedRuns);
+  CHECK_EQUAL(255, stats.totalLatenessMillis);
+  scheduler.resetStats(job);
+  CHECK_EQUAL(0, scheduler.getStats(job).runs);
+}
+
+static Gm7CanScheduler * cancelScheduler;
+
+static void cancelSelf(uint8_t job, uint32_t nowMillis, void * context){
+  logJob(job, nowMillis, context);
+  cancelScheduler->cancel(job);
+}
+
+static void testCancel(){
+  Gm7CanScheduler scheduler;
+  cancelScheduler = &scheduler;
+  Log log = {};
+  uint8_t a = scheduler.addPeriodic(0, 10, logJob, &log);
+  scheduler.addPeriodic(0, 10, cancelSelf, &log, 5);
+  uint8_t c = scheduler.addOnce(0, 30, logJob, &log);
+  CHECK(scheduler.cancel(c));
+  CHECK(!scheduler.cancel(c));
+  for(uint32_t now = 0; now < 40; now++){
+    scheduler.run(now);
+  }
+  CHECK_EQUAL(5, log.count); //a at 0, 10, 20, 30 and the self cancelling job once
+  CHECK_EQUAL(1, scheduler.getJobCount());
+  CHECK(scheduler.reschedule(a, 35));
+  CHECK_EQUAL(1, scheduler.run(35));
+  CHECK_EQUAL(Gm7CanScheduler::JOB_NONE, scheduler.addOnce(0, 0, 0)); //A job needs a callback
+  for(uint8_t i = 1; i < CAN_SCHEDULER_JOBS; i++){
+    CHECK(scheduler.addOnce(0, 1000, logJob, &log) != Gm7CanScheduler::JOB_NONE);
+  }
+  CHECK_EQUAL(Gm7CanScheduler::JOB_NONE, scheduler.addOnce(0, 1000, logJob, &log));
+}
+
+static void testMillisOverflow(){
+  Gm7CanScheduler scheduler;
+  Log log = {};
+  uint32_t start = 0xFFFFFF00;
+  scheduler.addPeriodic(start, 0x80, logJob, &log);
+  scheduler.addOnce(start, 0x180, logJob, &log); //Due after the overflow
+  CHECK_EQUAL(1, scheduler.run(start));
+  CHECK_EQUAL(0, scheduler.run(start + 0x7F));
+  CHECK_EQUAL(1, scheduler.run(start + 0x80));
+  CHECK_EQUAL(0x80, scheduler.getMillisUntilNext(start + 0x80));
+  CHECK_EQUAL(1, scheduler.run(0x00000000));
+  CHECK_EQUAL(2, scheduler.run(0x00000080));
+  CHECK_EQUAL(0, scheduler.getStats(0).missedRuns);
+}
+
+int main(){
+  testHeapOrder();
+  testPhaseAndPeriod();
+  testMissedRuns();
+  testCancel();
+  testMillisOverflow();
+  return finishTests("Gm7CanSchedulerTest");
+}
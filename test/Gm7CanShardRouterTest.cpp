@@ -0,0 +1,117 @@
+//Host tests for Gm7CanShardRouter.h, see Gm7CanTest.h for how to build and run them; add -pthread, the order test uses threads
+
+#include "Gm7CanTest.h"
+#include "Gm7CanShardRouter.h"
+#include <thread>
+#include <atomic>
+
+static Gm7CanProtocol::CanFrame makeFrame(uint16_t uid, uint32_t count){
+  char payload[8] = {0};
+  Gm7CanProtocol::addUint32ToBuffer(payload, 8, count, 0);
+  return Gm7CanProtocol::createFrameFromBuffer(((uint32_t)Gm7CanProtocol::STATUS_MODULE << 16) | uid, payload, 8);
+}
+
+static void testLayout(){
+#if !defined(__AVR__)
+  CHECK_EQUAL(0, alignof(Gm7CanFrameQueue) % 64);
+  CHECK_EQUAL(0, sizeof(Gm7CanShardRouter) % 64);
+  CHECK(sizeof(Gm7CanShardRouter) >= CAN_SHARD_COUNT * (sizeof(Gm7CanFrameQueue) + 64)); //Stats in a line of their own
+#endif
+}
+
+static void testFifoAndBackpressure(){
+  static Gm7CanShardRouter router;
+  uint16_t uid = 0x0042;
+  uint8_t shard = Gm7CanShardRouter::getShard(uid);
+  for(uint32_t i = 0; i < CAN_FRAME_QUEUE_SIZE; i++){
+    CHECK(router.route(makeFrame(uid, i)));
+    CHECK_EQUAL(i + 1 >= (CAN_FRAME_QUEUE_SIZE * 3) / 4, router.isBackpressured(shard));
+  }
+  CHECK(!router.route(makeFrame(uid, 999))); //Full, the frame is not queued
+  Gm7CanShardRouter::ShardStats stats = router.getShardStats(shard);
+  CHECK_EQUAL(CAN_FRAME_QUEUE_SIZE, stats.routedFrames);
+  CHECK_EQUAL(1, stats.rejectedFrames);
+  CHECK_EQUAL(CAN_FRAME_QUEUE_SIZE, stats.highWater);
+  Gm7CanProtocol::CanFrame frame = makeFrame(0, 0);
+  for(uint32_t i = 0; i < CAN_FRAME_QUEUE_SIZE; i++){
+    CHECK(router.pop(shard, frame));
+    CHECK_EQUAL(i, Gm7CanProtocol::extractUint32FromBuffer(frame.data, frame.length, 0));
+  }
+  CHECK(!router.pop(shard, frame));
+  CHECK(!router.pop(CAN_SHARD_COUNT, frame));
+  CHECK_EQUAL(0, router.getShardFill(shard));
+}
+
+static void testSpread(){
+  uint16_t perShard[CAN_SHARD_COUNT] = {0};
+  for(uint16_t uid = 0x0100; uid < 0x0100 + (16 * CAN_SHARD_COUNT); uid++){
+    perShard[Gm7CanShardRouter::getShard(uid)]++;
+  }
+  for(uint8_t shard = 0; shard < CAN_SHARD_COUNT; shard++){
+    CHECK(perShard[shard] >= 8);  //Sequential UID's land on every shard
+  }
+}
+
+//One producer and a worker per shard on their own threads: every frame arrives once, at the worker of its UID, in bus order
+static const uint16_t UIDS = 64;
+static const uint32_t FRAMES_PER_UID = 20000;
+static Gm7CanShardRouter threadedRouter;
+static std::atomic<uint32_t> received(0);
+static std::atomic<uint32_t> misrouted(0);
+static std::atomic<uint32_t> outOfOrder(0);
+
+static void worker(uint8_t shard){
+  uint32_t next[UIDS] = {0};
+  Gm7CanProtocol::CanFrame frame = makeFrame(0, 0);
+  while(received.load() < UIDS * FRAMES_PER_UID){
+    if(!threadedRouter.pop(shard, frame)){
+      std::this_thread::yield();
+      continue;
+    }
+    uint16_t uid = frame.getUid() - 0x0100;
+    if(Gm7CanShardRouter::getShard(frame.getUid()) != shard){
+      misrouted++;
+    }
+    if(Gm7CanProtocol::extractUint32FromBuffer(frame.data, frame.length, 0) != next[uid]){
+      outOfOrder++;
+    }
+    next[uid]++;
+    received++;
+  }
+}
+
+static void testThreadedOrder(){
+  std::thread workers[CAN_SHARD_COUNT];
+  for(uint8_t shard = 0; shard < CAN_SHARD_COUNT; shard++){
+    workers[shard] = std::thread(worker, shard);
+  }
+  uint32_t retries = 0;
+  for(uint32_t count = 0; count < FRAMES_PER_UID; count++){
+    for(uint16_t uid = 0; uid < UIDS; uid++){
+      Gm7CanProtocol::CanFrame frame = makeFrame(0x0100 + uid, count);
+      while(!threadedRouter.route(frame)){ //Backpressure: wait and retry the same frame to keep the order
+        retries++;
+        std::this_thread::yield();
+      }
+    }
+  }
+  for(uint8_t shard = 0; shard < CAN_SHARD_COUNT; shard++){
+    workers[shard].join();
+  }
+  CHECK_EQUAL(UIDS * FRAMES_PER_UID, received.load());
+  CHECK_EQUAL(0, misrouted.load());
+  CHECK_EQUAL(0, outOfOrder.load());
+  uint32_t rejected = 0;
+  for(uint8_t shard = 0; shard < CAN_SHARD_COUNT; shard++){
+    rejected += threadedRouter.getShardStats(shard).rejectedFrames;
+  }
+  CHECK_EQUAL(retries, rejected);
+}
+
+int main(){
+  testLayout();
+  testFifoAndBackpressure();
+  testSpread();
+  testThreadedOrder();
+  return finishTests("Gm7CanShardRouterTest");
+}
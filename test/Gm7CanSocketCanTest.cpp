@@ -0,0 +1,157 @@
+//Host tests for Gm7CanSocketCan.h, see Gm7CanTest.h for how to build and run them; Linux only, the buses are socketpairs
+
+#include "Gm7CanTest.h"
+#include "Gm7CanSocketCan.h"
+
+struct Received{
+  uint16_t count;
+  uint8_t bus[16];
+  Gm7CanProtocol::Event events[16];
+  uint64_t timestampNanos[16];
+};
+
+static void onEvent(uint8_t bus, const Gm7CanProtocol::Event & event, const Gm7CanProtocol::CanFrame & frame, uint64_t timestampNanos, void * context){
+  Received & received = *(Received *)context;
+  (void)frame;
+  if(received.count < 16){
+    received.bus[received.count] = bus;
+    received.events[received.count] = event;
+    received.timestampNanos[received.count] = timestampNanos;
+  }
+  received.count++;
+}
+
+static void countEvent(uint8_t bus, const Gm7CanProtocol::Event & event, const Gm7CanProtocol::CanFrame & frame, uint64_t timestampNanos, void * context){
+  (void)bus; (void)event; (void)frame; (void)timestampNanos;
+  (*(uint32_t *)context)++;
+}
+
+static bool sendFrame(int fd, uint32_t canId, const char * payload, uint8_t length){
+  struct can_frame raw;
+  memset(&raw, 0, sizeof(raw));
+  raw.can_id = canId;
+  raw.can_dlc = length;
+  memcpy(raw.data, payload, length);
+  return write(fd, &raw, sizeof(raw)) == (ssize_t)sizeof(raw);
+}
+
+static bool sendFrame(int fd, const Gm7CanProtocol::CanFrame & frame){
+  return sendFrame(fd, frame.id | CAN_EFF_FLAG, frame.data, frame.length);
+}
+
+static void testEvents(){
+  int pair[2];
+  CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, pair));
+  Gm7CanSocketCanGateway gateway;
+  Gm7CanFrameRing ring;
+  Gm7CanFrameRing::Cursor cursor = ring.createCursor();
+  Received received;
+  memset(&received, 0, sizeof(received));
+  gateway.setCallback(onEvent, &received);
+  gateway.setRing(&ring);
+  CHECK_EQUAL(0, gateway.addSocket(pair[0]));
+  CHECK_EQUAL(0, gateway.poll(0)); //Nothing waiting
+
+  char buffer[8];
+  CHECK(sendFrame(pair[1], Gm7CanProtocol::encodeHeartbeat(Gm7CanProtocol::HEARTBEAT_MODULE, 0x0102, 5000, 4000)));
+  Gm7CanProtocol::encodeOnlineBitmap(buffer, 8, 0, 0x05);
+  CHECK(sendFrame(pair[1], Gm7CanProtocol::encodeMessageId(Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP, 1) | CAN_EFF_FLAG, buffer, 8));
+  CHECK(sendFrame(pair[1], Gm7CanProtocol::encodeMessageId(Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP, 1) | CAN_EFF_FLAG, buffer, 4));
+  CHECK(sendFrame(pair[1], 0x123, buffer, 8));                                       //Standard ID
+  CHECK(sendFrame(pair[1], CAN_ERR_FLAG | CAN_EFF_FLAG | 0x40, buffer, 8));          //Error frame, bus off
+  CHECK_EQUAL(4, write(pair[1], buffer, 4));                                          //Not a struct can_frame
+  CHECK_EQUAL(3, gateway.poll(1000));
+
+  CHECK_EQUAL(3, received.count);
+  CHECK_EQUAL(0, received.bus[0]);
+  CHECK_EQUAL(Gm7CanProtocol::EVENT_HEARTBEAT, received.events[0].type);
+  CHECK_EQUAL(0x0102, received.events[0].messageId.uid);
+  CHECK_EQUAL(5000, received.events[0].heartbeat.millisCurrent);
+  CHECK_EQUAL(Gm7CanProtocol::EVENT_ONLINE_BITMAP, received.events[1].type);
+  CHECK_EQUAL(0, received.events[1].onlineBitmap.page);
+  CHECK_EQUAL(0x05, received.events[1].onlineBitmap.bitmap);
+  CHECK_EQUAL(Gm7CanProtocol::EVENT_INVALID, received.events[2].type); //An online bitmap needs all 8 bytes
+  CHECK(received.timestampNanos[0] > 0);
+  CHECK(received.timestampNanos[1] >= received.timestampNanos[0]);
+
+  Gm7CanSocketCanGateway::BusStats stats = gateway.getStats(0);
+  CHECK_EQUAL(3, stats.frames);
+  CHECK_EQUAL(3, stats.skipped);
+  CHECK_EQUAL(1, stats.batches);
+  CHECK_EQUAL(0, stats.kernelDrops);
+
+  Gm7CanFrameRing::Frame frame;
+  CHECK(ring.read(cursor, frame));
+  CHECK_EQUAL(Gm7CanProtocol::HEARTBEAT_MODULE, frame.messageId.pmid);
+  CHECK_EQUAL((uint32_t)(received.timestampNanos[0] / 1000000), frame.timestampMillis);
+  CHECK(ring.read(cursor, frame));
+  CHECK(ring.read(cursor, frame));
+  CHECK_EQUAL(4, frame.length);
+  CHECK(!ring.read(cursor, frame));
+  close(pair[1]);
+}
+
+static void testBuses(){
+  Gm7CanSocketCanGateway gateway;
+  Received received;
+  memset(&received, 0, sizeof(received));
+  gateway.setCallback(onEvent, &received);
+  int pairs[CAN_SOCKETCAN_BUSES][2];
+  for(uint8_t i = 0; i < CAN_SOCKETCAN_BUSES; i++){
+    CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, pairs[i]));
+    CHECK_EQUAL(i, gateway.addSocket(pairs[i][0]));
+  }
+  int extra[2];
+  CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, extra));
+  CHECK_EQUAL(-1, gateway.addSocket(extra[0])); //Full, the socket stays ours
+  close(extra[0]);
+  close(extra[1]);
+  CHECK_EQUAL(-1, gateway.openBus("gm7-none"));
+  CHECK_EQUAL(CAN_SOCKETCAN_BUSES, gateway.getBusCount());
+
+  CHECK(sendFrame(pairs[2][1], Gm7CanProtocol::encodeHeartbeat(Gm7CanProtocol::HEARTBEAT_CONTROLLER, 1, 100)));
+  CHECK_EQUAL(1, gateway.poll(1000));
+  CHECK_EQUAL(1, received.count);
+  CHECK_EQUAL(2, received.bus[0]);
+  CHECK_EQUAL(1, gateway.getStats(2).frames);
+  CHECK_EQUAL(0, gateway.getStats(1).frames);
+  for(uint8_t i = 0; i < CAN_SOCKETCAN_BUSES; i++){
+    close(pairs[i][1]);
+  }
+}
+
+//One second of a full 1 Mbit/s bus, sent in bursts: read in full batches and handled well within that second
+static void testLineRate(){
+  int pair[2];
+  CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, pair));
+  Gm7CanSocketCanGateway gateway;
+  uint32_t events = 0;
+  gateway.setCallback(countEvent, &events);
+  CHECK_EQUAL(0, gateway.addSocket(pair[0]));
+  const uint32_t frames = 15000;
+  const uint32_t burst = CAN_SOCKETCAN_BATCH * 2;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(uint32_t sent = 0; sent < frames; sent += burst){
+    for(uint32_t i = 0; i < burst; i++){
+      sendFrame(pair[1], Gm7CanProtocol::encodeHeartbeat(Gm7CanProtocol::HEARTBEAT_MODULE, i, sent + i));
+    }
+    gateway.poll(0);
+  }
+  while(gateway.poll(0) > 0){}
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  uint64_t elapsedNanos = ((uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL) + end.tv_nsec - start.tv_nsec;
+  uint32_t sentFrames = ((frames + burst - 1) / burst) * burst;
+  CHECK_EQUAL(sentFrames, events);
+  CHECK_EQUAL(sentFrames, gateway.getStats(0).frames);
+  CHECK_EQUAL(sentFrames / CAN_SOCKETCAN_BATCH, gateway.getStats(0).batches); //Only full batches, then a short empty read
+  CHECK(elapsedNanos < 1000000000ULL);
+  close(pair[1]);
+}
+
+int main(){
+  testEvents();
+  testBuses();
+  testLineRate();
+  return finishTests("Gm7CanSocketCanTest");
+}
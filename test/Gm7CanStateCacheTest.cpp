@@ -0,0 +1,148 @@
+//Host tests for Gm7CanStateCache.h, see Gm7CanTest.h for how to build and run them; add -pthread, the sequence lock test uses threads
+
+#define CAN_STATE_CACHE_NODES 4 //Small, so the test can fill the cache
+#include "Gm7CanTest.h"
+#include "Gm7CanStateCache.h"
+#include <thread>
+#include <atomic>
+
+static uint32_t makeId(uint16_t pmid, uint16_t uid){
+  return ((uint32_t)pmid << 16) | uid;
+}
+
+static void testKinds(){
+  CHECK_EQUAL(Gm7CanStateCache::STATE_STATUS_AND_PROGRESS, Gm7CanStateCache::getKind(Gm7CanProtocol::CONTROLLER_STATUS_AND_PROGRESS));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_STATUS_AND_PROGRESS, Gm7CanStateCache::getKind(Gm7CanProtocol::EXTERNAL_DEVICE_STATUS_AND_PROGRESS));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_MAIN_TIMER, Gm7CanStateCache::getKind(Gm7CanProtocol::MODULE_MAIN_TIMER_STATUS));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_VALIDATION_TIMER, Gm7CanStateCache::getKind(Gm7CanProtocol::PERIPHERAL_VALIDATION_TIMER_STATUS));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_INTERNAL_TIMER, Gm7CanStateCache::getKind(Gm7CanProtocol::EXTERNAL_DEVICE_INTERNAL_TIMER_STATUS));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_TRIES, Gm7CanStateCache::getKind(Gm7CanProtocol::CONTROLLER_TRIES));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_TRIES, Gm7CanStateCache::getKind(Gm7CanProtocol::MODULE_TRIES));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_KIND_COUNT, Gm7CanStateCache::getKind(Gm7CanProtocol::PERIPHERAL_SECTION_START + 5)); //No tries there
+  CHECK_EQUAL(Gm7CanStateCache::STATE_KIND_COUNT, Gm7CanStateCache::getKind(Gm7CanProtocol::CONTROLLER_ONLINE_BITMAP));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_KIND_COUNT, Gm7CanStateCache::getKind(Gm7CanProtocol::CONTROLLER_SECTION_START));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_KIND_COUNT, Gm7CanStateCache::getKind(Gm7CanProtocol::MODULE_SECTION_END));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_KIND_COUNT, Gm7CanStateCache::getKind(Gm7CanProtocol::HEARTBEAT_MODULE));
+  CHECK_EQUAL(Gm7CanStateCache::STATE_KIND_COUNT, Gm7CanStateCache::getKind(Gm7CanProtocol::EXTERNAL_DEVICE_SECTION_END));
+}
+
+static void testValues(){
+  Gm7CanStateCache cache;
+  Gm7CanProtocol::StatusAndProgress statusAndProgress = {7, 3, 10};
+  CHECK(!cache.getStatusAndProgress(0x0101, statusAndProgress));
+  CHECK_EQUAL(0, cache.getChangeCount(0x0101, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS));
+
+  CHECK(cache.update(Gm7CanProtocol::encodeModuleStatusAndProgress(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x0101, statusAndProgress), 100));
+  Gm7CanProtocol::StatusAndProgress read = {0, 0, 0};
+  CHECK(cache.getStatusAndProgress(0x0101, read));
+  CHECK_EQUAL(7, read.status);
+  CHECK_EQUAL(3, read.progress);
+  CHECK_EQUAL(10, read.progressMax);
+  CHECK_EQUAL(1, cache.getChangeCount(0x0101, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS));
+
+  //The same payload again only moves the time
+  CHECK(cache.update(Gm7CanProtocol::encodeModuleStatusAndProgress(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x0101, statusAndProgress), 200));
+  Gm7CanStateCache::Value value;
+  CHECK(cache.get(0x0101, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS, value));
+  CHECK_EQUAL(1, value.changes);
+  CHECK_EQUAL(200, value.updatedMillis);
+  CHECK_EQUAL(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, value.pmid);
+  statusAndProgress.progress = 4;
+  CHECK(cache.update(Gm7CanProtocol::encodeModuleStatusAndProgress(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x0101, statusAndProgress), 300));
+  CHECK_EQUAL(2, cache.getChangeCount(0x0101, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS));
+
+  //Timers and tries have slots of their own
+  Gm7CanProtocol::TimerStatus timer = {500, 600};
+  CHECK(cache.update(Gm7CanProtocol::encodeTimerStatus(Gm7CanProtocol::MODULE_VALIDATION_TIMER_STATUS, 0x0101, timer), 400));
+  Gm7CanProtocol::TimerStatus readTimer = {0, 0};
+  CHECK(!cache.getTimerStatus(0x0101, Gm7CanStateCache::STATE_MAIN_TIMER, readTimer));
+  CHECK(cache.getTimerStatus(0x0101, Gm7CanStateCache::STATE_VALIDATION_TIMER, readTimer));
+  CHECK_EQUAL(500, readTimer.timeLeft);
+  CHECK_EQUAL(600, readTimer.timeSet);
+  CHECK(!cache.getTimerStatus(0x0101, Gm7CanStateCache::STATE_TRIES, readTimer)); //Not a timer
+  Gm7CanProtocol::Tries tries = {1, 5, 9, 0};
+  CHECK(cache.update(Gm7CanProtocol::encodeTries(Gm7CanProtocol::CONTROLLER_TRIES, 0x0101, tries), 500));
+  Gm7CanProtocol::Tries readTries = {0, 0, 0, 0};
+  CHECK(cache.getTries(0x0101, readTries));
+  CHECK_EQUAL(5, readTries.max);
+  CHECK_EQUAL(9, readTries.total);
+
+  //A short payload is kept, but is not a status
+  char payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  CHECK(cache.update(makeId(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x0101), payload, 4, 600));
+  CHECK_EQUAL(3, cache.getChangeCount(0x0101, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS));
+  CHECK(!cache.getStatusAndProgress(0x0101, read));
+
+  //Other frames and kinds are not cached
+  CHECK(!cache.update(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, 0x0101), payload, 8, 700));
+  CHECK(!cache.get(0x0101, Gm7CanStateCache::STATE_KIND_COUNT, value));
+  CHECK(!cache.get(0x0202, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS, value));
+}
+
+static void testFull(){
+  Gm7CanStateCache cache;
+  char payload[8] = {0};
+  for(uint16_t uid = 1; uid <= CAN_STATE_CACHE_NODES; uid++){
+    CHECK(cache.update(makeId(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, uid), payload, 8, 0));
+  }
+  CHECK(!cache.update(makeId(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x0F00), payload, 8, 0));
+  CHECK_EQUAL(1, cache.getUntrackedFrames());
+  for(uint16_t uid = 1; uid <= CAN_STATE_CACHE_NODES; uid++){
+    CHECK_EQUAL(1, cache.getChangeCount(uid, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS));
+  }
+  CHECK_EQUAL(0, cache.getChangeCount(0x0F00, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS));
+}
+
+//One writer updates a status as fast as it can, with the same number in both halves of the payload.
+//The readers must always see both halves equal and the change count never going back.
+static void testSequenceLock(){
+  static Gm7CanStateCache cache;
+  const uint32_t updates = 200000;
+  std::atomic<bool> done(false);
+  uint32_t torn[2] = {0, 0};
+  uint32_t backwards[2] = {0, 0};
+  std::thread readers[2];
+  for(uint8_t r = 0; r < 2; r++){
+    readers[r] = std::thread([&, r](){
+      uint32_t lastChanges = 0;
+      while(!done.load()){
+        Gm7CanStateCache::Value value;
+        if(!cache.get(0x0042, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS, value)){
+          continue;
+        }
+        if(Gm7CanProtocol::extractUint32FromBuffer(value.payload, 8, 0) != Gm7CanProtocol::extractUint32FromBuffer(value.payload, 8, 4)
+          || value.updatedMillis != Gm7CanProtocol::extractUint32FromBuffer(value.payload, 8, 0)){
+          torn[r]++;
+        }
+        if(value.changes < lastChanges){
+          backwards[r]++;
+        }
+        lastChanges = value.changes;
+      }
+    });
+  }
+  char payload[8];
+  for(uint32_t i = 1; i <= updates; i++){
+    Gm7CanProtocol::addUint32ToBuffer(payload, 8, i, 0);
+    Gm7CanProtocol::addUint32ToBuffer(payload, 8, i, 4);
+    cache.update(makeId(Gm7CanProtocol::MODULE_STATUS_AND_PROGRESS, 0x0042), payload, 8, i);
+    if((i % 1000) == 0){
+      std::this_thread::yield(); //Give the readers a chance on a single core too
+    }
+  }
+  done.store(true);
+  for(uint8_t r = 0; r < 2; r++){
+    readers[r].join();
+    CHECK_EQUAL(0, torn[r]);
+    CHECK_EQUAL(0, backwards[r]);
+  }
+  CHECK_EQUAL(updates, cache.getChangeCount(0x0042, Gm7CanStateCache::STATE_STATUS_AND_PROGRESS));
+}
+
+int main(){
+  testKinds();
+  testValues();
+  testFull();
+  testSequenceLock();
+  return finishTests("Gm7CanStateCacheTest");
+}
@@ -0,0 +1,44 @@
+/*
+  Gm7CanTest.h - Minimal checks for the host tests in this folder.
+                 Every test is a single file with its own main(), build and run it from the root of the library with:
+                   g++ -std=gnu++11 -Wall -Wextra -I test -I . test/Gm7CanGroupsTest.cpp -o groups-test && ./groups-test
+                 It prints every failed check and exits with 1 when there was one.
+                 Tests that start threads say so on their first line; build those with -pthread.
+  Created by Alexander Samson
+  contact: alexander@gm7.nl
+  Released into the public domain.
+*/
+
+#ifndef Gm7CanTest_h
+#define Gm7CanTest_h
+
+#include <stdio.h>
+
+static int gm7CanTestFailures = 0;
+
+#define CHECK(condition) do { \
+    if(!(condition)){ \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      gm7CanTestFailures++; \
+    } \
+  } while(0)
+
+#define CHECK_EQUAL(expected, actual) do { \
+    unsigned long long expectedValue = (unsigned long long)(expected); \
+    unsigned long long actualValue = (unsigned long long)(actual); \
+    if(expectedValue != actualValue){ \
+      printf("%s:%d: CHECK_EQUAL(%s, %s) failed: %llu != %llu\n", __FILE__, __LINE__, #expected, #actual, expectedValue, actualValue); \
+      gm7CanTestFailures++; \
+    } \
+  } while(0)
+
+static int finishTests(const char * name){
+  if(gm7CanTestFailures == 0){
+    printf("%s: all checks passed\n", name);
+    return 0;
+  }
+  printf("%s: %d checks failed\n", name, gm7CanTestFailures);
+  return 1;
+}
+
+#endif
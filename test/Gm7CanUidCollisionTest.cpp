@@ -0,0 +1,278 @@
+//Host tests for Gm7CanUidCollision.h, see Gm7CanTest.h for how to build and run them
+
+#define CAN_UID_COLLISION_SLOTS 16 //Small, so the test can fill the table
+#include "Gm7CanTest.h"
+#include "Gm7CanUidCollision.h"
+
+static uint32_t makeId(uint16_t pmid, uint16_t uid){
+  return ((uint32_t)pmid << 16) | uid;
+}
+
+static uint8_t sendSerial(Gm7CanUidCollisionDetector & detector, uint16_t pmid, uint16_t uid, uint64_t serialNumber){
+  char buffer[8];
+  Gm7CanProtocol::encodeSerialNumberToBuffer(buffer, 8, serialNumber);
+  return detector.onFrame(makeId(pmid, uid), buffer, 8);
+}
+
+static uint8_t sendTypeId(Gm7CanUidCollisionDetector & detector, uint16_t uid, uint16_t typeId){
+  char buffer[8];
+  Gm7CanProtocol::encodeTypeIdToBuffer(buffer, 8, typeId);
+  return detector.onFrame(makeId(Gm7CanProtocol::DEVICE_TYPE_ID, uid), buffer, 8);
+}
+
+static uint8_t sendHeartbeat(Gm7CanUidCollisionDetector & detector, uint16_t pmid, uint16_t uid, uint32_t millisCurrent){
+  char buffer[8];
+  Gm7CanProtocol::encodeHeartbeat(buffer, 8, millisCurrent);
+  return detector.onFrame(makeId(pmid, uid), buffer, 8);
+}
+
+static uint16_t callbackUid = 0;
+static uint8_t callbackReason = 0;
+static uint16_t callbackCount = 0;
+
+static void onCollision(uint16_t uid, uint8_t collisionReason){
+  callbackUid = uid;
+  callbackReason = collisionReason;
+  callbackCount++;
+}
+
+static void testDetector(){
+  Gm7CanUidCollisionDetector detector;
+  detector.setCallback(onCollision);
+  //One device telling the same things over and over is fine
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendSerial(detector, Gm7CanProtocol::DEVICE_SERIAL, 0x0010, 1000));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendSerial(detector, Gm7CanProtocol::DEVICE_UID_CLAIM, 0x0010, 1000));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendTypeId(detector, 0x0010, Gm7CanProtocol::DEVICE_TYPE_MODULE_TIMER));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_MODULE, 0x0010, 100));
+  CHECK(!detector.hasCollision(0x0010));
+  CHECK_EQUAL(0, callbackCount);
+
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_SERIAL, sendSerial(detector, Gm7CanProtocol::DEVICE_SERIAL, 0x0010, 2000));
+  CHECK(detector.hasCollision(0x0010));
+  CHECK_EQUAL(0x0010, callbackUid);
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_SERIAL, callbackReason);
+
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendTypeId(detector, 0x0020, Gm7CanProtocol::DEVICE_TYPE_MODULE_TIMER));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_TYPE_ID, sendTypeId(detector, 0x0020, Gm7CanProtocol::DEVICE_TYPE_MODULE_GENERIC_RO));
+
+  //Heartbeats of two CanDeviceTypes, or one that does not match the device type id
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_MODULE, 0x0030, 100));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_DEVICE_TYPE, sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_CONTROLLER, 0x0030, 200));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_MODULE, 0x0031, 100));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_DEVICE_TYPE, sendTypeId(detector, 0x0031, Gm7CanProtocol::DEVICE_TYPE_CONTROLLER_SBC));
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_DEVICE_TYPE, detector.getNode(0x0031)->collisionReason);
+
+  //Frames that tell nothing about the device are not tracked
+  char buffer[8] = {0};
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, detector.onFrame(makeId(Gm7CanProtocol::STATUS_MODULE, 0x0040), buffer, 8));
+  CHECK(detector.getNode(0x0040) == 0);
+  CHECK_EQUAL(4, detector.getCollisionCount());
+}
+
+static void testHeartbeats(){
+  Gm7CanUidCollisionDetector detector;
+  //A restart jumps back once, then rises again
+  uint32_t millis = 5000;
+  for(uint8_t i = 0; i < 10; i++){
+    CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_MODULE, 0x0050, millis));
+    millis += 100;
+  }
+  millis = 10;
+  for(uint8_t restart = 0; restart < 5; restart++){ //Restarts far enough apart are never a collision
+    for(uint8_t i = 0; i < 10; i++){
+      CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_MODULE, 0x0050, millis));
+      millis += 100;
+    }
+    millis = 10;
+  }
+  CHECK(!detector.hasCollision(0x0050));
+
+  //Two devices with the same UID interleave: one running for a minute, one just started
+  uint8_t found = Gm7CanUidCollisionDetector::COLLISION_NONE;
+  for(uint32_t beat = 0; beat < 4 && found == Gm7CanUidCollisionDetector::COLLISION_NONE; beat++){
+    sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_MODULE, 0x0060, 60000 + (beat * 100));
+    found = sendHeartbeat(detector, Gm7CanProtocol::HEARTBEAT_MODULE, 0x0060, 50 + (beat * 100));
+  }
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_HEARTBEAT, found);
+  CHECK(detector.hasCollision(0x0060));
+}
+
+static void testOwnUid(){
+  Gm7CanUidCollisionDetector detector;
+  callbackCount = 0;
+  detector.setCallback(onCollision);
+  detector.setOwnUid(0x0070);
+  char buffer[8] = {0};
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_OWN_UID, detector.onFrame(makeId(Gm7CanProtocol::STATUS_MODULE, 0x0070), buffer, 8));
+  for(uint8_t i = 0; i < 20; i++){
+    CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, detector.onFrame(makeId(Gm7CanProtocol::STATUS_MODULE, 0x0070), buffer, 8));
+  }
+  CHECK_EQUAL(1, callbackCount); //Reported once, not per frame
+  CHECK_EQUAL(21, detector.getOwnUidFrames());
+  detector.setOwnUid(0x0070); //Reported again after a new UID was set
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_OWN_UID, detector.onFrame(makeId(Gm7CanProtocol::STATUS_MODULE, 0x0070), buffer, 8));
+  CHECK_EQUAL(2, callbackCount);
+  detector.reset();
+  CHECK_EQUAL(0, detector.getOwnUidFrames());
+  CHECK_EQUAL(0, detector.getCollisionCount());
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_OWN_UID, detector.onFrame(makeId(Gm7CanProtocol::STATUS_MODULE, 0x0070), buffer, 8));
+}
+
+static void testFullTable(){
+  Gm7CanUidCollisionDetector detector;
+  for(uint16_t uid = 1; uid <= CAN_UID_COLLISION_SLOTS; uid++){
+    sendSerial(detector, Gm7CanProtocol::DEVICE_SERIAL, uid, uid);
+  }
+  for(uint16_t uid = 1; uid <= CAN_UID_COLLISION_SLOTS; uid++){
+    CHECK(detector.getNode(uid) != 0);
+    CHECK_EQUAL(uid, detector.getNode(uid)->serialNumber);
+  }
+  CHECK_EQUAL(0, detector.getUntrackedFrames());
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_NONE, sendSerial(detector, Gm7CanProtocol::DEVICE_SERIAL, 0x1000, 1));
+  CHECK_EQUAL(1, detector.getUntrackedFrames());
+  CHECK(detector.getNode(0x1000) == 0);
+  //Known UID's are still checked
+  CHECK_EQUAL(Gm7CanUidCollisionDetector::COLLISION_SERIAL, sendSerial(detector, Gm7CanProtocol::DEVICE_SERIAL, 3, 4));
+  uint16_t used = 0;
+  for(uint16_t i = 0; i < CAN_UID_COLLISION_SLOTS + 1; i++){
+    used += detector.getNodeAt(i) != 0;
+  }
+  CHECK_EQUAL(CAN_UID_COLLISION_SLOTS, used);
+}
+
+//Polls the claimer once and counts the claim it sends
+static bool pollClaim(Gm7CanUidClaimer & claimer, uint32_t nowMillis){
+  char buffer[8];
+  uint16_t pmid = 0;
+  if(!claimer.poll(nowMillis, pmid, buffer, 8)){
+    return false;
+  }
+  CHECK_EQUAL(Gm7CanProtocol::DEVICE_UID_CLAIM, pmid);
+  return true;
+}
+
+static bool sendClaim(Gm7CanUidClaimer & claimer, uint16_t pmid, uint16_t uid, uint64_t serialNumber, uint32_t nowMillis){
+  char buffer[8];
+  Gm7CanProtocol::encodeSerialNumberToBuffer(buffer, 8, serialNumber);
+  return claimer.onFrame(makeId(pmid, uid), buffer, 8, nowMillis);
+}
+
+static void testClaimUncontested(){
+  const uint64_t serialNumber = 0x123456789ULL;
+  Gm7CanUidClaimer claimer(serialNumber);
+  CHECK_EQUAL(Gm7CanUidClaimer::CLAIM_IDLE, claimer.getState());
+  CHECK(!pollClaim(claimer, 0));
+  claimer.begin(0);
+  CHECK_EQUAL(Gm7CanProtocol::getUidForSerial(serialNumber, 0), claimer.getUid());
+  uint8_t claims = 0;
+  uint32_t ownedAt = 0;
+  for(uint32_t now = 0; now < 2000 && ownedAt == 0; now++){
+    claims += pollClaim(claimer, now);
+    if(claimer.isOwned()){
+      ownedAt = now;
+    }
+  }
+  CHECK_EQUAL(CAN_UID_CLAIM_COUNT, claims);
+  CHECK_EQUAL(CAN_UID_CLAIM_COUNT * CAN_UID_CLAIM_INTERVAL_MILLIS, ownedAt);
+  //Our own claim coming back (loopback) is no objection
+  CHECK(!sendClaim(claimer, Gm7CanProtocol::DEVICE_UID_CLAIM, claimer.getUid(), serialNumber, ownedAt));
+  CHECK(!pollClaim(claimer, ownedAt + 5000)); //Owned, nothing more to send
+  CHECK_EQUAL(0, claimer.getLostClaims());
+}
+
+static void testClaimLost(){
+  const uint64_t serialNumber = 5000;
+  Gm7CanUidClaimer claimer(serialNumber);
+  claimer.begin(0);
+  CHECK(pollClaim(claimer, 0));
+  uint16_t first = claimer.getUid();
+  //Frames of other UID's do not matter
+  CHECK(!sendClaim(claimer, Gm7CanProtocol::DEVICE_UID_CLAIM, first + 1, 1, 10));
+  //A lower serial number wins
+  CHECK(sendClaim(claimer, Gm7CanProtocol::DEVICE_UID_CLAIM, first, 4999, 10));
+  CHECK_EQUAL(1, claimer.getAttempt());
+  CHECK_EQUAL(1, claimer.getLostClaims());
+  CHECK_EQUAL(Gm7CanProtocol::getUidForSerial(serialNumber, 1), claimer.getUid());
+  CHECK_EQUAL(Gm7CanUidClaimer::CLAIM_CLAIMING, claimer.getState());
+  uint32_t restartMillis = 10 + (serialNumber % CAN_UID_CLAIM_INTERVAL_MILLIS);
+  CHECK(!pollClaim(claimer, restartMillis - 1)); //Spread out from the other losers
+  CHECK(pollClaim(claimer, restartMillis));
+
+  //While claiming, any other frame with the UID means a device with a fixed UID has it
+  uint16_t second = claimer.getUid();
+  char buffer[8];
+  Gm7CanProtocol::encodeHeartbeat(buffer, 8, 100);
+  CHECK(claimer.onFrame(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, second), buffer, 8, restartMillis + 1));
+  CHECK_EQUAL(2, claimer.getAttempt());
+  CHECK(claimer.getUid() != second);
+}
+
+static void testDefend(){
+  const uint64_t serialNumber = 100;
+  Gm7CanUidClaimer claimer(serialNumber);
+  claimer.begin(0);
+  uint32_t now = 0;
+  for(; !claimer.isOwned(); now++){
+    pollClaim(claimer, now);
+  }
+  uint16_t uid = claimer.getUid();
+
+  //A higher serial number is answered with a claim right away, also while owned
+  CHECK(!sendClaim(claimer, Gm7CanProtocol::DEVICE_UID_CLAIM, uid, 200, now));
+  CHECK(pollClaim(claimer, now));
+  CHECK(!pollClaim(claimer, now + 1));
+
+  //A device with a fixed UID that keeps sending: one defend per interval, then it gets the UID
+  char buffer[8];
+  Gm7CanProtocol::encodeHeartbeat(buffer, 8, 100);
+  now += 2000; //A new conflict
+  uint8_t defends = 0;
+  bool lost = false;
+  uint32_t lostAt = 0;
+  for(uint32_t t = now; t < now + 5000 && !lost; t += 10){
+    lost = claimer.onFrame(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, uid), buffer, 8, t);
+    if(lost){
+      lostAt = t;
+    }
+    defends += pollClaim(claimer, t);
+  }
+  CHECK(lost);
+  CHECK_EQUAL(CAN_UID_DEFEND_LIMIT, defends);
+  CHECK_EQUAL(now + (CAN_UID_DEFEND_LIMIT * CAN_UID_CLAIM_INTERVAL_MILLIS), lostAt);
+  CHECK_EQUAL(1, claimer.getAttempt());
+  CHECK(claimer.getUid() != uid);
+  CHECK_EQUAL(Gm7CanUidClaimer::CLAIM_CLAIMING, claimer.getState());
+}
+
+static void testDefendLimitPerConflict(){
+  Gm7CanUidClaimer claimer(100);
+  claimer.begin(0);
+  uint32_t now = 0;
+  for(; !claimer.isOwned(); now++){
+    pollClaim(claimer, now);
+  }
+  uint16_t uid = claimer.getUid();
+  char buffer[8];
+  Gm7CanProtocol::encodeHeartbeat(buffer, 8, 100);
+  //Conflicts far apart (a device restarting with a stale UID now and then) never add up to the limit
+  for(uint8_t conflict = 0; conflict < CAN_UID_DEFEND_LIMIT * 3; conflict++){
+    now += 5 * CAN_UID_CLAIM_INTERVAL_MILLIS;
+    CHECK(!claimer.onFrame(makeId(Gm7CanProtocol::HEARTBEAT_MODULE, uid), buffer, 8, now));
+    CHECK(pollClaim(claimer, now));
+  }
+  CHECK(claimer.isOwned());
+  CHECK_EQUAL(uid, claimer.getUid());
+  CHECK_EQUAL(0, claimer.getLostClaims());
+}
+
+int main(){
+  testDetector();
+  testHeartbeats();
+  testOwnUid();
+  testFullTable();
+  testClaimUncontested();
+  testClaimLost();
+  testDefend();
+  testDefendLimitPerConflict();
+  return finishTests("Gm7CanUidCollisionTest");
+}